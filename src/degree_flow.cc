@@ -3,364 +3,2773 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
-#include <ctime>
+#include <functional>
 #include <limits>
-#include <queue>
+#include <utility>
 #include <vector>
 
+#include "degree_flow_time.h"
+
 using namespace std;
 
-const int kOutputBufferSize = 10000;
-char output_buffer[kOutputBufferSize];
+const double DegreeFlowSolver::kDenseEngineMinDensity = 0.15;
+const double DegreeFlowSolver::kCostScalingMinWork = 400.0;
+const double DegreeFlowSolver::kAdmissibleTolerance = 1e-10;
+const int DegreeFlowSolver::kNumRepricingSweeps;
+const double DegreeFlowSolver::kMaxQuantizedPathCost = 1125899906842624.0;
+const double DegreeFlowSolver::kMaxBucketQueueCost = 65536.0;
+
+namespace {
+
+template <typename T>
+size_t VectorBytes(const vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+size_t VectorBytes(const vector<bool>& v) {
+  return v.capacity() / 8;
+}
+
+size_t SparseMatrixBytes(const DegreeFlowSparseMatrix& x) {
+  return VectorBytes(x.row_offset) + VectorBytes(x.col_index)
+         + VectorBytes(x.value);
+}
+
+// Unreachable nodes can have infinite potentials, which give infinite (or
+// NaN) duals. 0 is feasible for the free sparsity dual and for the
+// non-negative row and column duals, where it gives the smallest
+// contribution to the bound.
+double FiniteDual(double dual) {
+  return abs(dual) < numeric_limits<double>::infinity() ? dual : 0.0;
+}
+
+double NonNegativeDual(double dual) {
+  return max(FiniteDual(dual), 0.0);
+}
+
+bool EntryLess(const DegreeFlowSupport::Entry& a,
+               const DegreeFlowSupport::Entry& b) {
+  return a.row < b.row || (a.row == b.row && a.col < b.col);
+}
+
+}  // namespace
+
+DegreeFlowSolver::DegreeFlowSolver()
+    : num_nodes_(0), num_rows_(0), num_cols_(0),
+      s_(0), t_(1), engine_(DegreeFlowOptions::kAutomaticEngine),
+      queue_type_(DegreeFlowOptions::kIndexedHeapQueue),
+      solution_path_(NULL), path_objective_(0.0), support_size_(0),
+      warm_start_valid_(false),
+      flow_value_(0), source_potential_(0.0), sink_potential_(0.0),
+      active_head_(0), num_active_nodes_(0), cost_scaling_unit_(0.0),
+      quantization_precision_(0.0), warm_start_precision_(0.0),
+      quantization_loss_bound_(0.0), compacting_(false),
+      solving_candidates_(false),
+      admissible_tolerance_(0.0), pruned_objective_(0.0), deadline_(0.0),
+      sparsity_dual_(0.0), objective_bound_(0.0), objective_(0.0),
+      max_flow_bound_(0), dual_support_size_(0) { }
+
+void degree_flow(
+    // signal coefficients (will not be squared)
+    const vector<vector<double> >& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: a bool matrix indicating support
+    vector<vector<bool> >* result,
+    // Result: the statistics of the solve (can be NULL)
+    DegreeFlowStats* stats) {
+  DegreeFlowSolver solver;
+  solver.Solve(x, k, row_degrees, col_degrees, verbose, output_function,
+               result);
+  if (stats != NULL) {
+    *stats = solver.stats();
+  }
+}
+
+void DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const vector<vector<double> >& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: a bool matrix indicating support
+    vector<vector<bool> >* result) {
+  Solve(x, k, row_degrees, col_degrees, DegreeFlowOptions(), verbose,
+        output_function, result);
+}
+
+void DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const vector<vector<double> >& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: a bool matrix indicating support
+    vector<vector<bool> >* result) {
+  Solve(x, k, row_degrees, col_degrees, options, verbose, output_function,
+        result, NULL);
+}
+
+void DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const vector<vector<double> >& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: a bool matrix indicating support
+    vector<vector<bool> >* result,
+    // Result: the supports for all sparsities up to k (can be NULL)
+    DegreeFlowSolutionPath* solution_path) {
+  SupportOutput output;
+  output.matrix = result;
+  if (!SolveVectorSignal(x, k, row_degrees, col_degrees, options, verbose,
+                         output_function, output, solution_path)) {
+    result->clear();
+  }
+}
+
+void DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const vector<vector<double> >& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: the entries of the support
+    DegreeFlowSupport* result,
+    // Result: the supports for all sparsities up to k (can be NULL)
+    DegreeFlowSolutionPath* solution_path) {
+  SupportOutput output;
+  output.entries = result;
+  if (!SolveVectorSignal(x, k, row_degrees, col_degrees, options, verbose,
+                         output_function, output, solution_path)) {
+    result->Clear(0, 0);
+  }
+}
+
+bool DegreeFlowSolver::SolveVectorSignal(const vector<vector<double> >& x,
+    int k, const vector<int>& row_degrees, const vector<int>& col_degrees,
+    const DegreeFlowOptions& options, bool verbose,
+    void (*output_function)(const char*), const SupportOutput& result,
+    DegreeFlowSolutionPath* solution_path) {
+  double begin_time = WallTime();
+  stats_.Clear();
+  if (x.size() == 0) {
+    snprintf(output_buffer_, kOutputBufferSize, "Signal must have at least one "
+             "row.");
+    output_function(output_buffer_);
+    return false;
+  }
+
+  if (x[0].size() == 0) {
+    snprintf(output_buffer_, kOutputBufferSize, "Signal must have at least one "
+             "column.");
+    output_function(output_buffer_);
+    return false;
+  }
+
+  signal_rows_.resize(x.size());
+  for (size_t row = 0; row < x.size(); ++row) {
+    if (x[row].size() != x[0].size()) {
+      snprintf(output_buffer_, kOutputBufferSize, "All columns must have the "
+               "same size.");
+      output_function(output_buffer_);
+      return false;
+    }
+    signal_rows_[row] = &x[row][0];
+  }
+  DenseSignal signal;
+  signal.rows = &signal_rows_[0];
+  signal.num_rows = x.size();
+  signal.num_cols = x[0].size();
+
+  bool success = SolveDenseSignal(signal, k, row_degrees, col_degrees,
+                                  options, verbose, output_function, result,
+                                  solution_path);
+  FinishStats(begin_time);
+  return success;
+}
+
+bool DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const DegreeFlowMatrixView<const double>& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: the support mask
+    const DegreeFlowMatrixView<uint8_t>& result,
+    // Result: the supports for all sparsities up to k (can be NULL)
+    DegreeFlowSolutionPath* solution_path) {
+  double begin_time = WallTime();
+  stats_.Clear();
+  if (result.num_rows != x.num_rows || result.num_cols != x.num_cols) {
+    snprintf(output_buffer_, kOutputBufferSize, "The support mask must have "
+             "the same dimensions as the signal.");
+    output_function(output_buffer_);
+    return false;
+  }
+  SupportOutput output;
+  output.mask = result;
+  return SolveView(x, k, row_degrees, col_degrees, options, verbose,
+                   output_function, output, solution_path, begin_time);
+}
+
+bool DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const DegreeFlowMatrixView<const float>& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: the support mask
+    const DegreeFlowMatrixView<uint8_t>& result,
+    // Result: the supports for all sparsities up to k (can be NULL)
+    DegreeFlowSolutionPath* solution_path) {
+  double begin_time = WallTime();
+  stats_.Clear();
+  if (result.num_rows != x.num_rows || result.num_cols != x.num_cols) {
+    snprintf(output_buffer_, kOutputBufferSize, "The support mask must have "
+             "the same dimensions as the signal.");
+    output_function(output_buffer_);
+    return false;
+  }
+  SupportOutput output;
+  output.mask = result;
+  return SolveView(ConvertSignal(x), k, row_degrees, col_degrees, options,
+                   verbose, output_function, output, solution_path,
+                   begin_time);
+}
+
+bool DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const DegreeFlowMatrixView<const double>& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: the (row, column) indices of the support
+    vector<pair<uint32_t, uint32_t> >* result,
+    // Result: the supports for all sparsities up to k (can be NULL)
+    DegreeFlowSolutionPath* solution_path) {
+  double begin_time = WallTime();
+  stats_.Clear();
+  SupportOutput output;
+  output.indices = result;
+  return SolveView(x, k, row_degrees, col_degrees, options, verbose,
+                   output_function, output, solution_path, begin_time);
+}
+
+bool DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const DegreeFlowMatrixView<const double>& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: the entries of the support
+    DegreeFlowSupport* result,
+    // Result: the supports for all sparsities up to k (can be NULL)
+    DegreeFlowSolutionPath* solution_path) {
+  double begin_time = WallTime();
+  stats_.Clear();
+  SupportOutput output;
+  output.entries = result;
+  return SolveView(x, k, row_degrees, col_degrees, options, verbose,
+                   output_function, output, solution_path, begin_time);
+}
+
+bool DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const DegreeFlowMatrixView<const float>& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: the (row, column) indices of the support
+    vector<pair<uint32_t, uint32_t> >* result,
+    // Result: the supports for all sparsities up to k (can be NULL)
+    DegreeFlowSolutionPath* solution_path) {
+  double begin_time = WallTime();
+  stats_.Clear();
+  SupportOutput output;
+  output.indices = result;
+  return SolveView(ConvertSignal(x), k, row_degrees, col_degrees, options,
+                   verbose, output_function, output, solution_path,
+                   begin_time);
+}
+
+// Float amplitudes are converted in the layout of the view, so they are
+// solved exactly like double amplitudes in the same layout.
+DegreeFlowMatrixView<const double> DegreeFlowSolver::ConvertSignal(
+    const DegreeFlowMatrixView<const float>& x) {
+  converted_x_.resize(x.num_rows * x.num_cols);
+  if (converted_x_.empty() || x.data == NULL) {
+    return DegreeFlowMatrixView<const double>(NULL, x.num_rows, x.num_cols,
+                                              0, 0);
+  }
+  DegreeFlowMatrixView<double> converted;
+  if (x.row_stride == 1 && x.col_stride != 1) {
+    converted = DegreeFlowMatrixView<double>::ColumnMajor(&converted_x_[0],
+        x.num_rows, x.num_cols);
+  } else {
+    converted = DegreeFlowMatrixView<double>::RowMajor(&converted_x_[0],
+        x.num_rows, x.num_cols);
+  }
+  for (size_t row = 0; row < x.num_rows; ++row) {
+    for (size_t col = 0; col < x.num_cols; ++col) {
+      converted(row, col) = x(row, col);
+    }
+  }
+  return DegreeFlowMatrixView<const double>(converted.data, x.num_rows,
+      x.num_cols, converted.row_stride, converted.col_stride);
+}
+
+bool DegreeFlowSolver::SolveView(const DegreeFlowMatrixView<const double>& x,
+    int k, const vector<int>& row_degrees, const vector<int>& col_degrees,
+    const DegreeFlowOptions& options, bool verbose,
+    void (*output_function)(const char*), const SupportOutput& result,
+    DegreeFlowSolutionPath* solution_path, double begin_time) {
+  if (x.num_rows == 0 || x.num_cols == 0 || x.data == NULL) {
+    snprintf(output_buffer_, kOutputBufferSize, "Signal must have at least one "
+             "row and one column.");
+    output_function(output_buffer_);
+    result.Reset(x.num_rows, x.num_cols);
+    return false;
+  }
+
+  // The solver reads rows, so a column-major signal is solved as its
+  // transpose, whose rows are contiguous.
+  bool transposed = (x.col_stride != 1 && x.num_cols > 1
+                     && (x.row_stride == 1 || x.num_rows == 1));
+  DegreeFlowMatrixView<const double> rows_view = x;
+  SupportOutput output = result;
+  if (transposed) {
+    rows_view = x.Transposed();
+    output.mask = result.mask.Transposed();
+  }
+  DenseSignal signal;
+  signal.num_rows = rows_view.num_rows;
+  signal.num_cols = rows_view.num_cols;
+  signal_rows_.resize(signal.num_rows);
+  if (rows_view.col_stride == 1 || signal.num_cols == 1) {
+    for (size_t row = 0; row < signal.num_rows; ++row) {
+      signal_rows_[row] = &rows_view(row, 0);
+    }
+  } else {
+    signal_copy_.resize(signal.num_rows * signal.num_cols);
+    for (size_t row = 0; row < signal.num_rows; ++row) {
+      for (size_t col = 0; col < signal.num_cols; ++col) {
+        signal_copy_[signal.num_cols * row + col] = rows_view(row, col);
+      }
+      signal_rows_[row] = &signal_copy_[signal.num_cols * row];
+    }
+  }
+  signal.rows = &signal_rows_[0];
+
+  bool success = SolveDenseSignal(signal, k,
+                                  transposed ? col_degrees : row_degrees,
+                                  transposed ? row_degrees : col_degrees,
+                                  options, verbose, output_function, output,
+                                  solution_path);
+  if (!success) {
+    output.Reset(signal.num_rows, signal.num_cols);
+  } else if (transposed) {
+    // Back to the row-major order of the caller
+    if (output.indices != NULL) {
+      for (size_t ii = 0; ii < output.indices->size(); ++ii) {
+        swap((*output.indices)[ii].first, (*output.indices)[ii].second);
+      }
+      sort(output.indices->begin(), output.indices->end());
+    }
+    if (output.entries != NULL) {
+      vector<DegreeFlowSupport::Entry>& entries = output.entries->entries;
+      for (size_t ii = 0; ii < entries.size(); ++ii) {
+        swap(entries[ii].row, entries[ii].col);
+      }
+      sort(entries.begin(), entries.end(), EntryLess);
+      swap(output.entries->num_rows, output.entries->num_cols);
+    }
+    if (solution_path != NULL) {
+      swap(solution_path->num_rows, solution_path->num_cols);
+      for (size_t ii = 0; ii < solution_path->changes.size(); ++ii) {
+        swap(solution_path->changes[ii].row, solution_path->changes[ii].col);
+      }
+    }
+    if (options.certificate) {
+      TransposeCertificate(&certificate_);
+    }
+  }
+  FinishStats(begin_time);
+  return success;
+}
+
+void DegreeFlowSolver::SupportOutput::Reset(size_t num_rows,
+                                            size_t num_cols) const {
+  if (matrix != NULL) {
+    matrix->resize(num_rows);
+    for (size_t row = 0; row < num_rows; ++row) {
+      (*matrix)[row].assign(num_cols, false);
+    }
+  } else if (indices != NULL) {
+    indices->clear();
+  } else if (entries != NULL) {
+    entries->Clear(num_rows, num_cols);
+  } else {
+    for (size_t row = 0; row < num_rows; ++row) {
+      for (size_t col = 0; col < num_cols; ++col) {
+        mask(row, col) = 0;
+      }
+    }
+  }
+}
+
+void DegreeFlowSolver::Solve(
+    // signal coefficients (will not be squared)
+    const DegreeFlowSparseMatrix& x,
+    // Total sparsity
+    int k,
+    // Row degrees
+    const vector<int>& row_degrees,
+    // Column degrees
+    const vector<int>& col_degrees,
+    // Solver options
+    const DegreeFlowOptions& options,
+    // Verbose output?
+    bool verbose,
+    // The output function
+    void (*output_function)(const char*),
+    // Result: result[i] is true iff the i-th stored entry of x is in the
+    // support
+    vector<bool>* result) {
+  double begin_time = WallTime();
+  if (IsSubproblem()) {
+    SolveSparseSignal(x, k, row_degrees, col_degrees, options, verbose,
+                      output_function, result);
+    return;
+  }
+  stats_.Clear();
+  SolveSparseSignal(x, k, row_degrees, col_degrees, options, verbose,
+                    output_function, result);
+  FinishStats(begin_time);
+}
+
+void DegreeFlowSolver::FinishStats(double begin_time) {
+  stats_.total_time = WallTime() - begin_time;
+  stats_.engine = engine_;
+  stats_.allocated_bytes = ComputeAllocatedBytes();
+}
+
+size_t DegreeFlowSolver::ComputeAllocatedBytes() const {
+  size_t bytes = VectorBytes(edge_capacity_) + VectorBytes(adjacency_offset_)
+                 + VectorBytes(arc_edge_) + VectorBytes(arc_to_)
+                 + VectorBytes(arc_cost_) + VectorBytes(adjacency_end_)
+                 + VectorBytes(excess_) + VectorBytes(selected_)
+                 + VectorBytes(row_degree_) + VectorBytes(col_degree_)
+                 + VectorBytes(row_flow_) + VectorBytes(col_flow_)
+                 + VectorBytes(settled_) + VectorBytes(potential_)
+                 + VectorBytes(row_match_) + VectorBytes(col_match_)
+                 + VectorBytes(row_potential_) + VectorBytes(col_potential_)
+                 + VectorBytes(free_row_min_) + VectorBytes(free_row_argmin_)
+                 + VectorBytes(col_dst_) + VectorBytes(col_settled_)
+                 + VectorBytes(col_parent_) + VectorBytes(col_relaxed_dst_)
+                 + VectorBytes(row_dst_)
+                 + VectorBytes(settled_cols_) + VectorBytes(settled_rows_)
+                 + VectorBytes(scaled_cost_) + VectorBytes(price_)
+                 + VectorBytes(active_nodes_) + VectorBytes(pruned_support_)
+                 + VectorBytes(row_dual_) + VectorBytes(col_dual_)
+                 + VectorBytes(node_potential_)
+                 + VectorBytes(visited_) + VectorBytes(dst_)
+                 + VectorBytes(edge_taken_to_) + VectorBytes(parent_)
+                 + lazy_heap_.allocated_bytes()
+                 + indexed_heap_.allocated_bytes()
+                 + radix_heap_.allocated_bytes()
+                 + bucket_queue_.allocated_bytes()
+                 + VectorBytes(signal_rows_) + VectorBytes(signal_copy_)
+                 + VectorBytes(converted_x_) + VectorBytes(support_entries_)
+                 + VectorBytes(quantized_x_) + VectorBytes(quantized_rows_)
+                 + SparseMatrixBytes(quantized_sparse_x_)
+                 + VectorBytes(quantization_errors_)
+                 + VectorBytes(compact_row_index_)
+                 + VectorBytes(compact_col_index_)
+                 + VectorBytes(compact_row_degrees_)
+                 + VectorBytes(compact_col_degrees_)
+                 + VectorBytes(compact_x_) + VectorBytes(compact_rows_)
+                 + VectorBytes(compact_support_)
+                 + VectorBytes(is_candidate_) + SparseMatrixBytes(candidates_)
+                 + VectorBytes(candidate_result_)
+                 + VectorBytes(candidate_order_) + VectorBytes(level_)
+                 + VectorBytes(current_arc_) + VectorBytes(bfs_queue_);
+  return bytes;
+}
+
+bool DegreeFlowSolver::SolveDenseSignal(const DenseSignal& x, int k,
+    const vector<int>& row_degrees, const vector<int>& col_degrees,
+    const DegreeFlowOptions& options, bool verbose,
+    void (*output_function)(const char*), const SupportOutput& result,
+    DegreeFlowSolutionPath* solution_path) {
+  double begin_time = WallTime();
+  if (!IsSubproblem() && !compacting_) {
+    // The subproblems share the deadline of the outermost call.
+    deadline_ = begin_time + options.time_limit;
+  }
+  num_rows_ = x.num_rows;
+  num_cols_ = x.num_cols;
+
+  // Compaction comes first, so that the other stages only see the rows and
+  // columns that can be in the support.
+  if (options.compaction && NeedsCompaction(row_degrees, col_degrees)) {
+    return SolveCompacted(x, k, row_degrees, col_degrees, options, verbose,
+                          output_function, result, solution_path);
+  }
+
+  if (options.quantization_precision > 0.0) {
+    return SolveQuantized(x, k, row_degrees, col_degrees, options, verbose,
+                          output_function, result, solution_path);
+  }
+  quantization_loss_bound_ = 0.0;
+
+  if (options.pruning_candidates > 0 && solution_path == NULL) {
+    return SolvePruned(x, k, row_degrees, col_degrees, options, verbose,
+                       output_function, result);
+  }
+
+  // All edge indices of the materialized graph must fit into an EdgeIndex.
+  num_entries_ = num_rows_ * num_cols_;
+  bool graph_fits = (num_entries_ + num_rows_ + num_cols_
+                     <= numeric_limits<EdgeIndex>::max() / 2);
+  engine_ = options.engine;
+  bool is_assignment = DegreesAreAssignment(row_degrees, col_degrees);
+  if (engine_ == DegreeFlowOptions::kAutomaticEngine && is_assignment
+      && !options.warm_start) {
+    // The matching needs O(r + c) memory, and a search scans at most one
+    // row of the input per settled column.
+    engine_ = DegreeFlowOptions::kAssignmentEngine;
+  } else if (engine_ == DegreeFlowOptions::kAutomaticEngine) {
+    // The dense engine spends O(V^2) time per shortest path, the heap-based
+    // graph engine O(E log V). Only rows with positive degree contribute
+    // entry arcs, so very rectangular inputs and inputs with few active rows
+    // give sparse flow graphs.
+    size_t num_active_rows = 0;
+    for (size_t row = 0; row < num_rows_ && row < row_degrees.size(); ++row) {
+      if (row_degrees[row] > 0) {
+        num_active_rows += 1;
+      }
+    }
+    double num_entry_arcs = static_cast<double>(num_active_rows) * num_cols_;
+    double num_graph_nodes = static_cast<double>(num_rows_ + num_cols_ + 2);
+    double density = num_entry_arcs / (num_graph_nodes * num_graph_nodes);
+    // Only the graph engine supports warm starts.
+    if (!graph_fits
+        || (!options.warm_start && density >= kDenseEngineMinDensity)) {
+      engine_ = DegreeFlowOptions::kDenseEngine;
+    } else {
+      engine_ = DegreeFlowOptions::kGraphEngine;
+    }
 
-typedef size_t NodeIndex;
-typedef size_t EdgeIndex;
+    // Successive shortest paths need one shortest path per augmentation,
+    // cost scaling a number of passes over the arcs that hardly depends on
+    // k. Compare the work of the augmentations with the cost of a few
+    // hundred passes.
+    double num_augmentations = min(static_cast<double>(k),
+        static_cast<double>(MaxFlowBound(row_degrees, col_degrees)));
+    double path_work = num_entry_arcs * log(num_graph_nodes) / log(2.0);
+    if (engine_ == DegreeFlowOptions::kDenseEngine) {
+      path_work = num_graph_nodes * num_graph_nodes;
+    }
+    // The rounding of cost scaling must not break ties that the other
+    // engines resolve, so very large graphs stay with the shortest paths.
+    bool rounding_fits = (0.5 / CostScalingMaxRoundedCost(
+        num_rows_ + num_cols_ + 2) <= kAdmissibleTolerance);
+    if (graph_fits && rounding_fits && !options.warm_start
+        && solution_path == NULL
+        && num_augmentations * path_work
+           >= kCostScalingMinWork * num_entry_arcs) {
+      engine_ = DegreeFlowOptions::kCostScalingEngine;
+    }
+  }
+  if ((engine_ == DegreeFlowOptions::kGraphEngine
+       || engine_ == DegreeFlowOptions::kCostScalingEngine) && !graph_fits) {
+    snprintf(output_buffer_, kOutputBufferSize, "The signal is too large for "
+             "the %s engine, the graph can have at most %u edges.",
+             DegreeFlowOptions::EngineName(engine_),
+             numeric_limits<EdgeIndex>::max());
+    output_function(output_buffer_);
+    return false;
+  }
+  if (engine_ == DegreeFlowOptions::kAssignmentEngine && !is_assignment) {
+    snprintf(output_buffer_, kOutputBufferSize, "The assignment engine "
+             "requires all degrees to be 0 or 1.");
+    output_function(output_buffer_);
+    return false;
+  }
+  if (engine_ == DegreeFlowOptions::kCostScalingEngine
+      && solution_path != NULL) {
+    snprintf(output_buffer_, kOutputBufferSize, "The cost scaling engine "
+             "cannot record a solution path.");
+    output_function(output_buffer_);
+    return false;
+  }
 
-struct Edge {
-  NodeIndex to;
-  int capacity;
-  double cost;
-  EdgeIndex opposite;
+  // A warm start needs the flow of the previous solve, which only the graph
+  // engine keeps, on a graph with the same structure.
+  bool warm_start = options.warm_start && solution_path == NULL
+                    && warm_start_valid_
+                    && engine_ == DegreeFlowOptions::kGraphEngine
+                    && row_degrees == row_degree_
+                    && col_degrees == col_degree_
+                    && warm_start_precision_ == quantization_precision_;
+  warm_start_valid_ = false;
+  warm_start_precision_ = quantization_precision_;
+  row_degree_.assign(row_degrees.begin(), row_degrees.end());
+  col_degree_.assign(col_degrees.begin(), col_degrees.end());
 
-  Edge(NodeIndex _to, int _capacity, double _cost, EdgeIndex _opposite)
-    : to(_to), capacity(_capacity), cost(_cost), opposite(_opposite) { }
-};
+  SetQueueType(options.queue);
+  x_ = x;
+  solution_path_ = solution_path;
+  path_objective_ = 0.0;
+  if (solution_path_ != NULL) {
+    solution_path_->Clear(num_rows_, num_cols_);
+  }
 
-size_t num_nodes;
-size_t num_connected_nodes;
-size_t num_rows;
-size_t num_cols;
-// source, sing
-NodeIndex s, t;
-// edges leaving a node
-vector<vector<EdgeIndex> > outgoing_edges;
-// set of all edges
-vector<Edge> e;
+  if (verbose) {
+    snprintf(output_buffer_, kOutputBufferSize, "r = %zd,  c = %zd,  k = %d\n",
+        num_rows_, num_cols_, k);
+    output_function(output_buffer_);
+  }
 
-// node potentials
-vector<double> potential;
+  if (options.blocking_flow || warm_start) {
+    // Reduced costs that should be zero are only zero up to rounding errors,
+    // which scale with the magnitude of the costs.
+    double max_abs_cost = 0.0;
+    for (size_t row = 0; row < num_rows_; ++row) {
+      for (size_t col = 0; col < num_cols_; ++col) {
+        max_abs_cost = max(max_abs_cost, abs(x[row][col]));
+      }
+    }
+    admissible_tolerance_ = kAdmissibleTolerance * max_abs_cost;
+  }
+
+  double phase_begin = WallTime();
+  if (engine_ == DegreeFlowOptions::kDenseEngine) {
+    BuildDenseGraph(x);
+  } else if (engine_ == DegreeFlowOptions::kAssignmentEngine) {
+    BuildAssignment(x);
+  } else {
+    BuildGraph(x, row_degrees, col_degrees, warm_start);
+  }
+  double phase_end = WallTime();
+  double construction_time = phase_end - phase_begin;
+  stats_.phase_times.graph_build += phase_end - phase_begin;
+
+  phase_begin = phase_end;
+  int num_selected = 0;
+  if (engine_ == DegreeFlowOptions::kDenseEngine) {
+    ComputeInitialPotentialsDense();
+  } else if (engine_ == DegreeFlowOptions::kAssignmentEngine) {
+    ComputeInitialPotentialsAssignment();
+  } else if (warm_start) {
+    RepairFlow();
+    num_selected = flow_value_;
+  } else if (engine_ != DegreeFlowOptions::kCostScalingEngine) {
+    ComputeInitialPotentials();
+  }
+  phase_end = WallTime();
+  construction_time += phase_end - phase_begin;
+  stats_.phase_times.initial_potentials += phase_end - phase_begin;
+
+  if (verbose) {
+    snprintf(output_buffer_, kOutputBufferSize, "Engine: %s\n",
+             DegreeFlowOptions::EngineName(engine_));
+    output_function(output_buffer_);
+    if (engine_ == DegreeFlowOptions::kDenseEngine) {
+      snprintf(output_buffer_, kOutputBufferSize, "The implicit dense graph "
+          "has %zd nodes.\n", num_nodes_);
+    } else if (engine_ == DegreeFlowOptions::kAssignmentEngine) {
+      snprintf(output_buffer_, kOutputBufferSize, "Assignment problem with "
+          "%zd rows and %zd columns.\n", num_rows_, num_cols_);
+    } else {
+      snprintf(output_buffer_, kOutputBufferSize, "The graph has %zd nodes "
+          "and %zd edges.\n", num_nodes_, edge_capacity_.size());
+    }
+    output_function(output_buffer_);
+    if (warm_start) {
+      snprintf(output_buffer_, kOutputBufferSize, "Warm start from %d "
+          "entries, %lld entries changed by the repair.\n", num_selected,
+          stats_.num_repriced_entries);
+      output_function(output_buffer_);
+    }
+    snprintf(output_buffer_, kOutputBufferSize, "Total construction time: %f "
+        "s\n", construction_time);
+    output_function(output_buffer_);
+  }
+
+  phase_begin = WallTime();
+  if (engine_ == DegreeFlowOptions::kCostScalingEngine) {
+    num_selected = SolveCostScaling(k, options);
+    if (num_selected < k && !StoppedEarly()) {
+      snprintf(output_buffer_, kOutputBufferSize, "Could not fit %d "
+               "nonzeros into the matrix, the support has %d nonzeros.\n",
+               k, num_selected);
+      output_function(output_buffer_);
+    }
+  } else {
+    num_selected = AugmentToSparsity(k, num_selected, options, verbose,
+                                     output_function);
+  }
+  stats_.phase_times.augmentation += WallTime() - phase_begin;
+
+  flow_value_ = num_selected;
+  warm_start_valid_ = (engine_ == DegreeFlowOptions::kGraphEngine);
+  WriteSupport(result);
+  objective_ = 0.0;
+  for (size_t ii = 0; ii < support_entries_.size(); ++ii) {
+    objective_ += abs(x[support_entries_[ii] / num_cols_]
+                       [support_entries_[ii] % num_cols_]);
+  }
+  objective_bound_ = objective_;
+  if (StoppedEarly()) {
+    ComputeDuals(1.0, false, k);
+    objective_bound_ = DualBound(x);
+  }
+  if (options.certificate && !IsSubproblem()) {
+    ExportCertificate(x, k, 1.0);
+  }
+
+  if (verbose) {
+    if (StoppedEarly() && !IsSubproblem()) {
+      snprintf(output_buffer_, kOutputBufferSize, "Stopped early (%s) with "
+               "%d entries, the optimum is at most %g.\n",
+               DegreeFlowStats::TerminationName(stats_.termination),
+               num_selected, objective_bound_);
+      output_function(output_buffer_);
+    }
+    OutputDiagnostics(WallTime() - begin_time, output_function);
+  }
+  return true;
+}
+
+void DegreeFlowSolver::WriteSupport(const SupportOutput& result) {
+  CompactSupportEntries();
+  result.Reset(num_rows_, num_cols_);
+  for (size_t ii = 0; ii < support_entries_.size(); ++ii) {
+    size_t row = support_entries_[ii] / num_cols_;
+    size_t col = support_entries_[ii] % num_cols_;
+    result.Add(row, col, x_[row][col]);
+  }
+}
+
+void DegreeFlowSolver::SolveSparseSignal(const DegreeFlowSparseMatrix& x,
+    int k, const vector<int>& row_degrees, const vector<int>& col_degrees,
+    const DegreeFlowOptions& options, bool verbose,
+    void (*output_function)(const char*), vector<bool>* result) {
+  double begin_time = WallTime();
+  if (!IsSubproblem()) {
+    deadline_ = begin_time + options.time_limit;
+  }
+
+  if (!CheckSparseMatrix(x, output_function)) {
+    result->clear();
+    return;
+  }
+  if (options.quantization_precision > 0.0) {
+    SolveQuantized(x, k, row_degrees, col_degrees, options, verbose,
+                   output_function, result);
+    return;
+  }
+  quantization_loss_bound_ = 0.0;
+  num_rows_ = x.num_rows;
+  num_cols_ = x.num_cols;
+  num_entries_ = x.num_entries();
+  if (num_entries_ + num_rows_ + num_cols_
+      > numeric_limits<EdgeIndex>::max() / 2) {
+    snprintf(output_buffer_, kOutputBufferSize, "The signal has too many "
+             "entries, the graph can have at most %u edges.",
+             numeric_limits<EdgeIndex>::max());
+    output_function(output_buffer_);
+    result->clear();
+    return;
+  }
+
+  engine_ = DegreeFlowOptions::kGraphEngine;
+  warm_start_valid_ = false;
+  row_degree_.assign(row_degrees.begin(), row_degrees.end());
+  col_degree_.assign(col_degrees.begin(), col_degrees.end());
+  SetQueueType(options.queue);
+  x_ = DenseSignal();
+  solution_path_ = NULL;
+  path_objective_ = 0.0;
+
+  if (verbose) {
+    snprintf(output_buffer_, kOutputBufferSize, "r = %zd,  c = %zd,  "
+        "nnz = %zd,  k = %d\n", num_rows_, num_cols_, num_entries_, k);
+    output_function(output_buffer_);
+  }
+
+  if (options.blocking_flow) {
+    double max_abs_cost = 0.0;
+    for (size_t entry = 0; entry < num_entries_; ++entry) {
+      max_abs_cost = max(max_abs_cost, abs(x.value[entry]));
+    }
+    admissible_tolerance_ = kAdmissibleTolerance * max_abs_cost;
+  }
+
+  double phase_begin = WallTime();
+  BuildSparseGraph(x, row_degrees, col_degrees);
+  double phase_end = WallTime();
+  stats_.phase_times.graph_build += phase_end - phase_begin;
+  ComputeInitialPotentials();
+  stats_.phase_times.initial_potentials += WallTime() - phase_end;
+  double construction_time = WallTime() - phase_begin;
+  if (verbose) {
+    snprintf(output_buffer_, kOutputBufferSize, "The graph has %zd nodes "
+        "and %zd edges.\n", num_nodes_, edge_capacity_.size());
+    output_function(output_buffer_);
+    snprintf(output_buffer_, kOutputBufferSize, "Total construction time: %f "
+        "s\n", construction_time);
+    output_function(output_buffer_);
+  }
+
+  phase_begin = WallTime();
+  flow_value_ = AugmentToSparsity(k, 0, options, verbose, output_function);
+  stats_.phase_times.augmentation += WallTime() - phase_begin;
+
+  result->resize(num_entries_);
+  objective_ = 0.0;
+  for (size_t entry = 0; entry < num_entries_; ++entry) {
+    (*result)[entry] = (edge_capacity_[EntryEdgeIndex(entry)] == 0);
+    if ((*result)[entry]) {
+      objective_ += abs(x.value[entry]);
+    }
+  }
+  objective_bound_ = objective_;
+  if (StoppedEarly()) {
+    ComputeDuals(1.0, false, k);
+    objective_bound_ = DualBound(x);
+  }
+  if (options.certificate && !IsSubproblem()) {
+    ExportCertificate(x, k, 1.0);
+  }
+
+  if (verbose) {
+    // Pruned and quantized solves replace the bound of their subproblems.
+    if (StoppedEarly() && !IsSubproblem()) {
+      snprintf(output_buffer_, kOutputBufferSize, "Stopped early (%s) with "
+               "%d entries, the optimum is at most %g.\n",
+               DegreeFlowStats::TerminationName(stats_.termination),
+               flow_value_, objective_bound_);
+      output_function(output_buffer_);
+    }
+    OutputDiagnostics(WallTime() - begin_time, output_function);
+  }
+}
+
+// The bucket queue needs integer distances, i.e., quantized costs.
+void DegreeFlowSolver::SetQueueType(DegreeFlowOptions::Queue queue) {
+  queue_type_ = queue;
+  if (queue_type_ == DegreeFlowOptions::kBucketQueue
+      && quantization_precision_ == 0.0) {
+    queue_type_ = DegreeFlowOptions::kIndexedHeapQueue;
+  }
+}
+
+// Solves the problem for the quantized amplitudes round(|x| / precision).
+// All costs are then integers, and as long as all potentials stay below
+// 2^53 (see CheckQuantization), the shortest path computations in double
+// precision are exact.
+bool DegreeFlowSolver::SolveQuantized(const DenseSignal& x, int k,
+                                      const vector<int>& row_degrees,
+                                      const vector<int>& col_degrees,
+                                      const DegreeFlowOptions& options,
+                                      bool verbose,
+                                      void (*output_function)(const char*),
+                                      const SupportOutput& result,
+                                      DegreeFlowSolutionPath* solution_path) {
+  double precision = options.quantization_precision;
+  double max_abs_amplitude = 0.0;
+  for (size_t row = 0; row < x.num_rows; ++row) {
+    for (size_t col = 0; col < x.num_cols; ++col) {
+      max_abs_amplitude = max(max_abs_amplitude, abs(x[row][col]));
+    }
+  }
+  if (!CheckQuantization(max_abs_amplitude, precision,
+                         x.num_rows + x.num_cols + 2, output_function)) {
+    return false;
+  }
+
+  quantization_errors_.clear();
+  quantized_x_.resize(x.num_rows * x.num_cols);
+  quantized_rows_.resize(x.num_rows);
+  for (size_t row = 0; row < x.num_rows; ++row) {
+    double* quantized_row = &quantized_x_[x.num_cols * row];
+    quantized_rows_[row] = quantized_row;
+    for (size_t col = 0; col < x.num_cols; ++col) {
+      quantized_row[col] = Quantize(x[row][col], precision,
+          row_degrees[row] > 0 && col_degrees[col] > 0);
+    }
+  }
+  DenseSignal quantized_signal = x;
+  quantized_signal.rows = &quantized_rows_[0];
+
+  quantization_precision_ = precision;
+  bool success = SolveDenseSignal(quantized_signal, k, row_degrees,
+      col_degrees, QuantizedOptions(options, Quantize(max_abs_amplitude,
+                                                      precision, false)),
+      verbose, output_function, result, solution_path);
+  quantization_precision_ = 0.0;
+  if (!success) {
+    return false;
+  }
+
+  double support_error = 0.0;
+  if (result.indices != NULL) {
+    for (size_t ii = 0; ii < result.indices->size(); ++ii) {
+      size_t row = (*result.indices)[ii].first;
+      size_t col = (*result.indices)[ii].second;
+      support_error += abs(x[row][col])
+                       - precision * quantized_signal[row][col];
+    }
+  } else if (result.entries != NULL) {
+    // The entries carry the quantized amplitudes so far.
+    result.entries->objective = 0.0;
+    for (size_t ii = 0; ii < result.entries->entries.size(); ++ii) {
+      DegreeFlowSupport::Entry& entry = result.entries->entries[ii];
+      entry.amplitude = x[entry.row][entry.col];
+      result.entries->objective += abs(entry.amplitude);
+      support_error += abs(entry.amplitude)
+                       - precision * quantized_signal[entry.row][entry.col];
+    }
+  } else {
+    for (size_t row = 0; row < x.num_rows; ++row) {
+      for (size_t col = 0; col < x.num_cols; ++col) {
+        if (result.Contains(row, col)) {
+          support_error += abs(x[row][col])
+                           - precision * quantized_signal[row][col];
+        }
+      }
+    }
+  }
+  if (solution_path != NULL) {
+    // The path contains the objectives of the quantized amplitudes.
+    double objective = 0.0;
+    for (int kk = 0; kk < solution_path->max_k(); ++kk) {
+      for (size_t ii = solution_path->change_begin[kk];
+           ii < solution_path->change_begin[kk + 1]; ++ii) {
+        const DegreeFlowSolutionPath::Change& change =
+            solution_path->changes[ii];
+        if (change.added) {
+          objective += abs(x[change.row][change.col]);
+        } else {
+          objective -= abs(x[change.row][change.col]);
+        }
+      }
+      solution_path->objective[kk] = objective;
+    }
+  }
+  ComputeQuantizationLossBound(k, support_error, verbose, output_function);
+  objective_ = precision * objective_ + support_error;
+  SetQuantizedObjectiveBound(x, k, precision, support_error);
+  if (options.certificate && !IsSubproblem()) {
+    ExportCertificate(x, k, precision);
+  }
+  return true;
+}
+
+void DegreeFlowSolver::SolveQuantized(const DegreeFlowSparseMatrix& x, int k,
+                                      const vector<int>& row_degrees,
+                                      const vector<int>& col_degrees,
+                                      const DegreeFlowOptions& options,
+                                      bool verbose,
+                                      void (*output_function)(const char*),
+                                      vector<bool>* result) {
+  double precision = options.quantization_precision;
+  double max_abs_amplitude = 0.0;
+  for (size_t entry = 0; entry < x.num_entries(); ++entry) {
+    max_abs_amplitude = max(max_abs_amplitude, abs(x.value[entry]));
+  }
+  if (!CheckQuantization(max_abs_amplitude, precision,
+                         x.num_rows + x.num_cols + 2, output_function)) {
+    result->clear();
+    return;
+  }
+
+  quantization_errors_.clear();
+  quantized_sparse_x_.num_rows = x.num_rows;
+  quantized_sparse_x_.num_cols = x.num_cols;
+  quantized_sparse_x_.row_offset = x.row_offset;
+  quantized_sparse_x_.col_index = x.col_index;
+  quantized_sparse_x_.value.resize(x.num_entries());
+  for (size_t row = 0; row < x.num_rows; ++row) {
+    for (size_t entry = x.row_offset[row]; entry < x.row_offset[row + 1];
+         ++entry) {
+      quantized_sparse_x_.value[entry] = Quantize(x.value[entry], precision,
+          row_degrees[row] > 0 && col_degrees[x.col_index[entry]] > 0);
+    }
+  }
+
+  quantization_precision_ = precision;
+  Solve(quantized_sparse_x_, k, row_degrees, col_degrees,
+        QuantizedOptions(options, Quantize(max_abs_amplitude, precision,
+                                           false)),
+        verbose, output_function, result);
+  quantization_precision_ = 0.0;
+  if (result->empty()) {
+    return;
+  }
+
+  double support_error = 0.0;
+  for (size_t entry = 0; entry < x.num_entries(); ++entry) {
+    if ((*result)[entry]) {
+      support_error += abs(x.value[entry])
+                       - precision * quantized_sparse_x_.value[entry];
+    }
+  }
+  ComputeQuantizationLossBound(k, support_error, verbose, output_function);
+  objective_ = precision * objective_ + support_error;
+  SetQuantizedObjectiveBound(x, k, precision, support_error);
+  if (options.certificate && !IsSubproblem()) {
+    ExportCertificate(x, k, precision);
+  }
+}
+
+// Replaces the objective bound of the quantized problem by a bound for the
+// original amplitudes x. The bound of a complete solve is the original
+// objective of the support plus the quantization loss bound. After an early
+// stop, the potentials (in units of the precision) give duals for the
+// original amplitudes.
+template <typename Signal>
+void DegreeFlowSolver::SetQuantizedObjectiveBound(const Signal& x, int k,
+                                                  double precision,
+                                                  double support_error) {
+  if (StoppedEarly()) {
+    ComputeDuals(precision, false, k);
+    objective_bound_ = DualBound(x);
+  } else {
+    objective_bound_ = precision * objective_bound_
+                       + support_error + quantization_loss_bound_;
+  }
+}
+
+bool DegreeFlowSolver::CheckQuantization(
+    double max_abs_amplitude, double precision, size_t num_nodes,
+    void (*output_function)(const char*)) {
+  if (max_abs_amplitude / precision * num_nodes > kMaxQuantizedPathCost) {
+    snprintf(output_buffer_, kOutputBufferSize, "The quantization precision "
+             "%g is too fine for the amplitudes, it must be at least %g.",
+             precision,
+             max_abs_amplitude * num_nodes / kMaxQuantizedPathCost);
+    output_function(output_buffer_);
+    return false;
+  }
+  return true;
+}
+
+// The options of the solve on the quantized amplitudes
+DegreeFlowOptions DegreeFlowSolver::QuantizedOptions(
+    const DegreeFlowOptions& options, double max_quantized_amplitude) const {
+  DegreeFlowOptions quantized_options = options;
+  quantized_options.quantization_precision = 0.0;
+  if (max_quantized_amplitude <= kMaxBucketQueueCost) {
+    quantized_options.queue = DegreeFlowOptions::kBucketQueue;
+  } else {
+    quantized_options.queue = DegreeFlowOptions::kRadixHeapQueue;
+  }
+  return quantized_options;
+}
+
+// Returns round(|amplitude| / precision). If the entry can be in the
+// support (eligible), a positive rounding error is recorded for the loss
+// bound.
+double DegreeFlowSolver::Quantize(double amplitude, double precision,
+                                  bool eligible) {
+  double quantized = floor(abs(amplitude) / precision + 0.5);
+  double error = abs(amplitude) - precision * quantized;
+  if (eligible && error > 0.0) {
+    quantization_errors_.push_back(error);
+  }
+  return quantized;
+}
+
+// Let e(S) be the sum of the rounding errors |x| - precision * quantized of
+// a support S. The returned support S is optimal for the quantized
+// amplitudes, so for an optimal support S* of the original amplitudes,
+// f(S*) - f(S) <= e(S*) - e(S). Since S* has at most k entries, e(S*) is at
+// most the sum of the k largest positive rounding errors.
+void DegreeFlowSolver::ComputeQuantizationLossBound(
+    int k, double support_error, bool verbose,
+    void (*output_function)(const char*)) {
+  size_t num_largest = min(quantization_errors_.size(),
+                           static_cast<size_t>(max(k, 0)));
+  nth_element(quantization_errors_.begin(),
+              quantization_errors_.begin() + num_largest,
+              quantization_errors_.end(), greater<double>());
+  double largest_errors = 0.0;
+  for (size_t ii = 0; ii < num_largest; ++ii) {
+    largest_errors += quantization_errors_[ii];
+  }
+  quantization_loss_bound_ = max(0.0, largest_errors - support_error);
+
+  if (verbose) {
+    snprintf(output_buffer_, kOutputBufferSize, "The objective is at most %g "
+             "below the optimum because of the quantization.\n",
+             quantization_loss_bound_);
+    output_function(output_buffer_);
+  }
+}
+
+// A row can only be matched with the columns of positive degree and vice
+// versa. Compaction pays off if a row or column has degree 0 or a degree
+// larger than the number of its partners. Without any partner, the solver
+// handles the empty problem itself.
+bool DegreeFlowSolver::NeedsCompaction(const vector<int>& row_degrees,
+                                       const vector<int>& col_degrees) const {
+  int num_active_rows = 0;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degrees[row] > 0) {
+      num_active_rows += 1;
+    }
+  }
+  int num_active_cols = 0;
+  for (size_t col = 0; col < num_cols_; ++col) {
+    if (col_degrees[col] > 0) {
+      num_active_cols += 1;
+    }
+  }
+  if (num_active_rows == 0 || num_active_cols == 0) {
+    return false;
+  }
+  if (static_cast<size_t>(num_active_rows) < num_rows_
+      || static_cast<size_t>(num_active_cols) < num_cols_) {
+    return true;
+  }
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degrees[row] > num_active_cols) {
+      return true;
+    }
+  }
+  for (size_t col = 0; col < num_cols_; ++col) {
+    if (col_degrees[col] > num_active_rows) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Solves the problem on the rows and columns with positive degree. Entries
+// in the other rows and columns can never be in the support, and a degree
+// larger than the number of partners cannot be reached, so the compacted
+// problem has the same supports. The rows of the compacted signal point into
+// x unless columns were removed.
+bool DegreeFlowSolver::SolveCompacted(const DenseSignal& x, int k,
+                                      const vector<int>& row_degrees,
+                                      const vector<int>& col_degrees,
+                                      const DegreeFlowOptions& options,
+                                      bool verbose,
+                                      void (*output_function)(const char*),
+                                      const SupportOutput& result,
+                                      DegreeFlowSolutionPath* solution_path) {
+  double phase_begin = WallTime();
+  size_t num_rows = x.num_rows;
+  size_t num_cols = x.num_cols;
+  compact_row_index_.clear();
+  for (size_t row = 0; row < num_rows; ++row) {
+    if (row_degrees[row] > 0) {
+      compact_row_index_.push_back(row);
+    }
+  }
+  compact_col_index_.clear();
+  for (size_t col = 0; col < num_cols; ++col) {
+    if (col_degrees[col] > 0) {
+      compact_col_index_.push_back(col);
+    }
+  }
+  size_t num_compact_rows = compact_row_index_.size();
+  size_t num_compact_cols = compact_col_index_.size();
+  compact_row_degrees_.resize(num_compact_rows);
+  for (size_t ii = 0; ii < num_compact_rows; ++ii) {
+    compact_row_degrees_[ii] = min(row_degrees[compact_row_index_[ii]],
+                                   static_cast<int>(num_compact_cols));
+  }
+  compact_col_degrees_.resize(num_compact_cols);
+  for (size_t ii = 0; ii < num_compact_cols; ++ii) {
+    compact_col_degrees_[ii] = min(col_degrees[compact_col_index_[ii]],
+                                   static_cast<int>(num_compact_rows));
+  }
+
+  compact_rows_.resize(num_compact_rows);
+  if (num_compact_cols == num_cols) {
+    for (size_t ii = 0; ii < num_compact_rows; ++ii) {
+      compact_rows_[ii] = x[compact_row_index_[ii]];
+    }
+  } else {
+    compact_x_.resize(num_compact_rows * num_compact_cols);
+    for (size_t ii = 0; ii < num_compact_rows; ++ii) {
+      const double* x_row = x[compact_row_index_[ii]];
+      double* compact_row = &compact_x_[num_compact_cols * ii];
+      for (size_t jj = 0; jj < num_compact_cols; ++jj) {
+        compact_row[jj] = x_row[compact_col_index_[jj]];
+      }
+      compact_rows_[ii] = compact_row;
+    }
+  }
+  DenseSignal compact_signal;
+  compact_signal.rows = &compact_rows_[0];
+  compact_signal.num_rows = num_compact_rows;
+  compact_signal.num_cols = num_compact_cols;
+  stats_.phase_times.graph_build += WallTime() - phase_begin;
+
+  if (verbose) {
+    snprintf(output_buffer_, kOutputBufferSize, "Compaction: %zd of %zd rows "
+             "and %zd of %zd columns remain.\n", num_compact_rows, num_rows,
+             num_compact_cols, num_cols);
+    output_function(output_buffer_);
+  }
+
+  SupportOutput compact_result;
+  compact_result.indices = &compact_support_;
+  compacting_ = true;
+  bool success = SolveDenseSignal(compact_signal, k, compact_row_degrees_,
+                                  compact_col_degrees_, options, verbose,
+                                  output_function, compact_result,
+                                  solution_path);
+  compacting_ = false;
+  if (!success) {
+    return false;
+  }
+
+  // The maps are increasing, so the support stays in row-major order.
+  result.Reset(num_rows, num_cols);
+  for (size_t ii = 0; ii < compact_support_.size(); ++ii) {
+    size_t row = compact_row_index_[compact_support_[ii].first];
+    size_t col = compact_col_index_[compact_support_[ii].second];
+    result.Add(row, col, x[row][col]);
+  }
+  if (solution_path != NULL) {
+    solution_path->num_rows = num_rows;
+    solution_path->num_cols = num_cols;
+    for (size_t ii = 0; ii < solution_path->changes.size(); ++ii) {
+      DegreeFlowSolutionPath::Change& change = solution_path->changes[ii];
+      change.row = compact_row_index_[change.row];
+      change.col = compact_col_index_[change.col];
+    }
+  }
+  if (options.certificate && !IsSubproblem()) {
+    ExpandCertificate(num_rows, num_cols);
+  }
+  return true;
+}
+
+// Extends the certificate of the compacted problem to all rows and columns.
+// The removed rows and columns have no constraints in the linear program;
+// they get the potentials of the source and the sink, i.e., duals 0. The
+// dual objective stays the same, since the verifier also clamps the degrees
+// (see VerifyDegreeFlowSolution).
+void DegreeFlowSolver::ExpandCertificate(size_t num_rows, size_t num_cols) {
+  DegreeFlowCertificate& certificate = certificate_;
+  vector<double> potential(num_rows + num_cols + 2);
+  vector<double> row_dual(num_rows, 0.0);
+  vector<double> col_dual(num_cols, 0.0);
+  potential[0] = certificate.potential[0];
+  potential[1] = certificate.potential[1];
+  for (size_t row = 0; row < num_rows; ++row) {
+    potential[2 + row] = potential[0];
+  }
+  for (size_t col = 0; col < num_cols; ++col) {
+    potential[2 + num_rows + col] = potential[1];
+  }
+  for (size_t ii = 0; ii < compact_row_index_.size(); ++ii) {
+    size_t row = compact_row_index_[ii];
+    potential[2 + row] = certificate.potential[2 + ii];
+    row_dual[row] = certificate.row_dual[ii];
+  }
+  size_t num_compact_rows = compact_row_index_.size();
+  for (size_t ii = 0; ii < compact_col_index_.size(); ++ii) {
+    size_t col = compact_col_index_[ii];
+    potential[2 + num_rows + col] =
+        certificate.potential[2 + num_compact_rows + ii];
+    col_dual[col] = certificate.col_dual[ii];
+  }
+  certificate.num_rows = num_rows;
+  certificate.num_cols = num_cols;
+  certificate.potential.swap(potential);
+  certificate.row_dual.swap(row_dual);
+  certificate.col_dual.swap(col_dual);
+}
+
+// Solves the problem on the candidate entries until the final potentials
+// certify that no other entry can improve the support. A flow is a min-cost
+// flow iff there are potentials for which all residual arcs have
+// non-negative reduced costs. The arcs of the entries that are not
+// candidates are unused forward arcs, so it suffices to check their reduced
+// costs after the candidate problem is solved.
+bool DegreeFlowSolver::SolvePruned(const DenseSignal& x, int k,
+                                   const vector<int>& row_degrees,
+                                   const vector<int>& col_degrees,
+                                   const DegreeFlowOptions& options,
+                                   bool verbose,
+                                   void (*output_function)(const char*),
+                                   const SupportOutput& result) {
+  double max_abs_cost = 0.0;
+  for (size_t row = 0; row < x.num_rows; ++row) {
+    for (size_t col = 0; col < x.num_cols; ++col) {
+      max_abs_cost = max(max_abs_cost, abs(x[row][col]));
+    }
+  }
+  double tolerance = kAdmissibleTolerance * max_abs_cost;
+
+  SelectCandidates(x, row_degrees, col_degrees, options.pruning_candidates);
+  pruned_support_.clear();
+  pruned_objective_ = -1.0;
+  while (true) {
+    // Candidate matrix in CSR format
+    candidates_.num_rows = x.num_rows;
+    candidates_.num_cols = x.num_cols;
+    candidates_.row_offset.assign(1, 0);
+    candidates_.col_index.clear();
+    candidates_.value.clear();
+    for (size_t row = 0; row < x.num_rows; ++row) {
+      for (size_t col = 0; col < x.num_cols; ++col) {
+        if (is_candidate_[x.num_cols * row + col]) {
+          candidates_.col_index.push_back(col);
+          candidates_.value.push_back(x[row][col]);
+        }
+      }
+      candidates_.row_offset.push_back(candidates_.value.size());
+    }
+
+    solving_candidates_ = true;
+    Solve(candidates_, k, row_degrees, col_degrees, options, verbose,
+          output_function, &candidate_result_);
+    solving_candidates_ = false;
+    if (candidate_result_.size() != candidates_.num_entries()) {
+      return false;
+    }
+    if (StoppedEarly()) {
+      break;
+    }
+
+    size_t num_violated = AddViolatedCandidates(x, row_degrees, col_degrees,
+        tolerance, flow_value_ < k && flow_value_ < max_flow_bound_);
+    if (verbose) {
+      snprintf(output_buffer_, kOutputBufferSize, "Candidate pruning: %zd of "
+          "%zd entries are candidates, %zd other entries violate the "
+          "optimality certificate.\n", candidates_.num_entries(),
+          num_rows_ * num_cols_, num_violated);
+      output_function(output_buffer_);
+    }
+    if (num_violated == 0) {
+      break;
+    }
+
+    // The next round starts from scratch and can be stopped early with a
+    // worse support.
+    pruned_support_.clear();
+    pruned_objective_ = 0.0;
+    for (size_t row = 0; row < x.num_rows; ++row) {
+      for (size_t entry = candidates_.row_offset[row];
+           entry < candidates_.row_offset[row + 1]; ++entry) {
+        if (candidate_result_[entry]) {
+          pruned_support_.push_back(x.num_cols * row
+                                    + candidates_.col_index[entry]);
+          pruned_objective_ += abs(candidates_.value[entry]);
+        }
+      }
+    }
+  }
+
+  if (StoppedEarly()) {
+    // The potentials of the candidate problem also give duals for the full
+    // signal.
+    ComputeDuals(1.0, false, k);
+    objective_bound_ = DualBound(x);
+    if (pruned_objective_ > objective_) {
+      objective_ = pruned_objective_;
+      if (options.certificate && !IsSubproblem()) {
+        ExportCertificate(x, k, 1.0);
+      }
+      result.Reset(x.num_rows, x.num_cols);
+      for (size_t ii = 0; ii < pruned_support_.size(); ++ii) {
+        size_t row = pruned_support_[ii] / x.num_cols;
+        size_t col = pruned_support_[ii] % x.num_cols;
+        result.Add(row, col, x[row][col]);
+      }
+      return true;
+    }
+  } else if (flow_value_ < k) {
+    snprintf(output_buffer_, kOutputBufferSize, "Could not fit %d nonzeros "
+             "into the matrix, the support has %d nonzeros.\n", k,
+             flow_value_);
+    output_function(output_buffer_);
+  }
+
+  // Without violated entries, the potentials of the candidate problem
+  // certify the support for the full signal.
+  if (options.certificate && !IsSubproblem()) {
+    ExportCertificate(x, k, 1.0);
+  }
+  result.Reset(x.num_rows, x.num_cols);
+  for (size_t row = 0; row < x.num_rows; ++row) {
+    for (size_t entry = candidates_.row_offset[row];
+         entry < candidates_.row_offset[row + 1]; ++entry) {
+      if (candidate_result_[entry]) {
+        result.Add(row, candidates_.col_index[entry],
+                   x[row][candidates_.col_index[entry]]);
+      }
+    }
+  }
+  return true;
+}
+
+// Marks the num_candidates largest entries of every row and column as
+// candidates. Entries in rows or columns with degree 0 can never be in the
+// support and are skipped.
+void DegreeFlowSolver::SelectCandidates(const DenseSignal& x,
+                                        const vector<int>& row_degrees,
+                                        const vector<int>& col_degrees,
+                                        int num_candidates) {
+  size_t num_rows = x.num_rows;
+  size_t num_cols = x.num_cols;
+  is_candidate_.assign(num_rows * num_cols, false);
+
+  for (size_t row = 0; row < num_rows; ++row) {
+    if (row_degrees[row] <= 0) {
+      continue;
+    }
+    candidate_order_.clear();
+    for (size_t col = 0; col < num_cols; ++col) {
+      if (col_degrees[col] > 0) {
+        candidate_order_.push_back(make_pair(-abs(x[row][col]), col));
+      }
+    }
+    size_t num_kept = min(candidate_order_.size(),
+                          static_cast<size_t>(num_candidates));
+    nth_element(candidate_order_.begin(), candidate_order_.begin() + num_kept,
+                candidate_order_.end());
+    for (size_t ii = 0; ii < num_kept; ++ii) {
+      is_candidate_[num_cols * row + candidate_order_[ii].second] = true;
+    }
+  }
+
+  for (size_t col = 0; col < num_cols; ++col) {
+    if (col_degrees[col] <= 0) {
+      continue;
+    }
+    candidate_order_.clear();
+    for (size_t row = 0; row < num_rows; ++row) {
+      if (row_degrees[row] > 0) {
+        candidate_order_.push_back(make_pair(-abs(x[row][col]), row));
+      }
+    }
+    size_t num_kept = min(candidate_order_.size(),
+                          static_cast<size_t>(num_candidates));
+    nth_element(candidate_order_.begin(), candidate_order_.begin() + num_kept,
+                candidate_order_.end());
+    for (size_t ii = 0; ii < num_kept; ++ii) {
+      is_candidate_[num_cols * candidate_order_[ii].second + col] = true;
+    }
+  }
+}
+
+// Checks the reduced costs of the entries that are not candidates w.r.t. the
+// potentials of the last solve, marks the entries with negative reduced
+// costs as candidates, and returns their number.
+//
+// If the last solve could not fit k entries (extend_reachable), dst_ still
+// contains the distances of the last, unsuccessful shortest path
+// computation. An entry from a reachable row to an unreachable column could
+// then lead to an augmenting path, so it also violates the certificate.
+size_t DegreeFlowSolver::AddViolatedCandidates(
+    const DenseSignal& x, const vector<int>& row_degrees,
+    const vector<int>& col_degrees, double tolerance, bool extend_reachable) {
+  const double kInfinity = numeric_limits<double>::infinity();
+  size_t num_violated = 0;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degrees[row] <= 0) {
+      continue;
+    }
+    double row_potential = potential_[RowNodeIndex(row)];
+    bool row_reachable = extend_reachable
+                         && dst_[RowNodeIndex(row)] < kInfinity;
+    for (size_t col = 0; col < num_cols_; ++col) {
+      size_t entry = num_cols_ * row + col;
+      if (col_degrees[col] <= 0 || is_candidate_[entry]) {
+        continue;
+      }
+      NodeIndex col_node = ColNodeIndex(col);
+      // Columns without candidates have potential infinity and always
+      // violate the certificate.
+      if (-abs(x[row][col]) + row_potential - potential_[col_node]
+          < -tolerance
+          || (row_reachable && dst_[col_node] == kInfinity)) {
+        is_candidate_[entry] = true;
+        num_violated += 1;
+      }
+    }
+  }
+  return num_violated;
+}
+
+bool DegreeFlowSolver::CheckSparseMatrix(
+    const DegreeFlowSparseMatrix& x, void (*output_function)(const char*)) {
+  if (x.num_rows == 0 || x.num_cols == 0) {
+    snprintf(output_buffer_, kOutputBufferSize, "Signal must have at least one "
+             "row and one column.");
+    output_function(output_buffer_);
+    return false;
+  }
+  if (x.row_offset.size() != x.num_rows + 1 || x.row_offset[0] != 0
+      || x.row_offset[x.num_rows] != x.num_entries()
+      || x.col_index.size() != x.num_entries()) {
+    snprintf(output_buffer_, kOutputBufferSize, "The row offsets, column "
+             "indices, and values of the sparse signal do not match.");
+    output_function(output_buffer_);
+    return false;
+  }
+  for (size_t row = 0; row < x.num_rows; ++row) {
+    if (x.row_offset[row] > x.row_offset[row + 1]) {
+      snprintf(output_buffer_, kOutputBufferSize, "The row offsets of the "
+               "sparse signal must be non-decreasing.");
+      output_function(output_buffer_);
+      return false;
+    }
+    for (size_t entry = x.row_offset[row]; entry < x.row_offset[row + 1];
+         ++entry) {
+      if (x.col_index[entry] >= x.num_cols
+          || (entry > x.row_offset[row]
+              && x.col_index[entry] <= x.col_index[entry - 1])) {
+        snprintf(output_buffer_, kOutputBufferSize, "The column indices of "
+                 "row %zd of the sparse signal must be strictly increasing "
+                 "and smaller than the number of columns.", row);
+        output_function(output_buffer_);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int DegreeFlowSolver::AugmentToSparsity(int k, int num_selected,
+    const DegreeFlowOptions& options, bool verbose,
+    void (*output_function)(const char*)) {
+  // After a warm start, the support can be larger than k.
+  while (num_selected > k) {
+    if (!FindGraphPath(true)) {
+      break;
+    }
+    num_selected -= 1;
+  }
+
+  max_flow_bound_ = MaxFlowBound(row_degree_, col_degree_);
+
+  const double threshold_step = 0.1;
+  double threshold = threshold_step;
+  int num_blocking_flow_skips = 0;
+  int blocking_flow_backoff = 1;
+  while (num_selected < k) {
+    // The support is feasible and optimal for its size after every
+    // augmentation, so the solver can stop here.
+    if (ShouldStop(options)) {
+      break;
+    }
+    // If the degrees do not allow a larger support, the search for an
+    // augmenting path would settle every reachable node in vain.
+    bool found_path = false;
+    if (num_selected < max_flow_bound_) {
+      if (engine_ == DegreeFlowOptions::kDenseEngine) {
+        found_path = FindPathDense();
+      } else if (engine_ == DegreeFlowOptions::kAssignmentEngine) {
+        found_path = FindPathAssignment();
+      } else {
+        found_path = FindGraphPath(false);
+      }
+    }
+    if (!found_path) {
+      if (!solving_candidates_) {
+        snprintf(output_buffer_, kOutputBufferSize, "Could not fit %d "
+                 "nonzeros into the matrix, the support has %d nonzeros.\n",
+                 k, num_selected);
+        output_function(output_buffer_);
+      }
+      break;
+    }
+    num_selected += 1;
+    stats_.num_augmentations += 1;
+
+    // Without ties, the admissible graph rarely contains a second path. In
+    // that case, the blocking flow is skipped for exponentially growing
+    // numbers of iterations, which bounds its overhead. The assignment
+    // engine augments along one path per search.
+    int max_paths = AugmentationBudget(k - num_selected, options);
+    if (options.blocking_flow && max_paths > 0
+        && engine_ != DegreeFlowOptions::kAssignmentEngine) {
+      if (num_blocking_flow_skips > 0) {
+        num_blocking_flow_skips -= 1;
+      } else {
+        int num_paths;
+        if (engine_ == DegreeFlowOptions::kDenseEngine) {
+          num_paths = AugmentBlockingFlowDense(max_paths);
+        } else {
+          num_paths = AugmentBlockingFlow(max_paths);
+        }
+        num_selected += num_paths;
+        stats_.num_augmentations += num_paths;
+        if (num_paths == 0) {
+          num_blocking_flow_skips = blocking_flow_backoff;
+          blocking_flow_backoff *= 2;
+        } else {
+          blocking_flow_backoff = 1;
+        }
+      }
+    }
 
-long long total_inner_iterations;
-long long checking_inner_iterations;
-long long updating_inner_iterations;
+    if (verbose) {
+      if (k <= 10) {
+        snprintf(output_buffer_, kOutputBufferSize, "%d entries selected\n",
+                 num_selected);
+        output_function(output_buffer_);
+      } else {
+        double fraction = static_cast<double>(num_selected) / k;
+        if (fraction >= threshold) {
+          threshold += threshold_step;
+          snprintf(output_buffer_, kOutputBufferSize, "%d entries selected "
+                   "(%.2lf%%)\n", num_selected, 100 * fraction);
+          output_function(output_buffer_);
+        }
+      }
+    }
+  }
 
-EdgeIndex EntryEdgeIndex(int r, int c) {
-  return 2 * (num_cols * r + c);
+  return num_selected;
 }
 
-NodeIndex RowNodeIndex(int r) {
-  return 2 + r;
+// Every row can have at most min(degree, number of columns with positive
+// degree) entries in the support, and every column at most min(degree,
+// number of rows with positive degree). The bound only depends on the
+// degrees, so it is the same for a candidate problem and the full problem in
+// SolvePruned, and for a compacted problem and the original problem.
+long long DegreeFlowSolver::MaxFlowBound(const vector<int>& row_degrees,
+                                         const vector<int>& col_degrees) const {
+  long long num_active_rows = 0;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degrees[row] > 0) {
+      num_active_rows += 1;
+    }
+  }
+  long long num_active_cols = 0;
+  for (size_t col = 0; col < num_cols_; ++col) {
+    if (col_degrees[col] > 0) {
+      num_active_cols += 1;
+    }
+  }
+  long long row_total = 0;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    row_total += min(static_cast<long long>(max(row_degrees[row], 0)),
+                     num_active_cols);
+  }
+  long long col_total = 0;
+  for (size_t col = 0; col < num_cols_; ++col) {
+    col_total += min(static_cast<long long>(max(col_degrees[col], 0)),
+                     num_active_rows);
+  }
+  return min(row_total, col_total);
 }
 
-NodeIndex ColNodeIndex(int c) {
-  return 2 + num_rows + c;
+bool DegreeFlowSolver::ShouldStop(const DegreeFlowOptions& options) {
+  // A budget exhausted in an earlier subproblem also stops the later ones.
+  if (StoppedEarly()) {
+    return true;
+  }
+  if (options.max_augmentations > 0
+      && stats_.num_augmentations >= options.max_augmentations) {
+    stats_.termination = DegreeFlowStats::kAugmentationLimit;
+    return true;
+  }
+  return StopRequested(options);
 }
 
-void BuildGraph(const vector<vector<double> >& x,
-                const vector<int>& row_degrees,
-                const vector<int>& col_degrees);
-void ComputeInitialPotentials();
-bool FindPath();
-
-void degree_flow(
-    // signal coefficients (will not be squared)
-    const vector<vector<double> >& x,
-    // Total sparsity
-    int k,
-    // Row degrees
-    const vector<int>& row_degrees,
-    // Column degrees
-    const vector<int>& col_degrees,
-    // Verbose output?
-    bool verbose,
-    // The output function
-    void (*output_function)(const char*),
-    // Result: a bool matrix indicating support
-    vector<vector<bool> >* result) {
-
-  clock_t total_time_begin = clock();
-
-  num_rows = x.size();
-  if (num_rows == 0) {
-    snprintf(output_buffer, kOutputBufferSize, "Signal must have at least one "
-             "row.");
-    output_function(output_buffer);
-    result->clear();
-    return;
+bool DegreeFlowSolver::StopRequested(const DegreeFlowOptions& options) {
+  if (options.time_limit > 0.0 && WallTime() >= deadline_) {
+    stats_.termination = DegreeFlowStats::kTimeLimit;
+    return true;
   }
+  if (options.should_stop != NULL
+      && options.should_stop(options.should_stop_data)) {
+    stats_.termination = DegreeFlowStats::kStopped;
+    return true;
+  }
+  return false;
+}
 
-  num_cols = x[0].size();
-  if (num_cols == 0) {
-    snprintf(output_buffer, kOutputBufferSize, "Signal must have at least one "
-             "column.");
-    output_function(output_buffer);
-    result->clear();
-    return;
+int DegreeFlowSolver::AugmentationBudget(
+    int max_paths, const DegreeFlowOptions& options) const {
+  if (options.max_augmentations > 0) {
+    long long remaining = max(options.max_augmentations
+                              - stats_.num_augmentations,
+                              static_cast<long long>(0));
+    max_paths = static_cast<int>(min(static_cast<long long>(max_paths),
+                                     remaining));
   }
+  return max_paths;
+}
 
-  for (size_t row = 1; row < num_rows; ++row) {
-    if (x[row].size() != num_cols) {
-      snprintf(output_buffer, kOutputBufferSize, "All columns must have the "
-               "same size.");
-      output_function(output_buffer);
-      result->clear();
-      return;
-    }
+// The potential of a node in the current engine
+double DegreeFlowSolver::NodePotential(NodeIndex node) const {
+  if (engine_ == DegreeFlowOptions::kCostScalingEngine) {
+    return cost_scaling_unit_ * price_[node];
+  } else if (engine_ != DegreeFlowOptions::kAssignmentEngine) {
+    return potential_[node];
+  } else if (node == s_) {
+    return source_potential_;
+  } else if (node == t_) {
+    return sink_potential_;
+  } else if (IsRowNode(node)) {
+    size_t row = node - RowNodeIndex(0);
+    return row_match_[row] < 0 ? source_potential_ : row_potential_[row];
+  } else {
+    return col_potential_[node - ColNodeIndex(0)];
   }
+}
 
-  if (verbose) {
-    snprintf(output_buffer, kOutputBufferSize, "r = %zd,  c = %zd,  k = %d\n",
-        num_rows, num_cols, k);
-    output_function(output_buffer);
+// The support is a solution of the linear program
+//
+//   max sum_rc |x_rc| y_rc  s.t.  sum_c y_rc <= d_r,  sum_r y_rc <= d'_c,
+//                                 sum_rc y_rc = m,  0 <= y_rc <= 1,
+//
+// where m = min(k, maximum flow) is the flow value, whose dual is
+//
+//   min m l + sum_r d_r u_r + sum_c d'_c v_c + sum_rc w_rc
+//   s.t.  u_r + v_c + l + w_rc >= |x_rc|,  u, v, w >= 0.
+//
+// The reduced costs of the residual arcs into and out of the source, the
+// sink and the rows and columns give l = p(s) - p(t), u_r = p(r) - p(s) and
+// v_c = p(t) - p(c), where u and v are non-negative for an optimal flow and
+// then also make w_rc = max(0, |x_rc| - u_r - v_c - l) the reduced cost of
+// the entry arcs. l is the gain of the last augmenting path, which is
+// negative if the solver padded the support with entries that lower the
+// objective. Clipping u and v at 0 keeps them feasible for any potentials.
+// The potentials are multiplied by scale.
+//
+// If the flow is not a min-cost flow of its value (the solver stopped
+// early), l is clipped at 0 as well, so the duals bound the objective of
+// every support with at most min(k, max_flow_bound_) entries, which
+// includes the optimal one.
+void DegreeFlowSolver::ComputeDuals(double scale, bool optimal, int k) {
+  node_potential_.resize(num_nodes_);
+  for (NodeIndex node = 0; node < num_nodes_; ++node) {
+    node_potential_[node] = scale * NodePotential(node);
+  }
+  double source = node_potential_[s_];
+  double sink = node_potential_[t_];
+  if (optimal) {
+    sparsity_dual_ = FiniteDual(source - sink);
+    dual_support_size_ = flow_value_;
+  } else {
+    sparsity_dual_ = NonNegativeDual(source - sink);
+    dual_support_size_ = min(static_cast<long long>(max(k, 0)),
+                             max_flow_bound_);
+  }
+  row_dual_.resize(num_rows_);
+  for (size_t row = 0; row < num_rows_; ++row) {
+    row_dual_[row] = NonNegativeDual(node_potential_[RowNodeIndex(row)]
+                                     - source);
   }
+  col_dual_.resize(num_cols_);
+  for (size_t col = 0; col < num_cols_; ++col) {
+    col_dual_[col] = NonNegativeDual(sink
+                                     - node_potential_[ColNodeIndex(col)]);
+  }
+}
 
-  clock_t graph_construction_time_begin = clock();
-  
-  BuildGraph(x, row_degrees, col_degrees);
-  ComputeInitialPotentials();
+// Fills certificate_ for the support of the last solve, whose amplitudes
+// are x. scale converts the potentials to units of the amplitudes.
+template <typename Signal>
+void DegreeFlowSolver::ExportCertificate(const Signal& x, int k,
+                                         double scale) {
+  ComputeDuals(scale, !StoppedEarly(), k);
+  certificate_.num_rows = num_rows_;
+  certificate_.num_cols = num_cols_;
+  certificate_.potential = node_potential_;
+  certificate_.row_dual = row_dual_;
+  certificate_.col_dual = col_dual_;
+  certificate_.sparsity_dual = sparsity_dual_;
+  certificate_.objective = objective_;
+  certificate_.dual_objective = DualBound(x);
+}
 
-  clock_t graph_construction_time = clock() - graph_construction_time_begin;
-  if (verbose) {
-    snprintf(output_buffer, kOutputBufferSize, "The graph has %zd nodes and %zd"
-        " edges.\n", num_nodes, e.size());
-    output_function(output_buffer);
-    snprintf(output_buffer, kOutputBufferSize, "Total construction time: %f "
-        "s\n", static_cast<double>(graph_construction_time) / CLOCKS_PER_SEC);
-    output_function(output_buffer);
-  }
-
-  for (int ii = 0; ii < k; ++ii) {
-    if (!FindPath()) {
-      snprintf(output_buffer, kOutputBufferSize, "Could not fit %d nonzeros "
-               "into the matrix, the support has %d nonzeros.\n", k, ii);
-      output_function(output_buffer);
-      break;
+// The certificate of the transpose of a problem, which swaps the roles of
+// the source and the sink and of the rows and the columns. The negated
+// potentials give every arc the reduced cost of the corresponding arc of
+// the transposed flow graph.
+void DegreeFlowSolver::TransposeCertificate(
+    DegreeFlowCertificate* certificate) {
+  size_t num_rows = certificate->num_cols;
+  size_t num_cols = certificate->num_rows;
+  const vector<double>& potential = certificate->potential;
+  vector<double> transposed(potential.size());
+  if (potential.size() == num_rows + num_cols + 2) {
+    transposed[0] = -potential[1];
+    transposed[1] = -potential[0];
+    for (size_t row = 0; row < num_rows; ++row) {
+      transposed[2 + row] = -potential[2 + num_cols + row];
+    }
+    for (size_t col = 0; col < num_cols; ++col) {
+      transposed[2 + num_rows + col] = -potential[2 + col];
     }
+  }
+  certificate->potential.swap(transposed);
+  certificate->num_rows = num_rows;
+  certificate->num_cols = num_cols;
+  certificate->row_dual.swap(certificate->col_dual);
+}
 
-    const double threshold_step = 0.1;
-    double threshold = threshold_step;
-    if (verbose) {
-      if (k <= 10) {
-        snprintf(output_buffer, kOutputBufferSize, "%d entries selected\n",
-                 ii + 1);
-        output_function(output_buffer);
-      } else {
-        double fraction = static_cast<double>(ii + 1) / k;
-        if (fraction >= threshold) {
-          threshold += threshold_step;
-          snprintf(output_buffer, kOutputBufferSize, "%d entries selected "
-                   "(%.2lf%%)\n", ii + 1, 100 * fraction);
-          output_function(output_buffer);
-        }
+// The objective of the dual for row_dual_, col_dual_ and sparsity_dual_
+// with m = dual_support_size_. By weak duality, it bounds the objective of
+// every support with m entries (and with fewer if sparsity_dual_ >= 0).
+// Entries in rows or columns with degree 0 cannot be in the support, so they
+// do not need a w_rc.
+double DegreeFlowSolver::DualBound(const DenseSignal& x) const {
+  double bound = sparsity_dual_ * dual_support_size_;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degree_[row] <= 0) {
+      continue;
+    }
+    bound += row_degree_[row] * row_dual_[row];
+    const double* x_row = x[row];
+    for (size_t col = 0; col < num_cols_; ++col) {
+      if (col_degree_[col] > 0) {
+        bound += max(abs(x_row[col]) - row_dual_[row] - col_dual_[col]
+                     - sparsity_dual_, 0.0);
       }
     }
   }
- 
-  vector<vector<bool> >& resultref = *result;
-  if (x.size() != resultref.size()) {
-    resultref.resize(x.size());
+  for (size_t col = 0; col < num_cols_; ++col) {
+    if (col_degree_[col] > 0) {
+      bound += col_degree_[col] * col_dual_[col];
+    }
   }
+  return bound;
+}
 
-  for (size_t ii = 0; ii < x.size(); ++ii) {
-    if (x[ii].size() != resultref[ii].size()) {
-      resultref[ii].resize(x[ii].size());
+// The same for a sparse signal, whose entries that are not stored cannot
+// be in the support
+double DegreeFlowSolver::DualBound(const DegreeFlowSparseMatrix& x) const {
+  double bound = sparsity_dual_ * dual_support_size_;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degree_[row] <= 0) {
+      continue;
+    }
+    bound += row_degree_[row] * row_dual_[row];
+    for (size_t entry = x.row_offset[row]; entry < x.row_offset[row + 1];
+         ++entry) {
+      size_t col = x.col_index[entry];
+      if (col_degree_[col] > 0) {
+        bound += max(abs(x.value[entry]) - row_dual_[row] - col_dual_[col]
+                     - sparsity_dual_, 0.0);
+      }
     }
-    for (size_t jj = 0; jj < x[ii].size(); ++jj) {
-      resultref[ii][jj] = (e[EntryEdgeIndex(ii, jj)].capacity == 0);
+  }
+  for (size_t col = 0; col < num_cols_; ++col) {
+    if (col_degree_[col] > 0) {
+      bound += col_degree_[col] * col_dual_[col];
     }
   }
+  return bound;
+}
 
-  clock_t total_time = clock() - total_time_begin;
-  if (verbose) {
-    snprintf(output_buffer, kOutputBufferSize, "Total time %lf s\n",
-        static_cast<double>(total_time) / CLOCKS_PER_SEC);
-    output_function(output_buffer);
+void DegreeFlowSolver::OutputDiagnostics(double total_time,
+    void (*output_function)(const char*)) {
+  snprintf(output_buffer_, kOutputBufferSize, "Total time %lf s\n",
+      total_time);
+  output_function(output_buffer_);
 
-    snprintf(output_buffer, kOutputBufferSize, "Performance diagnostics:\n"
+  snprintf(output_buffer_, kOutputBufferSize, "Performance diagnostics:\n"
+           "Shortest path computations: %lld\n",
+           stats_.num_shortest_path_runs);
+  output_function(output_buffer_);
+  if (kCountersEnabled) {
+    snprintf(output_buffer_, kOutputBufferSize,
              "Total inner iterations: %lld\n"
              "Checking inner iterations: %lld\n"
-             "Updating inner iterations: %lld\n",
-             total_inner_iterations, checking_inner_iterations,
-             updating_inner_iterations);
-    output_function(output_buffer);
+             "Updating inner iterations: %lld\n"
+             "Queue pushes: %lld\n"
+             "Queue pops: %lld\n",
+             stats_.total_inner_iterations, stats_.checking_inner_iterations,
+             stats_.updating_inner_iterations, stats_.num_queue_pushes,
+             stats_.num_queue_pops);
+    output_function(output_buffer_);
   }
 }
 
+void DegreeFlowSolver::BuildGraph(const DenseSignal& x,
+                                  const vector<int>& row_degrees,
+                                  const vector<int>& col_degrees,
+                                  bool keep_flow) {
+  s_ = 0;
+  t_ = 1;
+  num_nodes_ = num_rows_ + num_cols_ + 2;
+  if (!keep_flow) {
+    ResetSupportEntries();
+  }
+
+  // Edges come in pairs: edge 2i is a forward edge with the original
+  // capacity, edge 2i + 1 is its backward edge with capacity 0. The entry
+  // edges come first (see EntryEdgeIndex), followed by the source edges and
+  // the sink edges.
+  size_t num_edges = 2 * (num_rows_ * num_cols_ + num_rows_ + num_cols_);
+  if (!keep_flow) {
+    edge_capacity_.resize(num_edges);
+  }
 
-void BuildGraph(const vector<vector<double> >& x,
-                const vector<int>& row_degrees,
-                const vector<int>& col_degrees) {
-  e.clear();
-  outgoing_edges.clear();
+  // Count the arcs leaving each node. Rows with degree 0 are not connected
+  // to the rest of the graph.
+  size_t num_active_rows = 0;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degrees[row] > 0) {
+      num_active_rows += 1;
+    }
+  }
+  adjacency_offset_.assign(num_nodes_ + 1, 0);
+  adjacency_offset_[s_ + 1] = num_active_rows;
+  adjacency_offset_[t_ + 1] = num_cols_;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degrees[row] > 0) {
+      adjacency_offset_[RowNodeIndex(row) + 1] = num_cols_ + 1;
+    }
+  }
+  for (size_t col = 0; col < num_cols_; ++col) {
+    adjacency_offset_[ColNodeIndex(col) + 1] = num_active_rows + 1;
+  }
+  for (size_t ii = 0; ii < num_nodes_; ++ii) {
+    adjacency_offset_[ii + 1] += adjacency_offset_[ii];
+  }
+  size_t num_arcs = adjacency_offset_[num_nodes_];
+  arc_edge_.resize(num_arcs);
+  arc_to_.resize(num_arcs);
+  arc_cost_.resize(num_arcs);
 
-  s = 0;
-  t = 1;
-  num_nodes = num_rows + num_cols + 2;
-  num_connected_nodes = num_nodes;
-  outgoing_edges.resize(num_nodes);
+  // Fill the arcs in the order in which the edges are created. This keeps
+  // the order of the arcs leaving a node fixed, which determines how ties
+  // between shortest paths are broken.
+  adjacency_end_.assign(adjacency_offset_.begin(),
+                        adjacency_offset_.end() - 1);
 
   // connections between rows and columns
-  for (size_t row = 0; row < num_rows; ++row) {
-    for (size_t col = 0; col < num_cols; ++col) {
-      EdgeIndex next_edge_index = e.size();
-      Edge forward(ColNodeIndex(col), 1, -abs(x[row][col]),
-                   next_edge_index + 1);
-      Edge backward(RowNodeIndex(row), 0, abs(x[row][col]),
-                    next_edge_index);
-      e.push_back(forward);
-      e.push_back(backward);
-      // TODO: this approach is not ideal because we potentially have many
-      // useless edges in e.
+  for (size_t row = 0; row < num_rows_; ++row) {
+    for (size_t col = 0; col < num_cols_; ++col) {
+      EdgeIndex edge = EntryEdgeIndex(row, col);
+      double cost = -abs(x[row][col]);
+      if (!keep_flow) {
+        edge_capacity_[edge] = 1;
+        edge_capacity_[edge + 1] = 0;
+      }
+      // Rows with degree 0 keep their edges so that the entries can be
+      // indexed directly, but they get no arcs. Such rows only reach this
+      // point without compaction (see SolveCompacted). Sparse signals only
+      // get edges for their stored entries (see BuildSparseGraph).
       if (row_degrees[row] > 0) {
-        outgoing_edges[RowNodeIndex(row)].push_back(next_edge_index);
-        outgoing_edges[ColNodeIndex(col)].push_back(next_edge_index + 1);
+        AddArc(RowNodeIndex(row), ColNodeIndex(col), edge, cost);
+        AddArc(ColNodeIndex(col), RowNodeIndex(row), edge + 1, -cost);
       }
     }
   }
 
-  // connections from source to rows
-  for (size_t row = 0; row < num_rows; ++row) {
-      EdgeIndex next_edge_index = e.size();
-      Edge forward(RowNodeIndex(row), row_degrees[row], 0.0,
-                   next_edge_index + 1);
-      Edge backward(s, 0, 0.0, next_edge_index);
-      e.push_back(forward);
-      e.push_back(backward);
+  AddSourceAndSinkArcs(row_degrees, col_degrees, keep_flow);
+}
+
+// Builds the graph of a sparse signal. The nodes, the arc order, and the
+// source and sink edges are the same as in BuildGraph, but there are only
+// entry edges for the stored entries.
+void DegreeFlowSolver::BuildSparseGraph(const DegreeFlowSparseMatrix& x,
+                                        const vector<int>& row_degrees,
+                                        const vector<int>& col_degrees) {
+  s_ = 0;
+  t_ = 1;
+  num_nodes_ = num_rows_ + num_cols_ + 2;
+  ResetSupportEntries();
+  edge_capacity_.resize(2 * (num_entries_ + num_rows_ + num_cols_));
+
+  size_t num_active_rows = 0;
+  adjacency_offset_.assign(num_nodes_ + 1, 0);
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degrees[row] > 0) {
+      num_active_rows += 1;
+      adjacency_offset_[RowNodeIndex(row) + 1] =
+          x.row_offset[row + 1] - x.row_offset[row] + 1;
+      for (size_t entry = x.row_offset[row]; entry < x.row_offset[row + 1];
+           ++entry) {
+        adjacency_offset_[ColNodeIndex(x.col_index[entry]) + 1] += 1;
+      }
+    }
+  }
+  adjacency_offset_[s_ + 1] = num_active_rows;
+  adjacency_offset_[t_ + 1] = num_cols_;
+  for (size_t col = 0; col < num_cols_; ++col) {
+    adjacency_offset_[ColNodeIndex(col) + 1] += 1;
+  }
+  for (size_t ii = 0; ii < num_nodes_; ++ii) {
+    adjacency_offset_[ii + 1] += adjacency_offset_[ii];
+  }
+  size_t num_arcs = adjacency_offset_[num_nodes_];
+  arc_edge_.resize(num_arcs);
+  arc_to_.resize(num_arcs);
+  arc_cost_.resize(num_arcs);
+  adjacency_end_.assign(adjacency_offset_.begin(),
+                        adjacency_offset_.end() - 1);
+
+  for (size_t row = 0; row < num_rows_; ++row) {
+    for (size_t entry = x.row_offset[row]; entry < x.row_offset[row + 1];
+         ++entry) {
+      EdgeIndex edge = EntryEdgeIndex(entry);
+      edge_capacity_[edge] = 1;
+      edge_capacity_[edge + 1] = 0;
       if (row_degrees[row] > 0) {
-        outgoing_edges[s].push_back(next_edge_index);
-        outgoing_edges[RowNodeIndex(row)].push_back(next_edge_index + 1);
-      } else {
-        num_connected_nodes -= 1;
+        double cost = -abs(x.value[entry]);
+        NodeIndex col_node = ColNodeIndex(x.col_index[entry]);
+        AddArc(RowNodeIndex(row), col_node, edge, cost);
+        AddArc(col_node, RowNodeIndex(row), edge + 1, -cost);
       }
+    }
+  }
+
+  AddSourceAndSinkArcs(row_degrees, col_degrees, false);
+}
+
+void DegreeFlowSolver::AddSourceAndSinkArcs(const vector<int>& row_degrees,
+                                            const vector<int>& col_degrees,
+                                            bool keep_flow) {
+  // connections from source to rows
+  for (size_t row = 0; row < num_rows_; ++row) {
+    EdgeIndex edge = SourceEdgeIndex(row);
+    if (!keep_flow) {
+      edge_capacity_[edge] = row_degrees[row];
+      edge_capacity_[edge + 1] = 0;
+    }
+    if (row_degrees[row] > 0) {
+      AddArc(s_, RowNodeIndex(row), edge, 0.0);
+      AddArc(RowNodeIndex(row), s_, edge + 1, 0.0);
+    }
   }
 
   // connections from columns to sink
-  for (size_t col = 0; col < num_cols; ++col) {
-      EdgeIndex next_edge_index = e.size();
-      Edge forward(t, col_degrees[col], 0.0, next_edge_index + 1);
-      Edge backward(ColNodeIndex(col), 0, 0.0, next_edge_index);
-      e.push_back(forward);
-      e.push_back(backward);
-      outgoing_edges[ColNodeIndex(col)].push_back(next_edge_index);
-      outgoing_edges[t].push_back(next_edge_index + 1);
+  for (size_t col = 0; col < num_cols_; ++col) {
+    EdgeIndex edge = SinkEdgeIndex(col);
+    if (!keep_flow) {
+      edge_capacity_[edge] = col_degrees[col];
+      edge_capacity_[edge + 1] = 0;
+    }
+    AddArc(ColNodeIndex(col), t_, edge, 0.0);
+    AddArc(t_, ColNodeIndex(col), edge + 1, 0.0);
   }
 }
 
-void ComputeInitialPotentials() {
-  potential.clear();
+void DegreeFlowSolver::ComputeInitialPotentials() {
+  potential_.clear();
   // Initialize
-  potential.resize(num_nodes, numeric_limits<double>::infinity());
+  potential_.resize(num_nodes_, numeric_limits<double>::infinity());
 
   // Source and row nodes have potential 0
-  potential[s] = 0.0;
-  for (size_t row = 0; row < num_rows; ++row) {
-    potential[RowNodeIndex(row)] = 0.0;
+  potential_[s_] = 0.0;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    potential_[RowNodeIndex(row)] = 0.0;
   }
 
   // Column nodes
-  for (size_t row = 0; row < num_rows; ++row) {
-    for (size_t iedge = 0; iedge < outgoing_edges[RowNodeIndex(row)].size();
-         ++iedge) {
-      const Edge& cur_edge = e[outgoing_edges[RowNodeIndex(row)][iedge]];
-      potential[cur_edge.to] = min(potential[cur_edge.to], cur_edge.cost);
+  for (size_t row = 0; row < num_rows_; ++row) {
+    NodeIndex row_node = RowNodeIndex(row);
+    for (EdgeIndex arc = adjacency_offset_[row_node];
+         arc < adjacency_offset_[row_node + 1]; ++arc) {
+      potential_[arc_to_[arc]] = min(potential_[arc_to_[arc]],
+                                     arc_cost_[arc]);
     }
   }
 
   // Sink
-  for (size_t col = 0; col < num_cols; ++col) {
-    potential[t] = min(potential[t], potential[ColNodeIndex(col)]);
+  for (size_t col = 0; col < num_cols_; ++col) {
+    potential_[t_] = min(potential_[t_], potential_[ColNodeIndex(col)]);
+  }
+}
+
+void DegreeFlowSolver::ResetDijkstra() {
+  if (visited_.size() != num_nodes_) {
+    visited_.resize(num_nodes_);
+  }
+  fill(visited_.begin(), visited_.end(), false);
+
+  if (dst_.size() != num_nodes_) {
+    dst_.resize(num_nodes_, numeric_limits<double>::infinity());
+  }
+  fill(dst_.begin(), dst_.end(), numeric_limits<double>::infinity());
+
+  if (edge_taken_to_.size() != num_nodes_) {
+    edge_taken_to_.resize(num_nodes_, 0);
+  }
+  if (parent_.size() != num_nodes_) {
+    parent_.resize(num_nodes_, s_);
   }
 }
 
-vector<bool> visited;
-vector<double> dst;
-vector<EdgeIndex> edge_taken_to;
+// Nodes that are farther away than max_dst (in particular unreachable nodes
+// and nodes that were not settled before the search stopped) are treated as
+// if their distance was max_dst. If max_dst is the distance of a settled
+// node, this keeps all reduced costs non-negative: the settled nodes have
+// their exact distances, and all other nodes are at least as far away.
+void DegreeFlowSolver::UpdatePotentials(double max_dst) {
+  for (size_t ii = 0; ii < potential_.size(); ++ii) {
+    potential_[ii] += min(dst_[ii], max_dst);
+  }
+}
 
-bool FindPath() {
-  typedef pair<double, NodeIndex> q_elem;
-  
-  if (visited.size() != num_nodes) {
-    visited.resize(num_nodes);
+bool DegreeFlowSolver::FindGraphPath(bool reverse) {
+  if (queue_type_ == DegreeFlowOptions::kLazyBinaryHeapQueue) {
+    return reverse ? FindReversePath(&lazy_heap_) : FindPath(&lazy_heap_);
+  } else if (queue_type_ == DegreeFlowOptions::kRadixHeapQueue) {
+    return reverse ? FindReversePath(&radix_heap_) : FindPath(&radix_heap_);
+  } else if (queue_type_ == DegreeFlowOptions::kBucketQueue) {
+    return reverse ? FindReversePath(&bucket_queue_)
+                   : FindPath(&bucket_queue_);
+  } else {
+    return reverse ? FindReversePath(&indexed_heap_)
+                   : FindPath(&indexed_heap_);
   }
-  fill(visited.begin(), visited.end(), false);
+}
 
-  if (dst.size() != num_nodes) {
-    dst.resize(num_nodes, numeric_limits<double>::infinity());
+template <typename Queue>
+bool DegreeFlowSolver::FindPath(Queue* queue) {
+  ResetDijkstra();
+  queue->Reset(num_nodes_);
+  AddDijkstraSource(s_, queue);
+  if (RunDijkstra(queue, t_) != t_) {
+    return false;
   }
-  fill(dst.begin(), dst.end(), numeric_limits<double>::infinity());
 
-  if (edge_taken_to.size() != num_nodes) {
-    edge_taken_to.resize(num_nodes, s);
+  // change potentials
+  UpdatePotentials(dst_[t_]);
+
+  // change capacities
+  AugmentPath(s_, t_);
+
+  return true;
+}
+
+// Finds a shortest path from t to s and pushes one unit of flow along it,
+// which removes one entry from the support as cheaply as possible.
+template <typename Queue>
+bool DegreeFlowSolver::FindReversePath(Queue* queue) {
+  ResetDijkstra();
+  queue->Reset(num_nodes_);
+  AddDijkstraSource(t_, queue);
+  if (RunDijkstra(queue, s_) != s_) {
+    return false;
   }
-  
-  priority_queue<q_elem> q;
 
-  dst[s] = 0.0;
-  q.push(q_elem(-dst[s], s));
+  UpdatePotentials(dst_[s_]);
+  AugmentPath(t_, s_);
+
+  return true;
+}
+
+// Sources are their own parents, which marks the start of a path.
+template <typename Queue>
+void DegreeFlowSolver::AddDijkstraSource(NodeIndex source, Queue* queue) {
+  dst_[source] = 0.0;
+  parent_[source] = source;
+  queue->Update(source, dst_[source]);
+  Count(&stats_.num_queue_pushes);
+}
 
-  size_t num_found = 0;
-  
-  while (!q.empty() && num_found < num_connected_nodes) {
-    q_elem top = q.top();
-    q.pop();
+// Dijkstra with the reduced costs from the sources in the queue. The search
+// stops as soon as it settles target (or, if target is kDeficitTarget, the
+// first node with a deficit) and returns that node. The distances of the
+// nodes that are not settled then are only upper bounds, see
+// UpdatePotentials. Returns kNoNode if no target is reachable, which
+// requires settling every reachable node. The queues are members of the
+// solver so that their storage is reused across calls.
+template <typename Queue>
+DegreeFlowSolver::NodeIndex DegreeFlowSolver::RunDijkstra(Queue* queue,
+                                                          NodeIndex target) {
+  size_t num_settled_nodes = 0;
+  while (!queue->Empty()) {
+    NodeIndex cur_node = queue->PopMin();
+    Count(&stats_.num_queue_pops);
 
-    if (visited[top.second]) {
+    // Only the lazy heap returns nodes more than once.
+    if (visited_[cur_node]) {
       continue;
     }
 
-    NodeIndex cur_node = top.second;
-    visited[cur_node] = true;
-    ++num_found;
+    visited_[cur_node] = true;
+    if (kCountersEnabled) {
+      ++num_settled_nodes;
+    }
+    if (cur_node == target
+        || (target == kDeficitTarget && excess_[cur_node] < 0)) {
+      RecordShortestPathRun(num_settled_nodes);
+      return cur_node;
+    }
 
     NodeIndex next_node;
-    for (vector<EdgeIndex>::iterator iter = outgoing_edges[cur_node].begin();
-         iter != outgoing_edges[cur_node].end(); ++iter) {
-      const Edge& cur_e = e[*iter];
-      next_node = cur_e.to;
+    EdgeIndex arc_end = adjacency_offset_[cur_node + 1];
+    for (EdgeIndex arc = adjacency_offset_[cur_node]; arc < arc_end; ++arc) {
+      Count(&stats_.total_inner_iterations);
 
-      ++total_inner_iterations;
-
-      if (cur_e.capacity == 0) {
+      if (edge_capacity_[arc_edge_[arc]] == 0) {
         continue;
       }
-      if (visited[next_node]) {
+      next_node = arc_to_[arc];
+      if (visited_[next_node]) {
         continue;
       }
 
-      ++checking_inner_iterations;
+      if (Relax(cur_node, next_node, arc_cost_[arc], queue)) {
+        edge_taken_to_[next_node] = arc_edge_[arc];
+      }
+    }
+  }
+
+  RecordShortestPathRun(num_settled_nodes);
+  return kNoNode;
+}
+
+// num_settled_nodes is only counted if the hot-path counters are enabled.
+void DegreeFlowSolver::RecordShortestPathRun(size_t num_settled_nodes) {
+  ++stats_.num_shortest_path_runs;
+  if (kCountersEnabled) {
+    size_t bucket = 0;
+    while (num_settled_nodes > 1) {
+      num_settled_nodes /= 2;
+      ++bucket;
+    }
+    if (stats_.settled_nodes_histogram.size() <= bucket) {
+      stats_.settled_nodes_histogram.resize(bucket + 1, 0);
+    }
+    stats_.settled_nodes_histogram[bucket] += 1;
+  }
+}
+
+// Pushes one unit of flow along the path from source to target given by
+// parent_ and edge_taken_to_.
+void DegreeFlowSolver::AugmentPath(NodeIndex source, NodeIndex target) {
+  NodeIndex cur_node = target;
+  do {
+    EdgeIndex edge = edge_taken_to_[cur_node];
+    edge_capacity_[edge] -= 1;
+    edge_capacity_[OppositeEdgeIndex(edge)] += 1;
+    //printf("Decreasing capacity of %u, increasing of %u\n",
+    //       edge, OppositeEdgeIndex(edge));
+    if (edge < SourceEdgeIndex(0)) {
+      // Forward entry edges select the entry, backward edges deselect it.
+      size_t entry = edge / 2;
+      RecordSupportChange(entry, edge % 2 == 0);
+      if (solution_path_ != NULL) {
+        RecordChange(entry / num_cols_, entry % num_cols_, edge % 2 == 0);
+      }
+    }
+    cur_node = parent_[cur_node];
+  } while (cur_node != source);
+
+  if (solution_path_ != NULL) {
+    RecordAugmentation();
+  }
+}
+
+// Moves the potential of every row and column node into the interval in
+// which all residual arcs of the node have non-negative reduced costs (if
+// that interval is not empty). This never creates new arcs with negative
+// reduced costs, and after small changes of the costs, it removes most of
+// them without changing the flow.
+void DegreeFlowSolver::RepriceNodes() {
+  for (NodeIndex node = 0; node < num_nodes_; ++node) {
+    if (node == s_ || node == t_) {
+      continue;
+    }
+    double lower = -numeric_limits<double>::infinity();
+    double upper = numeric_limits<double>::infinity();
+    for (EdgeIndex arc = adjacency_offset_[node];
+         arc < adjacency_offset_[node + 1]; ++arc) {
+      EdgeIndex edge = arc_edge_[arc];
+      double bound = potential_[arc_to_[arc]] - arc_cost_[arc];
+      // arc_cost_[arc] + potential_[node] - potential_[arc_to_[arc]] >= 0
+      if (edge_capacity_[edge] > 0) {
+        lower = max(lower, bound);
+      }
+      // The opposite arc has cost -arc_cost_[arc].
+      if (edge_capacity_[OppositeEdgeIndex(edge)] > 0) {
+        upper = min(upper, bound);
+      }
+    }
+    if (lower <= upper) {
+      potential_[node] = min(max(potential_[node], lower), upper);
+    }
+  }
+}
+
+// Restores the optimality of the flow after the costs of the graph changed.
+// First, the potentials are adjusted locally (see RepriceNodes). Then every
+// entry arc with a negative reduced cost (w.r.t. the old
+// potentials) is saturated, i.e., the entry is selected or deselected. Then
+// all residual arcs have non-negative reduced costs, but the rows and columns
+// of the changed entries have an excess or a deficit of one unit. Each
+// excess is sent to the closest deficit along a shortest path, as in
+// successive shortest paths. The result is a min-cost flow with the same
+// value as the old flow. If the costs changed only slightly, few entries
+// change and only a few shortest path computations are necessary.
+void DegreeFlowSolver::RepairFlow() {
+  for (int sweep = 0; sweep < kNumRepricingSweeps; ++sweep) {
+    RepriceNodes();
+  }
 
-      double adjusted_edge_cost = cur_e.cost + potential[cur_node]
-                                             - potential[next_node];
-      if (dst[cur_node] + adjusted_edge_cost < dst[next_node]) {
-        dst[next_node] = dst[cur_node] + adjusted_edge_cost;
-        q.push(q_elem(-dst[next_node], next_node));
-        edge_taken_to[next_node] = *iter;
+  excess_.assign(num_nodes_, 0);
+  int num_excess_nodes = 0;
+  for (NodeIndex node = 0; node < num_nodes_; ++node) {
+    if (node == s_ || node == t_) {
+      // The costs of the source and sink edges do not change.
+      continue;
+    }
+    for (EdgeIndex arc = adjacency_offset_[node];
+         arc < adjacency_offset_[node + 1]; ++arc) {
+      EdgeIndex edge = arc_edge_[arc];
+      if (edge_capacity_[edge] > 0 && edge < SourceEdgeIndex(0)
+          && arc_cost_[arc] + potential_[node] - potential_[arc_to_[arc]]
+             < -admissible_tolerance_) {
+        edge_capacity_[edge] -= 1;
+        edge_capacity_[OppositeEdgeIndex(edge)] += 1;
+        RecordSupportChange(edge / 2, edge % 2 == 0);
+        excess_[node] -= 1;
+        excess_[arc_to_[arc]] += 1;
+        ++stats_.num_repriced_entries;
+      }
+    }
+  }
+  for (NodeIndex node = 0; node < num_nodes_; ++node) {
+    if (excess_[node] > 0) {
+      num_excess_nodes += 1;
+    }
+  }
 
-        ++updating_inner_iterations;
+  while (num_excess_nodes > 0) {
+    if (queue_type_ == DegreeFlowOptions::kLazyBinaryHeapQueue) {
+      SendExcess(&lazy_heap_);
+    } else if (queue_type_ == DegreeFlowOptions::kRadixHeapQueue) {
+      SendExcess(&radix_heap_);
+    } else if (queue_type_ == DegreeFlowOptions::kBucketQueue) {
+      SendExcess(&bucket_queue_);
+    } else {
+      SendExcess(&indexed_heap_);
+    }
+    num_excess_nodes = 0;
+    for (NodeIndex node = 0; node < num_nodes_; ++node) {
+      if (excess_[node] > 0) {
+        num_excess_nodes += 1;
       }
     }
   }
-  
-  if (num_found < num_connected_nodes) {
-    //printf("%d vs %d\n", num_found, num_connected_nodes);
+}
+
+// Sends one unit from a node with excess to the closest node with deficit.
+template <typename Queue>
+void DegreeFlowSolver::SendExcess(Queue* queue) {
+  ResetDijkstra();
+  queue->Reset(num_nodes_);
+  for (NodeIndex node = 0; node < num_nodes_; ++node) {
+    if (excess_[node] > 0) {
+      AddDijkstraSource(node, queue);
+    }
+  }
+  // Every deficit is reachable from the excess created together with it by
+  // going back along the changed entry, so a target is always found.
+  NodeIndex target = RunDijkstra(queue, kDeficitTarget);
+  UpdatePotentials(dst_[target]);
+
+  NodeIndex source = target;
+  while (parent_[source] != source) {
+    source = parent_[source];
+  }
+  AugmentPath(source, target);
+  excess_[source] -= 1;
+  excess_[target] += 1;
+}
+
+void DegreeFlowSolver::RecordChange(size_t row, size_t col, bool added) {
+  solution_path_->changes.push_back(
+      DegreeFlowSolutionPath::Change(row, col, added));
+  if (added) {
+    path_objective_ += abs(x_[row][col]);
+  } else {
+    path_objective_ -= abs(x_[row][col]);
+  }
+}
+
+void DegreeFlowSolver::RecordAugmentation() {
+  solution_path_->change_begin.push_back(solution_path_->changes.size());
+  solution_path_->objective.push_back(path_objective_);
+}
+
+void DegreeFlowSolver::RecordSupportChange(size_t entry, bool added) {
+  if (added) {
+    support_entries_.push_back(entry);
+    support_size_ += 1;
+  } else {
+    support_size_ -= 1;
+  }
+  if (support_entries_.size() > 2 * support_size_ + 64) {
+    CompactSupportEntries();
+  }
+}
+
+void DegreeFlowSolver::ResetSupportEntries() {
+  support_entries_.clear();
+  support_size_ = 0;
+}
+
+void DegreeFlowSolver::CompactSupportEntries() {
+  size_t num_kept = 0;
+  for (size_t ii = 0; ii < support_entries_.size(); ++ii) {
+    if (IsSupportEntry(support_entries_[ii])) {
+      support_entries_[num_kept] = support_entries_[ii];
+      num_kept += 1;
+    }
+  }
+  support_entries_.resize(num_kept);
+  // An entry that left and entered the support again is listed twice.
+  sort(support_entries_.begin(), support_entries_.end());
+  support_entries_.erase(unique(support_entries_.begin(),
+                                support_entries_.end()),
+                         support_entries_.end());
+}
+
+bool DegreeFlowSolver::IsSupportEntry(size_t entry) const {
+  if (engine_ == DegreeFlowOptions::kDenseEngine) {
+    return IsSelected(entry / num_cols_, entry % num_cols_);
+  } else if (engine_ == DegreeFlowOptions::kAssignmentEngine) {
+    return row_match_[entry / num_cols_]
+           == static_cast<int32_t>(entry % num_cols_);
+  }
+  return edge_capacity_[EntryEdgeIndex(entry)] == 0;
+}
+
+void DegreeFlowSupport::Clear(size_t _num_rows, size_t _num_cols) {
+  num_rows = _num_rows;
+  num_cols = _num_cols;
+  entries.clear();
+  objective = 0.0;
+}
+
+void DegreeFlowSupport::GetMatrix(vector<vector<bool> >* support) const {
+  support->assign(num_rows, vector<bool>(num_cols, false));
+  for (size_t ii = 0; ii < entries.size(); ++ii) {
+    (*support)[entries[ii].row][entries[ii].col] = true;
+  }
+}
+
+void DegreeFlowSolutionPath::Clear(size_t _num_rows, size_t _num_cols) {
+  num_rows = _num_rows;
+  num_cols = _num_cols;
+  changes.clear();
+  change_begin.assign(1, 0);
+  objective.clear();
+}
+
+void DegreeFlowSolutionPath::GetSupport(int k,
+                                        vector<vector<bool> >* support) const {
+  support->assign(num_rows, vector<bool>(num_cols, false));
+  k = min(max(k, 0), max_k());
+  for (size_t ii = 0; ii < change_begin[k]; ++ii) {
+    (*support)[changes[ii].row][changes[ii].col] = changes[ii].added;
+  }
+}
+
+const char* DegreeFlowOptions::EngineName(Engine engine) {
+  if (engine == kGraphEngine) {
+    return "graph";
+  } else if (engine == kDenseEngine) {
+    return "dense";
+  } else if (engine == kAssignmentEngine) {
+    return "assignment";
+  } else if (engine == kCostScalingEngine) {
+    return "cost_scaling";
+  } else {
+    return "automatic";
+  }
+}
+
+void DegreeFlowStats::Clear() {
+  phase_times = DegreeFlowPhaseTimes();
+  total_time = 0.0;
+  engine = DegreeFlowOptions::kAutomaticEngine;
+  num_shortest_path_runs = 0;
+  num_repriced_entries = 0;
+  num_augmentations = 0;
+  termination = kFinished;
+  allocated_bytes = 0;
+#ifdef DEGREE_FLOW_COUNTERS
+  counters_enabled = true;
+#else
+  counters_enabled = false;
+#endif
+  total_inner_iterations = 0;
+  checking_inner_iterations = 0;
+  updating_inner_iterations = 0;
+  num_queue_pushes = 0;
+  num_queue_pops = 0;
+  settled_nodes_histogram.clear();
+  num_scaling_phases = 0;
+  num_relabels = 0;
+  rounding_loss_bound = 0.0;
+}
+
+void DegreeFlowStats::ToJson(string* json) const {
+  const size_t kBufferSize = 1000;
+  char buffer[kBufferSize];
+  snprintf(buffer, kBufferSize, "{\"phase_times\": {\"graph_build\": %.9g, "
+           "\"initial_potentials\": %.9g, \"augmentation\": %.9g}, "
+           "\"total_time\": %.9g, \"engine\": \"%s\", "
+           "\"num_shortest_path_runs\": %lld, "
+           "\"num_repriced_entries\": %lld, \"num_augmentations\": %lld, "
+           "\"termination\": \"%s\", \"allocated_bytes\": %zu, "
+           "\"counters_enabled\": %s, \"total_inner_iterations\": %lld, "
+           "\"checking_inner_iterations\": %lld, "
+           "\"updating_inner_iterations\": %lld, "
+           "\"num_queue_pushes\": %lld, \"num_queue_pops\": %lld, "
+           "\"num_scaling_phases\": %lld, \"num_relabels\": %lld, "
+           "\"rounding_loss_bound\": %.9g, \"settled_nodes_histogram\": [",
+           phase_times.graph_build, phase_times.initial_potentials,
+           phase_times.augmentation, total_time,
+           DegreeFlowOptions::EngineName(engine), num_shortest_path_runs,
+           num_repriced_entries, num_augmentations,
+           TerminationName(termination), allocated_bytes,
+           counters_enabled ? "true" : "false", total_inner_iterations,
+           checking_inner_iterations, updating_inner_iterations,
+           num_queue_pushes, num_queue_pops, num_scaling_phases,
+           num_relabels, rounding_loss_bound);
+  json->append(buffer);
+  for (size_t ii = 0; ii < settled_nodes_histogram.size(); ++ii) {
+    snprintf(buffer, kBufferSize, "%s%lld", ii > 0 ? ", " : "",
+             settled_nodes_histogram[ii]);
+    json->append(buffer);
+  }
+  json->append("]}");
+}
+
+const char* DegreeFlowStats::TerminationName(Termination termination) {
+  if (termination == kTimeLimit) {
+    return "time_limit";
+  } else if (termination == kAugmentationLimit) {
+    return "augmentation_limit";
+  } else if (termination == kStopped) {
+    return "stopped";
+  } else {
+    return "finished";
+  }
+}
+
+bool DegreeFlowSparseMatrix::AssignTriplets(size_t _num_rows,
+                                            size_t _num_cols,
+                                            const vector<uint32_t>& rows,
+                                            const vector<uint32_t>& cols,
+                                            const vector<double>& values) {
+  num_rows = _num_rows;
+  num_cols = _num_cols;
+  row_offset.clear();
+  col_index.clear();
+  value.clear();
+  if (rows.size() != values.size() || cols.size() != values.size()) {
     return false;
   }
+  for (size_t ii = 0; ii < values.size(); ++ii) {
+    if (rows[ii] >= num_rows || cols[ii] >= num_cols) {
+      return false;
+    }
+  }
 
-  // change potentials
-  for (size_t ii = 0; ii < potential.size(); ++ii) {
-    potential[ii] += dst[ii];
+  // Sort the triplets by (row, col) and sum the values of duplicates.
+  vector<pair<pair<uint32_t, uint32_t>, double> > triplets(values.size());
+  for (size_t ii = 0; ii < values.size(); ++ii) {
+    triplets[ii] = make_pair(make_pair(rows[ii], cols[ii]), values[ii]);
   }
+  sort(triplets.begin(), triplets.end());
 
-  // change capacities
-  NodeIndex cur_node = t;
-  do {
-    Edge& forward_edge = e[edge_taken_to[cur_node]];
-    forward_edge.capacity -= 1;
-    e[forward_edge.opposite].capacity += 1;
-    //printf("Decreasing capacity of %zu, increasing of %zu\n",
-    //       edge_taken_to[cur_node], forward_edge.opposite);
-    cur_node = e[forward_edge.opposite].to;
-  } while (cur_node != s);
+  row_offset.assign(num_rows + 1, 0);
+  for (size_t ii = 0; ii < triplets.size(); ++ii) {
+    if (ii > 0 && triplets[ii].first == triplets[ii - 1].first) {
+      value.back() += triplets[ii].second;
+      continue;
+    }
+    row_offset[triplets[ii].first.first + 1] += 1;
+    col_index.push_back(triplets[ii].first.second);
+    value.push_back(triplets[ii].second);
+  }
+  for (size_t row = 0; row < num_rows; ++row) {
+    row_offset[row + 1] += row_offset[row];
+  }
+  return true;
+}
+
+// Without ties between the shortest path distances of the columns, only the
+// column of the last augmenting path has an admissible arc to t. This check
+// avoids the breadth-first search in that common case.
+bool DegreeFlowSolver::HasAdmissibleSinkArc() const {
+  for (size_t col = 0; col < num_cols_; ++col) {
+    NodeIndex col_node = ColNodeIndex(col);
+    if (edge_capacity_[SinkEdgeIndex(col)] > 0
+        && potential_[col_node] - potential_[t_] <= admissible_tolerance_) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Breadth-first search from s in the admissible graph, i.e., the residual
+// arcs with reduced cost 0. Returns true if t is reachable.
+bool DegreeFlowSolver::ComputeAdmissibleLevels() {
+  level_.assign(num_nodes_, -1);
+  bfs_queue_.clear();
+  level_[s_] = 0;
+  bfs_queue_.push_back(s_);
+  for (size_t head = 0; head < bfs_queue_.size(); ++head) {
+    NodeIndex cur_node = bfs_queue_[head];
+    EdgeIndex arc_end = adjacency_offset_[cur_node + 1];
+    for (EdgeIndex arc = adjacency_offset_[cur_node]; arc < arc_end; ++arc) {
+      Count(&stats_.total_inner_iterations);
+      NodeIndex next_node = arc_to_[arc];
+      if (level_[next_node] < 0 && IsAdmissible(cur_node, arc)) {
+        level_[next_node] = level_[cur_node] + 1;
+        bfs_queue_.push_back(next_node);
+      }
+    }
+  }
+  return level_[t_] >= 0;
+}
 
+// Depth-first search for a path from s to t in the level graph computed by
+// ComputeAdmissibleLevels. current_arc_ skips the arcs that were found to be
+// saturated or to lead into a dead end, so a blocking flow takes O(V * E)
+// time in total.
+bool DegreeFlowSolver::FindAdmissiblePath() {
+  NodeIndex cur_node = s_;
+  while (cur_node != t_) {
+    EdgeIndex arc_end = adjacency_offset_[cur_node + 1];
+    EdgeIndex& arc = current_arc_[cur_node];
+    for (; arc < arc_end; ++arc) {
+      Count(&stats_.total_inner_iterations);
+      NodeIndex next_node = arc_to_[arc];
+      if (level_[next_node] == level_[cur_node] + 1
+          && IsAdmissible(cur_node, arc)) {
+        break;
+      }
+    }
+    if (arc < arc_end) {
+      NodeIndex next_node = arc_to_[arc];
+      parent_[next_node] = cur_node;
+      edge_taken_to_[next_node] = arc_edge_[arc];
+      cur_node = next_node;
+    } else {
+      // t is not reachable from cur_node anymore.
+      if (cur_node == s_) {
+        return false;
+      }
+      level_[cur_node] = -1;
+      cur_node = parent_[cur_node];
+      ++current_arc_[cur_node];
+    }
+  }
   return true;
 }
+
+// Augments along paths of reduced cost 0 until there are none left or
+// max_paths paths have been found. All of these paths are shortest paths, so
+// the potentials remain valid and the flow remains a min-cost flow. Returns
+// the number of paths.
+int DegreeFlowSolver::AugmentBlockingFlow(int max_paths) {
+  int num_paths = 0;
+  while (num_paths < max_paths && HasAdmissibleSinkArc()
+         && ComputeAdmissibleLevels()) {
+    current_arc_.assign(adjacency_offset_.begin(),
+                        adjacency_offset_.end() - 1);
+    while (num_paths < max_paths && FindAdmissiblePath()) {
+      AugmentPath(s_, t_);
+      num_paths += 1;
+    }
+  }
+  return num_paths;
+}
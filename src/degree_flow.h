@@ -1,8 +1,1256 @@
 #ifndef __DEGREE_FLOW_H__
 #define __DEGREE_FLOW_H__
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "degree_flow_queues.h"
+#include "degree_flow_view.h"
+
+struct DegreeFlowOptions {
+  enum Engine {
+    // Choose an engine based on the degrees and the density of the flow
+    // graph.
+    kAutomaticEngine,
+    // Materialize the flow graph (CSR adjacency with one edge pair per
+    // matrix entry).
+    kGraphEngine,
+    // Implicit dense bipartite graph: entry costs are read from the input
+    // and entry capacities are kept in a bitset, which needs about one bit
+    // per matrix entry instead of about 40 bytes. Shortest paths are
+    // computed with an O(V^2) array-based Dijkstra and a vectorized
+    // relaxation of the row-to-column arcs.
+    kDenseEngine,
+    // Shortest augmenting paths on a matching (Jonker-Volgenant), for
+    // problems where every row and column degree is 0 or 1. The matching is
+    // kept in two arrays and the source and sink are implicit, so the state
+    // is O(r + c) and each search scans rows of the input sequentially. The
+    // automatic selection uses it for such problems unless warm_start is
+    // set. Sparse signals always use the graph engine.
+    kAssignmentEngine,
+    // Cost scaling push-relabel (Goldberg-Tarjan) on the materialized flow
+    // graph. Its running time hardly depends on k, so it is much faster
+    // than the successive shortest paths of the other engines for large k.
+    // It cannot record a solution path, does not support warm starts, and
+    // rounds the amplitudes to a multiple of max |x| / R with
+    // R = min(2^52, 2^60 / (V + 1)^2) for V nodes, i.e., to a relative
+    // precision of about 2^-52 only for graphs with up to about 2^4 nodes and
+    // of about V^2 / 2^60 for larger graphs (see degree_flow_cost_scaling.cc
+    // and DegreeFlowStats::rounding_loss_bound).
+    kCostScalingEngine
+  };
+
+  enum Queue {
+    // Binary heap with lazy deletion: every decrease of a distance pushes a
+    // new element, so the heap can grow to O(E) elements.
+    kLazyBinaryHeapQueue,
+    // Indexed 4-ary heap with decrease-key (at most one element per node).
+    kIndexedHeapQueue,
+    // Radix heap on the (monotone, non-negative) reduced distances. Breaks
+    // ties between shortest paths differently from the heaps above.
+    kRadixHeapQueue,
+    // Dial's bucket queue. Requires integer costs, i.e., a positive
+    // quantization_precision; otherwise the indexed heap is used instead.
+    kBucketQueue
+  };
+
+  Engine engine;
+  // The priority queue of the graph engine. The dense engine does not use a
+  // priority queue.
+  Queue queue;
+  // After each shortest path computation, augment along all paths of reduced
+  // cost 0 (a blocking flow on the admissible graph) instead of a single
+  // path. This reduces the number of shortest path computations and still
+  // gives an optimal support, but ties can be broken differently.
+  bool blocking_flow;
+
+  // Start from the support and the potentials of the previous call to Solve
+  // on the same DegreeFlowSolver. The previous problem must have had the
+  // same dimensions and degrees and must have used the graph engine (the
+  // automatic engine then also picks the graph engine); otherwise the solver
+  // starts from scratch. The solver first restores optimality of the old
+  // support for the new amplitudes and then adds or removes entries until
+  // the support has k entries. This is much faster than a cold start if the
+  // amplitudes changed only slightly. Ignored if a solution path is
+  // requested.
+  bool warm_start;
+
+  // If positive, the solver first projects only the candidate entries, i.e.,
+  // the pruning_candidates largest entries (in absolute value) of every row
+  // and column, with the sparse graph engine. Then it checks every other
+  // entry against the final node potentials. Entries with a negative reduced
+  // cost could improve the support, so they are added to the candidates and
+  // the solver starts again. Otherwise the potentials certify that the
+  // support is optimal for the full signal. A small multiple of the largest
+  // degree is usually enough. Only used for dense signals without a solution
+  // path; the engine and warm_start options are then ignored.
+  int pruning_candidates;
+
+  // If positive, every amplitude is rounded to the closest integer multiple
+  // of quantization_precision before the projection. The solver then works
+  // with integer costs (stored exactly in doubles), so ties are exact and
+  // do not depend on rounding errors, and the graph engine uses a bucket
+  // queue (the queue option is ignored). A coarser precision gives smaller
+  // integers and a faster bucket queue. The support is optimal for the
+  // rounded amplitudes; DegreeFlowSolver::quantization_loss_bound() bounds
+  // how much worse it can be for the original amplitudes.
+  double quantization_precision;
+
+  // Budgets for anytime solving. The solver stops between two augmentations
+  // once time_limit seconds have passed since the start of the call (if
+  // positive), once it has made max_augmentations augmentations (if
+  // positive), or once should_stop returns true. It then returns the
+  // support built so far, which satisfies the degrees but can have fewer
+  // than k entries; stats().termination tells why the solver stopped, and
+  // DegreeFlowSolver::objective_bound() how far the support can be from the
+  // optimum. The budgets apply to the whole call, including all rounds of
+  // candidate pruning. The cost scaling engine checks the time limit and
+  // should_stop only between its refine steps and limits the size of its
+  // maximum flow to max_augmentations. The repair of a warm start and the
+  // removal of surplus entries are never interrupted.
+  double time_limit;
+  int max_augmentations;
+  // Cancellation callback, called with should_stop_data between two
+  // augmentations (NULL if there is none). It can, e.g., read a flag that
+  // another thread sets.
+  bool (*should_stop)(void* data);
+  void* should_stop_data;
+
+  // Export the node potentials and the dual variables that certify the
+  // optimality of the support, see DegreeFlowSolver::certificate(). This
+  // costs one more pass over the signal.
+  bool certificate;
+
+  // Before building the flow graph, remove the rows and columns with degree
+  // 0 (and with them all entries that cannot be in the support) and clamp
+  // every degree to the number of remaining columns or rows, then solve the
+  // smaller problem and map its support back. The optimal supports are the
+  // same, but the graph only has nodes and edges for the remaining entries,
+  // and the automatic engine selection sees its real size. On inputs with
+  // ties, the support can differ from the one without compaction. If a
+  // column is removed, the remaining amplitudes are copied (views are
+  // otherwise read in place). Only used for dense signals, and only if some
+  // row or column is removed or clamped.
+  bool compaction;
+
+  DegreeFlowOptions() : engine(kAutomaticEngine), queue(kIndexedHeapQueue),
+                        blocking_flow(false), warm_start(false),
+                        pruning_candidates(0), quantization_precision(0.0),
+                        time_limit(0.0), max_augmentations(0),
+                        should_stop(NULL), should_stop_data(NULL),
+                        certificate(false), compaction(false) { }
+
+  // The name of an engine as reported in the statistics, e.g., "dense"
+  static const char* EngineName(Engine engine);
+};
+
+// The supports of a solve for all sparsities up to k. Successive shortest
+// paths adds one entry to the support per augmentation (and can swap other
+// entries in or out), and the support after i augmentations is optimal for
+// sparsity i. The path stores the changes of every augmentation, so the
+// support for any sparsity can be rebuilt without solving again.
+struct DegreeFlowSolutionPath {
+  struct Change {
+    uint32_t row;
+    uint32_t col;
+    // true if the entry enters the support, false if it leaves the support
+    bool added;
+
+    Change(uint32_t _row, uint32_t _col, bool _added)
+      : row(_row), col(_col), added(_added) { }
+  };
+
+  size_t num_rows;
+  size_t num_cols;
+  // The changes of augmentation i are changes[change_begin[i]], ...,
+  // changes[change_begin[i + 1] - 1].
+  std::vector<Change> changes;
+  std::vector<size_t> change_begin;
+  // objective[i] is the sum of the absolute amplitudes in the support after
+  // i + 1 augmentations.
+  std::vector<double> objective;
+
+  DegreeFlowSolutionPath() : num_rows(0), num_cols(0) { }
+
+  // The largest sparsity for which the path contains a support
+  int max_k() const {
+    return static_cast<int>(objective.size());
+  }
+
+  void Clear(size_t _num_rows, size_t _num_cols);
+
+  // Rebuilds the support for sparsity k, 0 <= k <= max_k().
+  void GetSupport(int k, std::vector<std::vector<bool> >* support) const;
+};
+
+// The support as the list of its entries. For k much smaller than r * c,
+// this is much smaller than a bool matrix, and the solver fills it without
+// scanning all entries.
+struct DegreeFlowSupport {
+  struct Entry {
+    uint32_t row;
+    uint32_t col;
+    double amplitude;
+
+    Entry(uint32_t _row, uint32_t _col, double _amplitude)
+      : row(_row), col(_col), amplitude(_amplitude) { }
+  };
+
+  size_t num_rows;
+  size_t num_cols;
+  // The entries in row-major order
+  std::vector<Entry> entries;
+  // The sum of the absolute amplitudes of the entries
+  double objective;
+
+  DegreeFlowSupport() : num_rows(0), num_cols(0), objective(0.0) { }
+
+  void Clear(size_t _num_rows, size_t _num_cols);
+
+  void GetMatrix(std::vector<std::vector<bool> >* support) const;
+};
+
+// The support solves the linear program
+//
+//   max sum_rc |x_rc| y_rc  s.t.  sum_c y_rc <= d_r,  sum_r y_rc <= d'_c,
+//                                 sum_rc y_rc = m,  0 <= y_rc <= 1,
+//
+// where m = min(k, maximum support size) is the size of the support, whose
+// dual has a variable u_r >= 0 per row, v_c >= 0 per column and a free l
+// for the sparsity (and w_rc = max(0, |x_rc| - u_r - v_c - l) per entry). A
+// certificate contains these duals, so the optimality of a support can be
+// checked in O(r * c) time without solving again, see
+// VerifyDegreeFlowSolution in degree_flow_verify.h.
+struct DegreeFlowCertificate {
+  size_t num_rows;
+  size_t num_cols;
+  // The node potentials of the flow graph in the order source, sink, rows,
+  // columns (in units of the amplitudes). The entry arc of (r, c) costs
+  // -|x_rc|, and the reduced cost cost + potential[from] - potential[to] of
+  // every residual arc is non-negative if the support is optimal.
+  std::vector<double> potential;
+  // The duals u, v and l, which are derived from the potentials
+  std::vector<double> row_dual;
+  std::vector<double> col_dual;
+  double sparsity_dual;
+  // The objective of the support and of the duals. The dual objective
+  // bounds the objective of every support with m entries and equals the
+  // objective of the support (up to rounding errors) iff the certificate
+  // proves optimality.
+  double objective;
+  double dual_objective;
+
+  DegreeFlowCertificate() : num_rows(0), num_cols(0), sparsity_dual(0.0),
+                            objective(0.0), dual_objective(0.0) { }
+};
+
+// Wall-clock times of the phases of a call to DegreeFlowSolver::Solve (in
+// seconds). If the solver solves several subproblems (candidate pruning),
+// the times are summed over the subproblems.
+struct DegreeFlowPhaseTimes {
+  // Building the flow graph
+  double graph_build;
+  // Computing the initial potentials (or repairing the flow of a warm start)
+  double initial_potentials;
+  // Augmenting the flow until the support has k entries
+  double augmentation;
+
+  DegreeFlowPhaseTimes() : graph_build(0.0), initial_potentials(0.0),
+                           augmentation(0.0) { }
+};
+
+// Statistics of a call to DegreeFlowSolver::Solve. If the solver solves
+// several subproblems (candidate pruning), the statistics are summed over
+// the subproblems.
+//
+// The hot-path counters are updated for every arc or queue operation. They
+// are only collected if the solver is compiled with -DDEGREE_FLOW_COUNTERS
+// (make COUNTERS=1) and are 0 otherwise, so release builds do not pay for
+// them. All other statistics are updated at most once per shortest path
+// computation and are always collected.
+struct DegreeFlowStats {
+  // Why the solver stopped, see DegreeFlowOptions::time_limit
+  enum Termination {
+    // The support is optimal (or k entries do not fit)
+    kFinished,
+    kTimeLimit,
+    kAugmentationLimit,
+    // should_stop returned true
+    kStopped
+  };
+
+  DegreeFlowPhaseTimes phase_times;
+  // Wall-clock time of the whole call (in seconds)
+  double total_time;
+  // The engine of the (last) subproblem
+  DegreeFlowOptions::Engine engine;
+  // Dijkstra runs, including unsuccessful ones and the runs of a warm start
+  long long num_shortest_path_runs;
+  // Entries changed by the repair of a warm start
+  long long num_repriced_entries;
+  // Augmenting paths, including the paths of the blocking flow and the
+  // maximum flow of the cost scaling engine
+  long long num_augmentations;
+  Termination termination;
+  // Bytes held by the buffers of the solver at the end of the call. The
+  // buffers are kept between calls, so this is the memory of the largest
+  // problem the solver has seen so far.
+  size_t allocated_bytes;
+
+  // Whether the hot-path counters were collected
+  bool counters_enabled;
+  // Hot-path counters: arcs scanned by the shortest path and blocking flow
+  // searches, relaxations, and relaxations that decreased a distance
+  long long total_inner_iterations;
+  long long checking_inner_iterations;
+  long long updating_inner_iterations;
+  // Priority queue insertions (or decrease-keys) and removals. The dense
+  // engine has no queue; there, every distance decrease counts as a push
+  // and every settled node as a pop.
+  long long num_queue_pushes;
+  long long num_queue_pops;
+  // settled_nodes_histogram[i] is the number of Dijkstra runs that settled
+  // between 2^i and 2^(i + 1) - 1 nodes (bucket 0 also counts runs that
+  // settled no node).
+  std::vector<long long> settled_nodes_histogram;
+  // Refine steps and relabel operations of the cost scaling engine
+  long long num_scaling_phases;
+  long long num_relabels;
+  // An upper bound on how much the objective of the support of the cost
+  // scaling engine can be below the optimum, because the engine rounds the
+  // costs (0 for the other engines)
+  double rounding_loss_bound;
+
+  DegreeFlowStats() {
+    Clear();
+  }
+
+  void Clear();
+
+  // Appends the statistics as a single JSON object.
+  void ToJson(std::string* json) const;
+
+  // The name of a termination reason as reported in the JSON output, e.g.,
+  // "time_limit"
+  static const char* TerminationName(Termination termination);
+};
+
+// A sparse signal in compressed sparse row (CSR) format. The stored entries
+// of row r are the positions row_offset[r], ..., row_offset[r + 1] - 1 of
+// col_index and value, with strictly increasing column indices. Entries that
+// are not stored cannot be in the support.
+struct DegreeFlowSparseMatrix {
+  size_t num_rows;
+  size_t num_cols;
+  std::vector<size_t> row_offset;
+  std::vector<uint32_t> col_index;
+  std::vector<double> value;
+
+  DegreeFlowSparseMatrix() : num_rows(0), num_cols(0) { }
+
+  size_t num_entries() const {
+    return value.size();
+  }
+
+  // Builds the matrix from coordinate (COO) triplets in any order. The
+  // values of duplicate coordinates are summed. Returns false if the three
+  // vectors differ in size or a coordinate is outside the matrix. The matrix
+  // then has no row offsets, so Solve rejects it.
+  bool AssignTriplets(size_t _num_rows, size_t _num_cols,
+                      const std::vector<uint32_t>& rows,
+                      const std::vector<uint32_t>& cols,
+                      const std::vector<double>& values);
+};
+
+// Computes projections into the bounded row / column degree model via
+// successive shortest paths on a bipartite flow graph.
+//
+// A DegreeFlowSolver owns all graph and scratch state, so independent
+// solvers can run concurrently on separate threads. The buffers are kept
+// between calls to Solve, so repeated projections of same-sized matrices do
+// not allocate.
+class DegreeFlowSolver {
+ public:
+  DegreeFlowSolver();
+
+  void Solve(
+      // signal coefficients (will not be squared)
+      const std::vector<std::vector<double> >& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: a bool matrix indicating support
+      std::vector<std::vector<bool> >* result);
+
+  void Solve(
+      // signal coefficients (will not be squared)
+      const std::vector<std::vector<double> >& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: a bool matrix indicating support
+      std::vector<std::vector<bool> >* result);
+
+  void Solve(
+      // signal coefficients (will not be squared)
+      const std::vector<std::vector<double> >& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: a bool matrix indicating support
+      std::vector<std::vector<bool> >* result,
+      // Result: the supports for all sparsities up to k (can be NULL)
+      DegreeFlowSolutionPath* solution_path);
+
+  // The same, but the support is returned as the list of its entries
+  // together with its objective value.
+  void Solve(
+      // signal coefficients (will not be squared)
+      const std::vector<std::vector<double> >& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: the entries of the support
+      DegreeFlowSupport* result,
+      // Result: the supports for all sparsities up to k (can be NULL)
+      DegreeFlowSolutionPath* solution_path);
+
+  // Projection of a dense signal in memory owned by the caller, e.g., a
+  // MATLAB array. The solver reads the amplitudes through the view and
+  // writes the support into the mask (1 for entries in the support, 0
+  // otherwise), so neither the signal nor the support is copied. The mask
+  // must have the same dimensions as x but can have a different layout.
+  //
+  // Column-major signals are solved as the transposed problem, so that the
+  // shortest path computations still read the amplitudes sequentially. On
+  // inputs with ties, this can return a different support with the same
+  // objective value than a row-major signal. Views in which neither stride
+  // is 1 are copied. Returns false (and clears the mask) if the problem is
+  // invalid.
+  bool Solve(
+      // signal coefficients (will not be squared)
+      const DegreeFlowMatrixView<const double>& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: the support mask
+      const DegreeFlowMatrixView<uint8_t>& result,
+      // Result: the supports for all sparsities up to k (can be NULL)
+      DegreeFlowSolutionPath* solution_path);
+
+  // The same for float amplitudes, which are converted to double once.
+  bool Solve(
+      // signal coefficients (will not be squared)
+      const DegreeFlowMatrixView<const float>& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: the support mask
+      const DegreeFlowMatrixView<uint8_t>& result,
+      // Result: the supports for all sparsities up to k (can be NULL)
+      DegreeFlowSolutionPath* solution_path);
+
+  // The same, but the support is returned as the (row, column) indices of
+  // its entries in row-major order, which is much smaller than a mask if k
+  // is small. Returns false (and clears the indices) if the problem is
+  // invalid.
+  bool Solve(
+      // signal coefficients (will not be squared)
+      const DegreeFlowMatrixView<const double>& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: the (row, column) indices of the support
+      std::vector<std::pair<uint32_t, uint32_t> >* result,
+      // Result: the supports for all sparsities up to k (can be NULL)
+      DegreeFlowSolutionPath* solution_path);
+
+  bool Solve(
+      // signal coefficients (will not be squared)
+      const DegreeFlowMatrixView<const double>& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: the entries of the support
+      DegreeFlowSupport* result,
+      // Result: the supports for all sparsities up to k (can be NULL)
+      DegreeFlowSolutionPath* solution_path);
+
+  bool Solve(
+      // signal coefficients (will not be squared)
+      const DegreeFlowMatrixView<const float>& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: the (row, column) indices of the support
+      std::vector<std::pair<uint32_t, uint32_t> >* result,
+      // Result: the supports for all sparsities up to k (can be NULL)
+      DegreeFlowSolutionPath* solution_path);
+
+  // Projection of a sparse signal. The flow graph only contains edges for
+  // the stored entries, so time and memory scale with the number of stored
+  // entries instead of r * c. Sparse signals always use the graph engine
+  // without warm starts, i.e., the engine and warm_start options are
+  // ignored.
+  void Solve(
+      // signal coefficients (will not be squared)
+      const DegreeFlowSparseMatrix& x,
+      // Total sparsity
+      int k,
+      // Row degrees
+      const std::vector<int>& row_degrees,
+      // Column degrees
+      const std::vector<int>& col_degrees,
+      // Solver options
+      const DegreeFlowOptions& options,
+      // Verbose output?
+      bool verbose,
+      // The output function
+      void (*output_function)(const char*),
+      // Result: result[i] is true iff the i-th stored entry of x is in the
+      // support
+      std::vector<bool>* result);
+
+  // After a solve with a positive quantization_precision, an upper bound on
+  // the difference between the objective (the sum of the absolute
+  // amplitudes in the support) of an optimal support for the original
+  // amplitudes and the objective of the returned support. 0 after solves
+  // without quantization.
+  double quantization_loss_bound() const {
+    return quantization_loss_bound_;
+  }
+
+  // An upper bound on the objective of an optimal support. If the last
+  // solve stopped early (see DegreeFlowOptions::time_limit), the bound
+  // comes from the node potentials by LP duality (see DualBound), so the
+  // bound minus the objective of the returned support bounds how far that
+  // support is from the optimum. Otherwise it is the objective of the
+  // returned support plus quantization_loss_bound().
+  double objective_bound() const {
+    return objective_bound_;
+  }
+
+  // After a solve with DegreeFlowOptions::certificate, the duals of the
+  // support. After a quantized solve, the potentials are those of the
+  // quantized problem, so they certify the support only up to the
+  // quantization loss.
+  const DegreeFlowCertificate& certificate() const {
+    return certificate_;
+  }
+
+  // The statistics of the last call to Solve
+  const DegreeFlowStats& stats() const {
+    return stats_;
+  }
+
+ private:
+  typedef uint32_t NodeIndex;
+  // Edge indices are 32 bits wide to keep the graph compact. Edges are
+  // stored in pairs, so the opposite of edge i is i ^ 1.
+  typedef uint32_t EdgeIndex;
+
+  static const int kOutputBufferSize = 10000;
+  // The automatic engine selection uses the dense engine if the number of
+  // entry arcs is at least this fraction of the squared number of nodes.
+  static const double kDenseEngineMinDensity;
+  // The automatic engine selection uses the cost scaling engine if the
+  // estimated work of the shortest path computations is at least this many
+  // times the number of entry arcs.
+  static const double kCostScalingMinWork;
+  // Arcs whose reduced cost is at most this fraction of the largest absolute
+  // cost are considered to have reduced cost 0 in the blocking flow.
+  static const double kAdmissibleTolerance;
+  // Special targets of RunDijkstra: no node, and any node with a deficit
+  static const NodeIndex kNoNode = 0xffffffff;
+  static const NodeIndex kDeficitTarget = 0xfffffffe;
+  // Number of passes of RepriceNodes in a warm start
+  static const int kNumRepricingSweeps = 2;
+  // The cost scaling engine divides epsilon by this factor in every step.
+  static const int kCostScalingFactor = 8;
+  // Quantized amplitudes must be at most this value divided by the number
+  // of nodes, so that all potentials and distances are exact integers.
+  static const double kMaxQuantizedPathCost;
+  // Quantized problems use the bucket queue if the largest quantized
+  // amplitude is at most this value, and the radix heap otherwise.
+  static const double kMaxBucketQueueCost;
+  // Hot-path counters, see DegreeFlowStats
+#ifdef DEGREE_FLOW_COUNTERS
+  static const bool kCountersEnabled = true;
+#else
+  static const bool kCountersEnabled = false;
+#endif
+
+  // The rows of a dense signal. Row r of the signal is x[r][0], ...,
+  // x[r][num_cols - 1], so the vector-of-vectors input and views with
+  // contiguous rows are read without a copy.
+  struct DenseSignal {
+    const double* const* rows;
+    size_t num_rows;
+    size_t num_cols;
+
+    DenseSignal() : rows(NULL), num_rows(0), num_cols(0) { }
+
+    const double* operator[](size_t row) const {
+      return rows[row];
+    }
+  };
+
+  // Destination of the support of a dense signal: a bool matrix (if matrix
+  // is not NULL), an index list (if indices is not NULL), an entry list (if
+  // entries is not NULL) or a byte mask. Entries are added in row-major
+  // order.
+  struct SupportOutput {
+    std::vector<std::vector<bool> >* matrix;
+    std::vector<std::pair<uint32_t, uint32_t> >* indices;
+    DegreeFlowSupport* entries;
+    DegreeFlowMatrixView<uint8_t> mask;
+
+    SupportOutput() : matrix(NULL), indices(NULL), entries(NULL) { }
+
+    // Removes all entries from the support.
+    void Reset(size_t num_rows, size_t num_cols) const;
+
+    void Add(size_t row, size_t col, double amplitude) const {
+      if (matrix != NULL) {
+        (*matrix)[row][col] = true;
+      } else if (entries != NULL) {
+        entries->entries.push_back(DegreeFlowSupport::Entry(row, col,
+                                                            amplitude));
+        entries->objective += std::abs(amplitude);
+      } else if (indices != NULL) {
+        indices->push_back(std::make_pair(static_cast<uint32_t>(row),
+                                          static_cast<uint32_t>(col)));
+      } else {
+        mask(row, col) = 1;
+      }
+    }
+
+    // Not available for index and entry lists
+    bool Contains(size_t row, size_t col) const {
+      if (matrix != NULL) {
+        return (*matrix)[row][col];
+      } else {
+        return mask(row, col) != 0;
+      }
+    }
+  };
+
+  // Entries are numbered in row-major order, i.e., entry (r, c) of a dense
+  // signal has index r * num_cols_ + c, and the entries of a sparse signal
+  // are numbered by their position in the CSR arrays.
+  EdgeIndex EntryEdgeIndex(size_t entry) const {
+    return 2 * entry;
+  }
+
+  EdgeIndex EntryEdgeIndex(size_t r, size_t c) const {
+    return EntryEdgeIndex(num_cols_ * r + c);
+  }
+
+  EdgeIndex SourceEdgeIndex(size_t r) const {
+    return 2 * (num_entries_ + r);
+  }
+
+  EdgeIndex SinkEdgeIndex(size_t c) const {
+    return 2 * (num_entries_ + num_rows_ + c);
+  }
+
+  static EdgeIndex OppositeEdgeIndex(EdgeIndex edge) {
+    return edge ^ 1;
+  }
+
+  NodeIndex RowNodeIndex(size_t r) const {
+    return 2 + r;
+  }
+
+  NodeIndex ColNodeIndex(size_t c) const {
+    return 2 + num_rows_ + c;
+  }
+
+  void AddArc(NodeIndex from, NodeIndex to, EdgeIndex edge, double cost) {
+    EdgeIndex arc = adjacency_end_[from];
+    adjacency_end_[from] += 1;
+    arc_edge_[arc] = edge;
+    arc_to_[arc] = to;
+    arc_cost_[arc] = cost;
+  }
+
+  // If keep_flow is true, only the costs are updated and the capacities
+  // (i.e., the flow) of the previous graph with the same structure are kept.
+  void BuildGraph(const DenseSignal& x,
+                  const std::vector<int>& row_degrees,
+                  const std::vector<int>& col_degrees,
+                  bool keep_flow);
+  void BuildSparseGraph(const DegreeFlowSparseMatrix& x,
+                        const std::vector<int>& row_degrees,
+                        const std::vector<int>& col_degrees);
+  void AddSourceAndSinkArcs(const std::vector<int>& row_degrees,
+                            const std::vector<int>& col_degrees,
+                            bool keep_flow);
+  void SetQueueType(DegreeFlowOptions::Queue queue);
+
+  // The body of the vector-of-vectors overloads of Solve. Returns false if
+  // the problem is invalid.
+  bool SolveVectorSignal(const std::vector<std::vector<double> >& x, int k,
+                         const std::vector<int>& row_degrees,
+                         const std::vector<int>& col_degrees,
+                         const DegreeFlowOptions& options, bool verbose,
+                         void (*output_function)(const char*),
+                         const SupportOutput& result,
+                         DegreeFlowSolutionPath* solution_path);
+  // The bodies of the public Solve overloads. Solve keeps the statistics
+  // of the outermost call. SolveDenseSignal returns false if the problem is
+  // invalid.
+  bool SolveDenseSignal(const DenseSignal& x, int k,
+                        const std::vector<int>& row_degrees,
+                        const std::vector<int>& col_degrees,
+                        const DegreeFlowOptions& options, bool verbose,
+                        void (*output_function)(const char*),
+                        const SupportOutput& result,
+                        DegreeFlowSolutionPath* solution_path);
+  // Writes the support from support_entries_, so only the support is
+  // visited.
+  void WriteSupport(const SupportOutput& result);
+  // The body of the view overloads of Solve (begin_time is the start of the
+  // public call)
+  bool SolveView(const DegreeFlowMatrixView<const double>& x, int k,
+                 const std::vector<int>& row_degrees,
+                 const std::vector<int>& col_degrees,
+                 const DegreeFlowOptions& options, bool verbose,
+                 void (*output_function)(const char*),
+                 const SupportOutput& result,
+                 DegreeFlowSolutionPath* solution_path, double begin_time);
+  DegreeFlowMatrixView<const double> ConvertSignal(
+      const DegreeFlowMatrixView<const float>& x);
+  void SolveSparseSignal(const DegreeFlowSparseMatrix& x, int k,
+                         const std::vector<int>& row_degrees,
+                         const std::vector<int>& col_degrees,
+                         const DegreeFlowOptions& options, bool verbose,
+                         void (*output_function)(const char*),
+                         std::vector<bool>* result);
+  // Pruned and quantized solves call Solve again for their subproblems.
+  bool IsSubproblem() const {
+    return solving_candidates_ || quantization_precision_ != 0.0;
+  }
+  void FinishStats(double begin_time);
+  size_t ComputeAllocatedBytes() const;
+
+  // Budgets (see DegreeFlowOptions::time_limit). ShouldStop is called
+  // between two augmentations, StopRequested only checks the time limit and
+  // the callback; both record the reason in stats_.termination.
+  // AugmentationBudget limits max_paths to the remaining augmentations.
+  bool ShouldStop(const DegreeFlowOptions& options);
+  bool StopRequested(const DegreeFlowOptions& options);
+  int AugmentationBudget(int max_paths,
+                         const DegreeFlowOptions& options) const;
+  bool StoppedEarly() const {
+    return stats_.termination != DegreeFlowStats::kFinished;
+  }
+
+  // Dual bound of a support that may not be optimal, and the certificate
+  double NodePotential(NodeIndex node) const;
+  void ComputeDuals(double scale, bool optimal, int k);
+  template <typename Signal>
+  void ExportCertificate(const Signal& x, int k, double scale);
+  static void TransposeCertificate(DegreeFlowCertificate* certificate);
+  double DualBound(const DenseSignal& x) const;
+  double DualBound(const DegreeFlowSparseMatrix& x) const;
+
+  // Quantization (see DegreeFlowOptions::quantization_precision)
+  bool SolveQuantized(const DenseSignal& x, int k,
+                      const std::vector<int>& row_degrees,
+                      const std::vector<int>& col_degrees,
+                      const DegreeFlowOptions& options, bool verbose,
+                      void (*output_function)(const char*),
+                      const SupportOutput& result,
+                      DegreeFlowSolutionPath* solution_path);
+  void SolveQuantized(const DegreeFlowSparseMatrix& x, int k,
+                      const std::vector<int>& row_degrees,
+                      const std::vector<int>& col_degrees,
+                      const DegreeFlowOptions& options, bool verbose,
+                      void (*output_function)(const char*),
+                      std::vector<bool>* result);
+  bool CheckQuantization(double max_abs_amplitude, double precision,
+                         size_t num_nodes,
+                         void (*output_function)(const char*));
+  DegreeFlowOptions QuantizedOptions(const DegreeFlowOptions& options,
+                                     double max_quantized_amplitude) const;
+  double Quantize(double amplitude, double precision, bool eligible);
+  void ComputeQuantizationLossBound(int k, double support_error,
+                                    bool verbose,
+                                    void (*output_function)(const char*));
+  template <typename Signal>
+  void SetQuantizedObjectiveBound(const Signal& x, int k, double precision,
+                                  double support_error);
+
+  // Compaction (see DegreeFlowOptions::compaction)
+  bool NeedsCompaction(const std::vector<int>& row_degrees,
+                       const std::vector<int>& col_degrees) const;
+  bool SolveCompacted(const DenseSignal& x, int k,
+                      const std::vector<int>& row_degrees,
+                      const std::vector<int>& col_degrees,
+                      const DegreeFlowOptions& options, bool verbose,
+                      void (*output_function)(const char*),
+                      const SupportOutput& result,
+                      DegreeFlowSolutionPath* solution_path);
+  void ExpandCertificate(size_t num_rows, size_t num_cols);
+
+  // Candidate pruning (see DegreeFlowOptions::pruning_candidates)
+  bool SolvePruned(const DenseSignal& x, int k,
+                   const std::vector<int>& row_degrees,
+                   const std::vector<int>& col_degrees,
+                   const DegreeFlowOptions& options, bool verbose,
+                   void (*output_function)(const char*),
+                   const SupportOutput& result);
+  void SelectCandidates(const DenseSignal& x,
+                        const std::vector<int>& row_degrees,
+                        const std::vector<int>& col_degrees,
+                        int num_candidates);
+  size_t AddViolatedCandidates(const DenseSignal& x,
+                               const std::vector<int>& row_degrees,
+                               const std::vector<int>& col_degrees,
+                               double tolerance, bool extend_reachable);
+  bool CheckSparseMatrix(const DegreeFlowSparseMatrix& x,
+                         void (*output_function)(const char*));
+  // Augments (or reduces) the flow of value num_selected until k entries are
+  // selected. Returns the final number of selected entries.
+  int AugmentToSparsity(int k, int num_selected,
+                        const DegreeFlowOptions& options, bool verbose,
+                        void (*output_function)(const char*));
+  long long MaxFlowBound(const std::vector<int>& row_degrees,
+                         const std::vector<int>& col_degrees) const;
+  void OutputDiagnostics(double total_time,
+                         void (*output_function)(const char*));
+  void ComputeInitialPotentials();
+  bool FindGraphPath(bool reverse);
+  template <typename Queue>
+  bool FindPath(Queue* queue);
+  template <typename Queue>
+  bool FindReversePath(Queue* queue);
+  template <typename Queue>
+  void AddDijkstraSource(NodeIndex source, Queue* queue);
+  template <typename Queue>
+  NodeIndex RunDijkstra(Queue* queue, NodeIndex target);
+  void ResetDijkstra();
+  void RecordShortestPathRun(size_t num_settled_nodes);
+  void UpdatePotentials(double max_dst);
+  void AugmentPath(NodeIndex source, NodeIndex target);
+
+  // Warm start
+  void RepairFlow();
+  void RepriceNodes();
+  template <typename Queue>
+  void SendExcess(Queue* queue);
+  void RecordChange(size_t row, size_t col, bool added);
+  void RecordAugmentation();
+  // Keeps support_entries_ up to date when an entry enters or leaves the
+  // support. Called after the flow has been changed.
+  void RecordSupportChange(size_t entry, bool added);
+  void ResetSupportEntries();
+  // Reduces support_entries_ to the entries in the support, sorted and
+  // without duplicates (O(s log s) for a list of s entries).
+  void CompactSupportEntries();
+  bool IsSupportEntry(size_t entry) const;
+
+  // Blocking flow on the admissible graph
+  int AugmentBlockingFlow(int max_paths);
+  bool HasAdmissibleSinkArc() const;
+  bool ComputeAdmissibleLevels();
+  bool FindAdmissiblePath();
+
+  bool IsAdmissible(NodeIndex from, EdgeIndex arc) const {
+    return edge_capacity_[arc_edge_[arc]] > 0
+        && arc_cost_[arc] + potential_[from] - potential_[arc_to_[arc]]
+           <= admissible_tolerance_;
+  }
+
+  // Implicit dense engine, see degree_flow_dense.cc
+  // The degrees are read from row_degree_ and col_degree_.
+  void BuildDenseGraph(const DenseSignal& x);
+  void ComputeInitialPotentialsDense();
+  bool FindPathDense();
+  void ResetDenseDijkstra();
+  NodeIndex SelectMinDense() const;
+  void RelaxEntryArcsDense(size_t row);
+  void AugmentPathDense();
+  EdgeIndex NumArcsDense(NodeIndex node) const;
+  NodeIndex AdmissibleArcHeadDense(NodeIndex node, EdgeIndex arc) const;
+  int AugmentBlockingFlowDense(int max_paths);
+  bool HasAdmissibleSinkArcDense() const;
+  bool ComputeAdmissibleLevelsDense();
+  bool FindAdmissiblePathDense();
+  bool IsAdmissibleDense(NodeIndex from, NodeIndex to, double cost) const {
+    return cost + potential_[from] - potential_[to] <= admissible_tolerance_;
+  }
+
+  // Assignment engine, see degree_flow_assignment.cc
+  static bool DegreesAreAssignment(const std::vector<int>& row_degrees,
+                                   const std::vector<int>& col_degrees);
+  void BuildAssignment(const DenseSignal& x);
+  void ComputeInitialPotentialsAssignment();
+  bool FindPathAssignment();
+  void UpdateFreeRowMin(size_t col);
+
+  // Cost scaling engine, see degree_flow_cost_scaling.cc. It works on the
+  // graph built by BuildGraph.
+  int SolveCostScaling(int k, const DegreeFlowOptions& options);
+  static double CostScalingMaxRoundedCost(size_t num_nodes);
+  int ComputeMaxFlow(int max_flow);
+  void RefineCostScaling(int64_t epsilon);
+  void DischargeCostScaling(NodeIndex node, int64_t epsilon);
+  void RelabelCostScaling(NodeIndex node, int64_t epsilon);
+  void ActivateNode(NodeIndex node);
+
+  size_t EntryBitIndex(size_t r, size_t c) const {
+    return num_cols_ * r + c;
+  }
+
+  bool IsSelected(size_t r, size_t c) const {
+    size_t bit = EntryBitIndex(r, c);
+    return (selected_[bit / 64] >> (bit % 64)) & 1;
+  }
+
+  void FlipSelected(size_t r, size_t c) {
+    size_t bit = EntryBitIndex(r, c);
+    selected_[bit / 64] ^= static_cast<uint64_t>(1) << (bit % 64);
+  }
+
+  bool IsRowNode(NodeIndex node) const {
+    return node >= 2 && node < 2 + num_rows_;
+  }
+
+  // Adds value to a hot-path counter. The call is removed by the compiler
+  // if the counters are disabled.
+  static void Count(long long* counter, long long value) {
+    if (kCountersEnabled) {
+      *counter += value;
+    }
+  }
+
+  static void Count(long long* counter) {
+    Count(counter, 1);
+  }
+
+  // Relaxation step of the array-based Dijkstra in the dense engine.
+  void RelaxDense(NodeIndex cur_node, NodeIndex next_node, double cost) {
+    Count(&stats_.checking_inner_iterations);
+    double adjusted_edge_cost = cost + potential_[cur_node]
+                                     - potential_[next_node];
+    if (dst_[cur_node] + adjusted_edge_cost < dst_[next_node]) {
+      dst_[next_node] = dst_[cur_node] + adjusted_edge_cost;
+      parent_[next_node] = cur_node;
+
+      Count(&stats_.updating_inner_iterations);
+      Count(&stats_.num_queue_pushes);
+    }
+  }
+
+  // The relaxation step of the heap-based Dijkstra. Returns true if the
+  // distance of next_node decreased.
+  template <typename Queue>
+  bool Relax(NodeIndex cur_node, NodeIndex next_node, double cost,
+             Queue* queue) {
+    Count(&stats_.checking_inner_iterations);
+    double adjusted_edge_cost = cost + potential_[cur_node]
+                                     - potential_[next_node];
+    if (dst_[cur_node] + adjusted_edge_cost < dst_[next_node]) {
+      dst_[next_node] = dst_[cur_node] + adjusted_edge_cost;
+      queue->Update(next_node, dst_[next_node]);
+      parent_[next_node] = cur_node;
+
+      Count(&stats_.updating_inner_iterations);
+      Count(&stats_.num_queue_pushes);
+      return true;
+    }
+    return false;
+  }
+
+  size_t num_nodes_;
+  size_t num_rows_;
+  size_t num_cols_;
+  // Number of entries with an entry edge (r * c for dense signals)
+  size_t num_entries_;
+  // source, sink
+  NodeIndex s_, t_;
+  // The engine and queue used for the current problem
+  DegreeFlowOptions::Engine engine_;
+  DegreeFlowOptions::Queue queue_type_;
+
+  // Residual capacity of each edge
+  std::vector<int> edge_capacity_;
+
+  // The arcs leaving node u are adjacency_offset_[u], ...,
+  // adjacency_offset_[u + 1] - 1. For each arc, the hot fields of its edge
+  // are copied into separate arrays so that relaxing the arcs of a node
+  // reads memory sequentially. Only the capacity is looked up via arc_edge_.
+  std::vector<EdgeIndex> adjacency_offset_;
+  std::vector<EdgeIndex> arc_edge_;
+  std::vector<NodeIndex> arc_to_;
+  std::vector<double> arc_cost_;
+  // Insertion positions during BuildGraph
+  std::vector<EdgeIndex> adjacency_end_;
+
+  // The input of the current problem. signal_rows_ holds the row pointers
+  // of the signal passed to Solve, signal_copy_ a row-major copy of signals
+  // whose rows are not contiguous, and converted_x_ float signals converted
+  // to double.
+  DenseSignal x_;
+  std::vector<const double*> signal_rows_;
+  std::vector<double> signal_copy_;
+  std::vector<double> converted_x_;
+
+  // The solution path of the current problem (NULL if it is not recorded)
+  // and the objective of the current support
+  DegreeFlowSolutionPath* solution_path_;
+  double path_objective_;
+
+  // Every entry that entered the support since the last compaction, so the
+  // support can be written without scanning all entries. Entries that left
+  // the support again are only removed when the list is compacted, which
+  // happens when it has grown to twice the support size. A compaction sorts
+  // the list, so it takes O(s log s) time for s support entries, i.e.,
+  // amortized O(log s) per change of the support, and writing the support
+  // takes O(s log s) time. support_size_ is the number of entries in the
+  // support.
+  std::vector<size_t> support_entries_;
+  size_t support_size_;
+
+  // Whether the graph engine state of the previous problem can be used for
+  // a warm start, and the size of its support
+  bool warm_start_valid_;
+  int flow_value_;
+  // Excess (positive) or deficit (negative) of each node during the repair
+  // and in the refine steps of the cost scaling engine
+  std::vector<int> excess_;
+
+  // State of the implicit dense engine. Entry (r, c) is in the support iff
+  // its bit in selected_ is set, i.e., the forward edge of the entry has
+  // capacity 0 and the backward edge has capacity 1. row_flow_ and
+  // col_flow_ are the flows on the source and sink edges. row_degree_ and
+  // col_degree_ are the degrees of the current problem in both engines.
+  std::vector<uint64_t> selected_;
+  std::vector<int> row_degree_;
+  std::vector<int> col_degree_;
+  std::vector<int> row_flow_;
+  std::vector<int> col_flow_;
+  // 0 for nodes that are not settled yet and infinity for settled nodes, so
+  // that adding it to a distance masks out settled nodes.
+  std::vector<double> settled_;
+
+  // node potentials
+  std::vector<double> potential_;
+
+  // State of the assignment engine. row_match_ and col_match_ hold the
+  // matched column of each row and the matched row of each column (-1 if
+  // there is none). Free rows all have the potential of the source, so
+  // row_potential_ is only meaningful for matched rows. free_row_min_ is the
+  // smallest cost of each column over the free rows with positive degree,
+  // and free_row_argmin_ is that row. Both are stale if that row has been
+  // matched since, see degree_flow_assignment.cc. The remaining arrays are
+  // the scratch space of a search: col_settled_ is 0 or infinity as
+  // settled_ above, and col_relaxed_dst_ is the distance of a column over
+  // the arcs from matched rows only (col_parent_ is that row).
+  std::vector<int32_t> row_match_;
+  std::vector<int32_t> col_match_;
+  std::vector<double> row_potential_;
+  std::vector<double> col_potential_;
+  double source_potential_;
+  double sink_potential_;
+  std::vector<double> free_row_min_;
+  std::vector<int32_t> free_row_argmin_;
+  std::vector<double> col_dst_;
+  std::vector<double> col_settled_;
+  std::vector<int32_t> col_parent_;
+  std::vector<double> col_relaxed_dst_;
+  std::vector<double> row_dst_;
+  std::vector<size_t> settled_cols_;
+  std::vector<size_t> settled_rows_;
+
+  // State of the cost scaling engine: the rounded and scaled cost of each
+  // arc, the node prices, and a ring buffer of the nodes with positive
+  // excess (excess_ above), starting at active_head_.
+  std::vector<int64_t> scaled_cost_;
+  std::vector<int64_t> price_;
+  std::vector<NodeIndex> active_nodes_;
+  size_t active_head_;
+  size_t num_active_nodes_;
+  // The original cost of one unit of scaled cost
+  double cost_scaling_unit_;
+
+  // Dijkstra scratch space
+  std::vector<bool> visited_;
+  std::vector<double> dst_;
+  std::vector<EdgeIndex> edge_taken_to_;
+  std::vector<NodeIndex> parent_;
+  LazyBinaryHeap lazy_heap_;
+  IndexedDAryHeap<4> indexed_heap_;
+  RadixHeap radix_heap_;
+  BucketQueue bucket_queue_;
+
+  // Quantization: the quantized amplitudes (row-major) and their row
+  // pointers, the precision of the current problem (0 if it is not
+  // quantized), the precision of the problem that left the warm start state,
+  // and the positive rounding errors of the entries that can be in the
+  // support.
+  std::vector<double> quantized_x_;
+  std::vector<const double*> quantized_rows_;
+  DegreeFlowSparseMatrix quantized_sparse_x_;
+  double quantization_precision_;
+  double warm_start_precision_;
+  std::vector<double> quantization_errors_;
+  double quantization_loss_bound_;
+
+  // Compaction: the original index of every row and column of the compacted
+  // problem, their clamped degrees, the compacted amplitudes (row-major, only
+  // if columns were removed) and their row pointers, and the support of the
+  // compacted problem. compacting_ is true while it is solved, which keeps
+  // the deadline of the outer call.
+  std::vector<size_t> compact_row_index_;
+  std::vector<size_t> compact_col_index_;
+  std::vector<int> compact_row_degrees_;
+  std::vector<int> compact_col_degrees_;
+  std::vector<double> compact_x_;
+  std::vector<const double*> compact_rows_;
+  std::vector<std::pair<uint32_t, uint32_t> > compact_support_;
+  bool compacting_;
+
+  // Candidate pruning: is_candidate_ contains one flag per entry in
+  // row-major order, candidates_ the candidate entries of the current round.
+  std::vector<bool> is_candidate_;
+  DegreeFlowSparseMatrix candidates_;
+  std::vector<bool> candidate_result_;
+  std::vector<std::pair<double, uint32_t> > candidate_order_;
+  // True while SolvePruned solves a candidate problem, which suppresses the
+  // message for an infeasible sparsity
+  bool solving_candidates_;
+
+  // Blocking flow scratch space. level_ is the BFS level of a node in the
+  // admissible graph (-1 if unreachable or a dead end), current_arc_ the
+  // next arc to try in the depth-first search. In the dense engine, the
+  // arcs of a row are indexed by column and the arcs of a column by row.
+  double admissible_tolerance_;
+  std::vector<int> level_;
+  std::vector<EdgeIndex> current_arc_;
+  std::vector<NodeIndex> bfs_queue_;
+
+  // Candidate pruning keeps the support of the last complete round, which
+  // is returned if a later round stops early with a smaller objective.
+  // Entries are numbered in row-major order.
+  std::vector<size_t> pruned_support_;
+  double pruned_objective_;
+
+  // Anytime solving: the end of the time limit (in WallTime() seconds), the
+  // dual variables of the rows, the columns and the sparsity constraint
+  // (see DualBound), and the objective bound of the last solve
+  double deadline_;
+  std::vector<double> row_dual_;
+  std::vector<double> col_dual_;
+  double sparsity_dual_;
+  double objective_bound_;
+  // The objective of the returned support, the potentials of all nodes (in
+  // units of the amplitudes) from which the duals are computed, and the
+  // exported certificate
+  double objective_;
+  std::vector<double> node_potential_;
+  DegreeFlowCertificate certificate_;
+
+  DegreeFlowStats stats_;
+  // Upper bound on the size of the support given by the degrees, and the
+  // right-hand side of the sparsity constraint in DualBound
+  long long max_flow_bound_;
+  long long dual_support_size_;
+
+  char output_buffer_[kOutputBufferSize];
+
+  // Solvers hold large buffers and are not meant to be copied.
+  DegreeFlowSolver(const DegreeFlowSolver&);
+  DegreeFlowSolver& operator=(const DegreeFlowSolver&);
+};
+
+// Convenience wrapper that runs a temporary DegreeFlowSolver.
 void degree_flow(
     // signal coefficients (will not be squared)
     const std::vector<std::vector<double> >& x,
@@ -17,6 +1265,8 @@ void degree_flow(
     // The output function
     void (*output_function)(const char*),
     // Result: a bool matrix indicating support
-    std::vector<std::vector<bool> >* result);
+    std::vector<std::vector<bool> >* result,
+    // Result: the statistics of the solve (can be NULL)
+    DegreeFlowStats* stats = NULL);
 
 #endif
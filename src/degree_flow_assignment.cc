@@ -0,0 +1,257 @@
+// Assignment engine of DegreeFlowSolver.
+//
+// If every row and column degree is 0 or 1, a support is a matching between
+// the rows and the columns, and the problem is a k-cardinality assignment
+// problem. The engine runs the same successive shortest paths as the other
+// engines, but in the style of the Jonker-Volgenant shortest augmenting path
+// method: the matching is kept as two arrays, the source and the sink are
+// implicit, and every shortest path computation works on arrays indexed by
+// column.
+//
+// All free rows are at distance 0 from the source, and their potentials
+// equal the potential of the source, so the search starts with
+// free_row_min_, the smallest cost of each column over the free rows.
+// Settling a matched column settles its matched row at the same distance,
+// so the search settles one column per step and scans one row of the input
+// per settled column. The potentials are updated as in the other engines,
+// minus the distance of the sink, so only the settled nodes change.
+//
+// When a free row is matched, the minima of the columns whose cheapest free
+// row it was become stale. A stale minimum is still a lower bound on the
+// distance of its column, so it is only recomputed (in O(r) time) when the
+// search selects the column. The search selects each column at most once
+// more for this, so matching a row costs no scan of all free rows, and a
+// search spends at most O(r) extra time per column it selects, next to the
+// O(c) scans that select the column and relax the arcs of its row.
+
+#include "degree_flow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const int32_t kUnmatched = -1;
+
+}  // namespace
+
+bool DegreeFlowSolver::DegreesAreAssignment(
+    const vector<int>& row_degrees, const vector<int>& col_degrees) {
+  for (size_t row = 0; row < row_degrees.size(); ++row) {
+    if (row_degrees[row] > 1) {
+      return false;
+    }
+  }
+  for (size_t col = 0; col < col_degrees.size(); ++col) {
+    if (col_degrees[col] > 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DegreeFlowSolver::BuildAssignment(const DenseSignal& x) {
+  s_ = 0;
+  t_ = 1;
+  num_nodes_ = num_rows_ + num_cols_ + 2;
+
+  x_ = x;
+  row_match_.assign(num_rows_, kUnmatched);
+  col_match_.assign(num_cols_, kUnmatched);
+  col_dst_.resize(num_cols_);
+  col_settled_.resize(num_cols_);
+  col_parent_.resize(num_cols_);
+  col_relaxed_dst_.resize(num_cols_);
+  row_dst_.resize(num_rows_);
+  settled_cols_.reserve(num_cols_);
+  settled_rows_.reserve(num_rows_);
+  ResetSupportEntries();
+}
+
+// The initial potentials are the distances from the source in the graph
+// without flow: 0 for the source and the rows, the smallest cost of its
+// column for each column, and the smallest column potential for the sink.
+void DegreeFlowSolver::ComputeInitialPotentialsAssignment() {
+  const double infinity = numeric_limits<double>::infinity();
+  free_row_min_.assign(num_cols_, infinity);
+  free_row_argmin_.assign(num_cols_, kUnmatched);
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degree_[row] <= 0) {
+      continue;
+    }
+    const double* x_row = x_[row];
+    for (size_t col = 0; col < num_cols_; ++col) {
+      Count(&stats_.total_inner_iterations);
+      double cost = -abs(x_row[col]);
+      if (cost < free_row_min_[col]) {
+        free_row_min_[col] = cost;
+        free_row_argmin_[col] = row;
+      }
+    }
+  }
+
+  source_potential_ = 0.0;
+  row_potential_.assign(num_rows_, 0.0);
+  col_potential_.assign(num_cols_, 0.0);
+  sink_potential_ = 0.0;
+  for (size_t col = 0; col < num_cols_; ++col) {
+    if (col_degree_[col] > 0 && free_row_argmin_[col] != kUnmatched) {
+      col_potential_[col] = free_row_min_[col];
+      sink_potential_ = min(sink_potential_, free_row_min_[col]);
+    }
+  }
+}
+
+// Recomputes the smallest cost of col over the free rows, after the row of
+// its previous minimum has been matched.
+void DegreeFlowSolver::UpdateFreeRowMin(size_t col) {
+  free_row_min_[col] = numeric_limits<double>::infinity();
+  free_row_argmin_[col] = kUnmatched;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    Count(&stats_.total_inner_iterations);
+    if (row_degree_[row] <= 0 || row_match_[row] != kUnmatched) {
+      continue;
+    }
+    double cost = -abs(x_[row][col]);
+    if (cost < free_row_min_[col]) {
+      free_row_min_[col] = cost;
+      free_row_argmin_[col] = row;
+    }
+  }
+}
+
+bool DegreeFlowSolver::FindPathAssignment() {
+  const double infinity = numeric_limits<double>::infinity();
+  // Columns start with their cheapest arc from a free row, which may be
+  // stale (see the top of the file). Columns with degree 0 have no arcs.
+  for (size_t col = 0; col < num_cols_; ++col) {
+    col_relaxed_dst_[col] = infinity;
+    if (col_degree_[col] > 0 && free_row_argmin_[col] != kUnmatched) {
+      col_dst_[col] = free_row_min_[col] + source_potential_
+                      - col_potential_[col];
+      col_settled_[col] = 0.0;
+      Count(&stats_.num_queue_pushes);
+    } else {
+      col_dst_[col] = infinity;
+      col_settled_[col] = infinity;
+    }
+  }
+  settled_cols_.clear();
+  settled_rows_.clear();
+
+  double sink_dst = infinity;
+  int32_t last_col = kUnmatched;
+  while (true) {
+    // The unsettled column with the smallest distance
+    double min_dst = infinity;
+    size_t min_col = 0;
+    for (size_t col = 0; col < num_cols_; ++col) {
+      Count(&stats_.total_inner_iterations);
+      double dst = col_dst_[col] + col_settled_[col];
+      if (dst < min_dst) {
+        min_dst = dst;
+        min_col = col;
+      }
+    }
+    // The sink is settled before all columns at the same distance.
+    if (min_dst >= sink_dst || min_dst == infinity) {
+      break;
+    }
+    if (min_dst < col_relaxed_dst_[min_col]) {
+      // The distance is the one of the arc from the cheapest free row. If
+      // that row has been matched, the distance is only a lower bound, so
+      // replace it by the current minimum and select again.
+      if (row_match_[free_row_argmin_[min_col]] != kUnmatched) {
+        UpdateFreeRowMin(min_col);
+        col_dst_[min_col] = col_relaxed_dst_[min_col];
+        if (free_row_argmin_[min_col] != kUnmatched) {
+          col_dst_[min_col] = min(col_dst_[min_col],
+                                  free_row_min_[min_col] + source_potential_
+                                  - col_potential_[min_col]);
+        }
+        continue;
+      }
+      col_parent_[min_col] = free_row_argmin_[min_col];
+    }
+    col_settled_[min_col] = infinity;
+    settled_cols_.push_back(min_col);
+    Count(&stats_.num_queue_pops);
+
+    int32_t row = col_match_[min_col];
+    if (row == kUnmatched) {
+      // free column -> sink
+      double dst = min_dst + col_potential_[min_col] - sink_potential_;
+      if (dst < sink_dst) {
+        sink_dst = dst;
+        last_col = min_col;
+      }
+      continue;
+    }
+
+    // column -> its matched row -> unsettled columns
+    double row_dst = min_dst + abs(x_[row][min_col]) + col_potential_[min_col]
+                     - row_potential_[row];
+    row_dst_[row] = row_dst;
+    settled_rows_.push_back(row);
+    const double* x_row = x_[row];
+    double offset = row_dst + row_potential_[row];
+    for (size_t col = 0; col < num_cols_; ++col) {
+      Count(&stats_.checking_inner_iterations);
+      double dst = offset - abs(x_row[col]) - col_potential_[col]
+                   + col_settled_[col];
+      if (dst < col_relaxed_dst_[col]) {
+        col_relaxed_dst_[col] = dst;
+        col_dst_[col] = min(col_dst_[col], dst);
+        col_parent_[col] = row;
+        Count(&stats_.updating_inner_iterations);
+        Count(&stats_.num_queue_pushes);
+      }
+    }
+  }
+  RecordShortestPathRun(settled_cols_.size() + settled_rows_.size());
+  if (last_col == kUnmatched) {
+    return false;
+  }
+
+  // Potentials: only the settled nodes change (see the top of the file).
+  for (size_t ii = 0; ii < settled_cols_.size(); ++ii) {
+    size_t col = settled_cols_[ii];
+    col_potential_[col] += col_dst_[col] - sink_dst;
+  }
+  for (size_t ii = 0; ii < settled_rows_.size(); ++ii) {
+    size_t row = settled_rows_[ii];
+    row_potential_[row] += min(row_dst_[row], sink_dst) - sink_dst;
+  }
+  source_potential_ -= sink_dst;
+
+  // Augment along the alternating path back to a free row.
+  int32_t col = last_col;
+  while (true) {
+    int32_t row = col_parent_[col];
+    int32_t previous_col = row_match_[row];
+    row_match_[row] = col;
+    col_match_[col] = row;
+    RecordSupportChange(EntryBitIndex(row, col), true);
+    if (solution_path_ != NULL) {
+      RecordChange(row, col, true);
+    }
+    if (previous_col == kUnmatched) {
+      // The row was free, so its potential was the one of the source.
+      row_potential_[row] = source_potential_;
+      break;
+    }
+    RecordSupportChange(EntryBitIndex(row, previous_col), false);
+    if (solution_path_ != NULL) {
+      RecordChange(row, previous_col, false);
+    }
+    col = previous_col;
+  }
+  if (solution_path_ != NULL) {
+    RecordAugmentation();
+  }
+  return true;
+}
@@ -0,0 +1,203 @@
+#include "degree_flow_batch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "degree_flow_time.h"
+
+using namespace std;
+
+namespace {
+
+// Rough estimate of the work in a job: every augmentation runs a Dijkstra
+// over all entries of the matrix.
+double EstimatedJobSize(const DegreeFlowJob& job) {
+  double num_entries = static_cast<double>(job.x->size());
+  if (!job.x->empty()) {
+    num_entries *= (*job.x)[0].size();
+  }
+  return num_entries * max(job.k, 1);
+}
+
+}  // namespace
+
+DegreeFlowBatchSolver::DegreeFlowBatchSolver(int num_threads)
+    : generation_(0), num_busy_workers_(0), shutting_down_(false),
+      jobs_(NULL), results_(NULL), output_function_(NULL),
+      batch_start_time_(0.0) {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&work_available_, NULL);
+  pthread_cond_init(&work_done_, NULL);
+
+  // The workers are added to workers_ only once their thread runs, so the
+  // pool shrinks to the threads that could be started. If none could, a
+  // single worker without a thread runs the jobs in Solve.
+  num_threads = max(num_threads, 1);
+  for (int ii = 0; ii < num_threads; ++ii) {
+    Worker* worker = new Worker();
+    worker->pool = this;
+    worker->id = ii;
+    pthread_mutex_init(&(worker->jobs_mutex), NULL);
+    worker->started = (pthread_create(&(worker->thread), NULL, WorkerMain,
+                                      worker) == 0);
+    if (!worker->started && !workers_.empty()) {
+      pthread_mutex_destroy(&(worker->jobs_mutex));
+      delete worker;
+      break;
+    }
+    workers_.push_back(worker);
+    if (!worker->started) {
+      break;
+    }
+  }
+}
+
+DegreeFlowBatchSolver::~DegreeFlowBatchSolver() {
+  pthread_mutex_lock(&mutex_);
+  shutting_down_ = true;
+  pthread_cond_broadcast(&work_available_);
+  pthread_mutex_unlock(&mutex_);
+
+  for (size_t ii = 0; ii < workers_.size(); ++ii) {
+    if (workers_[ii]->started) {
+      pthread_join(workers_[ii]->thread, NULL);
+    }
+    pthread_mutex_destroy(&(workers_[ii]->jobs_mutex));
+    delete workers_[ii];
+  }
+
+  pthread_cond_destroy(&work_done_);
+  pthread_cond_destroy(&work_available_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+void DegreeFlowBatchSolver::Solve(const vector<DegreeFlowJob>& jobs,
+                                  void (*output_function)(const char*),
+                                  vector<DegreeFlowJobResult>* results) {
+  results->resize(jobs.size());
+  if (jobs.empty()) {
+    return;
+  }
+
+  // Deal the jobs round-robin in order of decreasing size so that every
+  // worker starts with a large job and the small jobs fill the gaps at the
+  // end of the batch.
+  vector<pair<double, size_t> > order(jobs.size());
+  for (size_t ii = 0; ii < jobs.size(); ++ii) {
+    order[ii] = make_pair(-EstimatedJobSize(jobs[ii]), ii);
+  }
+  sort(order.begin(), order.end());
+  for (size_t ii = 0; ii < workers_.size(); ++ii) {
+    workers_[ii]->jobs.clear();
+  }
+  for (size_t ii = 0; ii < order.size(); ++ii) {
+    workers_[ii % workers_.size()]->jobs.push_back(order[ii].second);
+  }
+
+  pthread_mutex_lock(&mutex_);
+  jobs_ = &jobs;
+  results_ = results;
+  output_function_ = output_function;
+  batch_start_time_ = WallTime();
+  if (!workers_[0]->started) {
+    pthread_mutex_unlock(&mutex_);
+    size_t job_index;
+    while (NextJob(workers_[0], &job_index)) {
+      RunJob(workers_[0], job_index);
+    }
+    pthread_mutex_lock(&mutex_);
+  }
+  num_busy_workers_ = workers_[0]->started
+                      ? static_cast<int>(workers_.size()) : 0;
+  generation_ += 1;
+  pthread_cond_broadcast(&work_available_);
+  while (num_busy_workers_ > 0) {
+    pthread_cond_wait(&work_done_, &mutex_);
+  }
+  jobs_ = NULL;
+  results_ = NULL;
+  output_function_ = NULL;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void* DegreeFlowBatchSolver::WorkerMain(void* arg) {
+  Worker* worker = static_cast<Worker*>(arg);
+  worker->pool->RunWorker(worker);
+  return NULL;
+}
+
+void DegreeFlowBatchSolver::RunWorker(Worker* worker) {
+  long long last_generation = 0;
+  while (true) {
+    pthread_mutex_lock(&mutex_);
+    while (!shutting_down_ && generation_ == last_generation) {
+      pthread_cond_wait(&work_available_, &mutex_);
+    }
+    if (shutting_down_) {
+      pthread_mutex_unlock(&mutex_);
+      return;
+    }
+    last_generation = generation_;
+    pthread_mutex_unlock(&mutex_);
+
+    size_t job_index;
+    while (NextJob(worker, &job_index)) {
+      RunJob(worker, job_index);
+    }
+
+    pthread_mutex_lock(&mutex_);
+    num_busy_workers_ -= 1;
+    if (num_busy_workers_ == 0) {
+      pthread_cond_signal(&work_done_);
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+}
+
+bool DegreeFlowBatchSolver::NextJob(Worker* worker, size_t* job_index) {
+  pthread_mutex_lock(&(worker->jobs_mutex));
+  if (!worker->jobs.empty()) {
+    *job_index = worker->jobs.front();
+    worker->jobs.pop_front();
+    pthread_mutex_unlock(&(worker->jobs_mutex));
+    return true;
+  }
+  pthread_mutex_unlock(&(worker->jobs_mutex));
+
+  // Own queue is empty: steal from the other workers. No jobs are added
+  // during a batch, so the batch is finished once all queues are empty.
+  for (size_t ii = 1; ii < workers_.size(); ++ii) {
+    Worker* victim = workers_[(worker->id + ii) % workers_.size()];
+    pthread_mutex_lock(&(victim->jobs_mutex));
+    if (!victim->jobs.empty()) {
+      *job_index = victim->jobs.back();
+      victim->jobs.pop_back();
+      pthread_mutex_unlock(&(victim->jobs_mutex));
+      return true;
+    }
+    pthread_mutex_unlock(&(victim->jobs_mutex));
+  }
+  return false;
+}
+
+void DegreeFlowBatchSolver::RunJob(Worker* worker, size_t job_index) {
+  const DegreeFlowJob& job = (*jobs_)[job_index];
+  DegreeFlowJobResult& result = (*results_)[job_index];
+
+  double job_start_time = WallTime();
+  worker->solver.Solve(*job.x, job.k, *job.row_degrees, *job.col_degrees,
+                       false, output_function_, &result.support);
+  result.solve_time = WallTime() - job_start_time;
+  result.start_time = job_start_time - batch_start_time_;
+  result.worker = worker->id;
+}
+
+void degree_flow_batch(const vector<DegreeFlowJob>& jobs,
+                       int num_threads,
+                       void (*output_function)(const char*),
+                       vector<DegreeFlowJobResult>* results) {
+  DegreeFlowBatchSolver solver(num_threads);
+  solver.Solve(jobs, output_function, results);
+}
@@ -0,0 +1,119 @@
+#ifndef __DEGREE_FLOW_BATCH_H__
+#define __DEGREE_FLOW_BATCH_H__
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include <pthread.h>
+
+#include "degree_flow.h"
+
+// A single projection in a batch. The job only points to its inputs, which
+// must stay alive until the batch has been solved.
+struct DegreeFlowJob {
+  // signal coefficients (will not be squared)
+  const std::vector<std::vector<double> >* x;
+  // Total sparsity
+  int k;
+  // Row degrees
+  const std::vector<int>* row_degrees;
+  // Column degrees
+  const std::vector<int>* col_degrees;
+
+  DegreeFlowJob() : x(NULL), k(0), row_degrees(NULL), col_degrees(NULL) { }
+  DegreeFlowJob(const std::vector<std::vector<double> >* _x, int _k,
+                const std::vector<int>* _row_degrees,
+                const std::vector<int>* _col_degrees)
+    : x(_x), k(_k), row_degrees(_row_degrees), col_degrees(_col_degrees) { }
+};
+
+struct DegreeFlowJobResult {
+  // a bool matrix indicating support
+  std::vector<std::vector<bool> > support;
+  // Wall-clock time between the start of the batch and the start of the job
+  // (in seconds)
+  double start_time;
+  // Wall-clock time spent solving the job (in seconds)
+  double solve_time;
+  // Index of the worker thread that solved the job
+  int worker;
+
+  DegreeFlowJobResult() : start_time(0.0), solve_time(0.0), worker(-1) { }
+};
+
+// Solves batches of independent projections on a pool of worker threads.
+//
+// The threads and their DegreeFlowSolvers persist between calls to Solve, so
+// the per-thread buffers stay warm across batches. Each worker has its own
+// job queue, which is seeded with the largest jobs first. An idle worker
+// steals from the other queues, so a long job does not leave the other
+// threads without work.
+//
+// Solve must not be called concurrently on the same object. The output
+// function is called from the worker threads and must be thread-safe.
+class DegreeFlowBatchSolver {
+ public:
+  explicit DegreeFlowBatchSolver(int num_threads);
+  ~DegreeFlowBatchSolver();
+
+  // Results are returned in the order of the jobs.
+  void Solve(const std::vector<DegreeFlowJob>& jobs,
+             void (*output_function)(const char*),
+             std::vector<DegreeFlowJobResult>* results);
+
+  // Smaller than requested if some threads could not be started
+  int num_threads() const {
+    return static_cast<int>(workers_.size());
+  }
+
+ private:
+  struct Worker {
+    DegreeFlowBatchSolver* pool;
+    int id;
+    pthread_t thread;
+    // Unset for the single worker of a pool whose threads all failed to
+    // start. Its jobs run on the thread that calls Solve.
+    bool started;
+    // Protects jobs.
+    pthread_mutex_t jobs_mutex;
+    // Indices of jobs, largest first. The owner takes jobs from the front,
+    // other workers steal from the back.
+    std::deque<size_t> jobs;
+    DegreeFlowSolver solver;
+  };
+
+  static void* WorkerMain(void* arg);
+  void RunWorker(Worker* worker);
+  bool NextJob(Worker* worker, size_t* job_index);
+  void RunJob(Worker* worker, size_t job_index);
+
+  std::vector<Worker*> workers_;
+
+  // Protects the fields below.
+  pthread_mutex_t mutex_;
+  pthread_cond_t work_available_;
+  pthread_cond_t work_done_;
+  // Incremented for every batch so that workers can detect new work.
+  long long generation_;
+  int num_busy_workers_;
+  bool shutting_down_;
+
+  // The current batch
+  const std::vector<DegreeFlowJob>* jobs_;
+  std::vector<DegreeFlowJobResult>* results_;
+  void (*output_function_)(const char*);
+  double batch_start_time_;
+
+  DegreeFlowBatchSolver(const DegreeFlowBatchSolver&);
+  DegreeFlowBatchSolver& operator=(const DegreeFlowBatchSolver&);
+};
+
+// Convenience wrapper that solves a batch on a temporary pool of num_threads
+// worker threads.
+void degree_flow_batch(const std::vector<DegreeFlowJob>& jobs,
+                       int num_threads,
+                       void (*output_function)(const char*),
+                       std::vector<DegreeFlowJobResult>* results);
+
+#endif
@@ -0,0 +1,102 @@
+#include "degree_flow_batch.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+void WriteToStderr(const char* s) {
+  fprintf(stderr, "%s", s);
+  fflush(stderr);
+}
+
+void RandomMatrix(int r, int c, unsigned int seed,
+                  vector<vector<double> >* x) {
+  srand(seed);
+  x->resize(r);
+  for (int ii = 0; ii < r; ++ii) {
+    (*x)[ii].resize(c);
+    for (int jj = 0; jj < c; ++jj) {
+      (*x)[ii][jj] = static_cast<double>(rand()) / RAND_MAX;
+    }
+  }
+}
+
+class DegreeFlowBatchTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    // Jobs of very different sizes.
+    const int sizes[] = {40, 3, 25, 1, 12, 60, 7, 5, 30, 2};
+    const int num_jobs = sizeof(sizes) / sizeof(sizes[0]);
+    x.resize(num_jobs);
+    row_degrees.resize(num_jobs);
+    col_degrees.resize(num_jobs);
+    for (int ii = 0; ii < num_jobs; ++ii) {
+      int r = sizes[ii];
+      int c = sizes[(ii + 3) % num_jobs];
+      RandomMatrix(r, c, ii + 1, &x[ii]);
+      row_degrees[ii].assign(r, 2);
+      col_degrees[ii].assign(c, 3);
+      jobs.push_back(DegreeFlowJob(&x[ii], min(r, c), &row_degrees[ii],
+                                   &col_degrees[ii]));
+    }
+  }
+
+  void CheckResults(const vector<DegreeFlowJobResult>& results) {
+    ASSERT_EQ(jobs.size(), results.size());
+    for (size_t ii = 0; ii < jobs.size(); ++ii) {
+      vector<vector<bool> > expected_result;
+      degree_flow(*jobs[ii].x, jobs[ii].k, *jobs[ii].row_degrees,
+                  *jobs[ii].col_degrees, false, WriteToStderr,
+                  &expected_result);
+      EXPECT_EQ(expected_result, results[ii].support) << "job " << ii;
+      EXPECT_GE(results[ii].solve_time, 0.0);
+      EXPECT_GE(results[ii].start_time, 0.0);
+      EXPECT_GE(results[ii].worker, 0);
+    }
+  }
+
+  vector<vector<vector<double> > > x;
+  vector<vector<int> > row_degrees;
+  vector<vector<int> > col_degrees;
+  vector<DegreeFlowJob> jobs;
+};
+
+TEST_F(DegreeFlowBatchTest, SingleThread) {
+  vector<DegreeFlowJobResult> results;
+  degree_flow_batch(jobs, 1, WriteToStderr, &results);
+  CheckResults(results);
+}
+
+TEST_F(DegreeFlowBatchTest, MultipleThreads) {
+  vector<DegreeFlowJobResult> results;
+  degree_flow_batch(jobs, 4, WriteToStderr, &results);
+  CheckResults(results);
+}
+
+TEST_F(DegreeFlowBatchTest, MoreThreadsThanJobs) {
+  vector<DegreeFlowJobResult> results;
+  degree_flow_batch(jobs, 16, WriteToStderr, &results);
+  CheckResults(results);
+}
+
+TEST_F(DegreeFlowBatchTest, ReusedPool) {
+  DegreeFlowBatchSolver solver(3);
+  EXPECT_EQ(3, solver.num_threads());
+  vector<DegreeFlowJobResult> results;
+  for (int ii = 0; ii < 3; ++ii) {
+    solver.Solve(jobs, WriteToStderr, &results);
+    CheckResults(results);
+  }
+  vector<DegreeFlowJob> no_jobs;
+  solver.Solve(no_jobs, WriteToStderr, &results);
+  EXPECT_TRUE(results.empty());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,406 @@
+// Benchmark suite for the solver engines on synthetic workloads.
+//
+// Every (workload, size, k, engine) combination runs in its own child
+// process, so the reported peak resident set size belongs to that run only.
+// The output is one tab-separated line per run.
+//
+// Usage: degree_flow_benchmark [options] (see --help)
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+#include "degree_flow.h"
+#include "degree_flow_time.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+namespace {
+
+enum Distribution {
+  // Standard normal amplitudes
+  kGaussian,
+  // Pareto amplitudes with tail index 1.5 and random signs, so a few
+  // entries dominate the objective
+  kHeavyTailed,
+};
+
+struct Workload {
+  const char* name;
+  Distribution distribution;
+  // Fraction of the entries that are nonzero
+  double density;
+  // Number of rows and columns relative to the size of the workload
+  double row_factor;
+  double col_factor;
+  // Row and column degrees: degree_factor * size, but at least min_degree
+  double degree_factor;
+  int min_degree;
+  // Fraction of the rows and of the columns that are not masked out. Masked
+  // rows and columns have degree 0 and amplitudes 0.
+  double active_fraction;
+};
+
+const Workload kWorkloads[] = {
+  {"gaussian", kGaussian, 1.0, 1.0, 1.0, 0.0, 2, 1.0},
+  {"heavy_tailed", kHeavyTailed, 1.0, 1.0, 1.0, 0.0, 2, 1.0},
+  {"sparse", kGaussian, 0.02, 1.0, 1.0, 0.0, 2, 1.0},
+  {"rectangular", kGaussian, 1.0, 0.02, 10.0, 0.0, 2, 1.0},
+  {"tight_degree", kGaussian, 1.0, 1.0, 1.0, 0.0, 1, 1.0},
+  {"loose_degree", kGaussian, 1.0, 1.0, 1.0, 0.25, 2, 1.0},
+  {"masked", kGaussian, 1.0, 1.0, 1.0, 0.0, 2, 0.4},
+};
+
+const int kSizes[] = {10, 100, 1000, 5000};
+
+// k as a fraction of the largest feasible support
+const double kSparsityFractions[] = {0.01, 0.1, 1.0};
+
+enum EngineConfiguration {
+  kGraph,
+  kDense,
+  // Graph engine on the CSR matrix of the nonzero entries (only for
+  // workloads with zeros)
+  kSparseInput,
+  // Candidate pruning with 4 candidates per unit of degree
+  kPruning,
+  // Assignment engine (only for workloads with degree 1)
+  kAssignment,
+  kCostScaling,
+  // The engine chosen by the automatic selection
+  kAutomatic,
+  // The same with compaction (only for workloads with masked rows and
+  // columns)
+  kCompacted,
+};
+
+const char* const kEngineNames[] = {"graph", "dense", "sparse_input",
+                                    "pruning", "assignment", "cost_scaling",
+                                    "automatic", "compacted"};
+const int kNumEngines = 8;
+
+// Small, portable generator (xorshift64*), so the workloads are the same on
+// every platform.
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed * 2685821657736338717ULL + 1) {
+  }
+
+  // Uniform in (0, 1)
+  double Uniform() {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    uint64_t value = state_ * 2685821657736338717ULL;
+    return (static_cast<double>(value >> 11) + 0.5) / 9007199254740992.0;
+  }
+
+  double Gaussian() {
+    return sqrt(-2.0 * log(Uniform())) * cos(6.283185307179586 * Uniform());
+  }
+
+ private:
+  uint64_t state_;
+};
+
+struct Problem {
+  vector<vector<double> > x;
+  DegreeFlowSparseMatrix sparse_x;
+  vector<int> row_degrees;
+  vector<int> col_degrees;
+  int max_support;
+};
+
+void WriteToStderr(const char* s) {
+  fprintf(stderr, "%s", s);
+  fflush(stderr);
+}
+
+// The active rows (or columns) are spread evenly, the first one is always
+// active.
+bool IsActive(int index, double active_fraction) {
+  return floor((index + 1) * active_fraction) > floor(index * active_fraction)
+         || index == 0;
+}
+
+int NumActive(int n, double active_fraction) {
+  int num_active = 0;
+  for (int index = 0; index < n; ++index) {
+    if (IsActive(index, active_fraction)) {
+      num_active += 1;
+    }
+  }
+  return num_active;
+}
+
+void GetDimensions(const Workload& workload, int size, int* r, int* c,
+                   int* degree, int* max_support) {
+  *r = max(1, static_cast<int>(workload.row_factor * size + 0.5));
+  *c = max(1, static_cast<int>(workload.col_factor * size + 0.5));
+  *degree = max(workload.min_degree,
+                static_cast<int>(workload.degree_factor * size));
+  int active_r = NumActive(*r, workload.active_fraction);
+  int active_c = NumActive(*c, workload.active_fraction);
+  long long row_total = static_cast<long long>(active_r)
+                        * min(*degree, active_c);
+  long long col_total = static_cast<long long>(active_c)
+                        * min(*degree, active_r);
+  *max_support = static_cast<int>(min(row_total, col_total));
+}
+
+// The CSR matrix is only built if sparse_input is set, so it does not count
+// towards the peak memory of the other engines.
+void GenerateProblem(const Workload& workload, int size, uint64_t seed,
+                     bool sparse_input, Problem* problem) {
+  int r, c, degree;
+  GetDimensions(workload, size, &r, &c, &degree, &problem->max_support);
+  Random random(seed);
+  problem->x.assign(r, vector<double>(c, 0.0));
+  for (int row = 0; row < r; ++row) {
+    for (int col = 0; col < c; ++col) {
+      if (workload.density < 1.0 && random.Uniform() >= workload.density) {
+        continue;
+      }
+      if (!IsActive(row, workload.active_fraction)
+          || !IsActive(col, workload.active_fraction)) {
+        continue;
+      }
+      if (workload.distribution == kGaussian) {
+        problem->x[row][col] = random.Gaussian();
+      } else {
+        double sign = (random.Uniform() < 0.5 ? -1.0 : 1.0);
+        problem->x[row][col] = sign * pow(random.Uniform(), -1.0 / 1.5);
+      }
+    }
+  }
+
+  if (sparse_input) {
+    vector<uint32_t> rows;
+    vector<uint32_t> cols;
+    vector<double> values;
+    for (int row = 0; row < r; ++row) {
+      for (int col = 0; col < c; ++col) {
+        if (problem->x[row][col] != 0.0) {
+          rows.push_back(row);
+          cols.push_back(col);
+          values.push_back(problem->x[row][col]);
+        }
+      }
+    }
+    problem->sparse_x.AssignTriplets(r, c, rows, cols, values);
+  }
+  problem->row_degrees.assign(r, degree);
+  for (int row = 0; row < r; ++row) {
+    if (!IsActive(row, workload.active_fraction)) {
+      problem->row_degrees[row] = 0;
+    }
+  }
+  problem->col_degrees.assign(c, degree);
+  for (int col = 0; col < c; ++col) {
+    if (!IsActive(col, workload.active_fraction)) {
+      problem->col_degrees[col] = 0;
+    }
+  }
+}
+
+// Runs one configuration and prints its line. Called in a child process.
+void RunBenchmark(const Workload& workload, int size, double k_fraction,
+                  EngineConfiguration engine, int num_repetitions,
+                  uint64_t seed) {
+  Problem problem;
+  GenerateProblem(workload, size, seed, engine == kSparseInput, &problem);
+  int k = max(1, static_cast<int>(k_fraction * problem.max_support + 0.5));
+  // The first row and column are always active.
+  int max_degree = max(problem.row_degrees[0], problem.col_degrees[0]);
+
+  DegreeFlowOptions options;
+  if (engine == kDense) {
+    options.engine = DegreeFlowOptions::kDenseEngine;
+  } else if (engine == kAssignment) {
+    options.engine = DegreeFlowOptions::kAssignmentEngine;
+  } else if (engine == kCostScaling) {
+    options.engine = DegreeFlowOptions::kCostScalingEngine;
+  } else if (engine == kAutomatic || engine == kCompacted) {
+    options.engine = DegreeFlowOptions::kAutomaticEngine;
+    options.compaction = (engine == kCompacted);
+  } else {
+    options.engine = DegreeFlowOptions::kGraphEngine;
+  }
+  if (engine == kPruning) {
+    options.pruning_candidates = 4 * max_degree;
+  }
+
+  DegreeFlowSolver solver;
+  vector<vector<bool> > result;
+  vector<bool> sparse_result;
+  DegreeFlowPhaseTimes best_phase_times;
+  double best_time = 0.0;
+  for (int rep = 0; rep < num_repetitions; ++rep) {
+    double start_time = WallTime();
+    if (engine == kSparseInput) {
+      solver.Solve(problem.sparse_x, k, problem.row_degrees,
+                   problem.col_degrees, options, false, WriteToStderr,
+                   &sparse_result);
+    } else {
+      solver.Solve(problem.x, k, problem.row_degrees, problem.col_degrees,
+                   options, false, WriteToStderr, &result);
+    }
+    double time = WallTime() - start_time;
+    if (rep == 0 || time < best_time) {
+      best_time = time;
+      best_phase_times = solver.stats().phase_times;
+    }
+  }
+
+  int support_size = 0;
+  double objective = 0.0;
+  if (engine == kSparseInput) {
+    for (size_t entry = 0; entry < sparse_result.size(); ++entry) {
+      if (sparse_result[entry]) {
+        support_size += 1;
+        objective += abs(problem.sparse_x.value[entry]);
+      }
+    }
+  } else {
+    for (size_t row = 0; row < result.size(); ++row) {
+      for (size_t col = 0; col < result[row].size(); ++col) {
+        if (result[row][col]) {
+          support_size += 1;
+          objective += abs(problem.x[row][col]);
+        }
+      }
+    }
+  }
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double num_entries = static_cast<double>(problem.x.size())
+                       * problem.x[0].size();
+  // ru_maxrss is in kilobytes on Linux.
+  printf("%s\t%zu\t%zu\t%d\t%s\t%s\t%llu\t%.6f\t%.6f\t%.6f\t%.6f\t%.4g\t"
+         "%.4g\t%d\t%.10g\t%ld\n", workload.name, problem.x.size(),
+         problem.x[0].size(), k, kEngineNames[engine],
+         DegreeFlowOptions::EngineName(solver.stats().engine),
+         static_cast<unsigned long long>(seed), best_phase_times.graph_build,
+         best_phase_times.initial_potentials, best_phase_times.augmentation,
+         best_time, num_entries / best_time,
+         best_phase_times.augmentation > 0.0
+             ? support_size / best_phase_times.augmentation : 0.0,
+         support_size, objective, usage.ru_maxrss);
+  fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  po::options_description desc("Runs the solver engines on synthetic "
+                               "workloads and prints one tab-separated line "
+                               "per run.\nOptions");
+  desc.add_options()
+      ("help", "print this help message")
+      ("workload", po::value<string>(), "only run the given workload")
+      ("engine", po::value<string>(), "only run the given engine (graph, "
+                                      "dense, sparse_input, pruning, "
+                                      "assignment, cost_scaling, "
+                                      "automatic or compacted)")
+      ("min-size", po::value<int>()->default_value(10),
+       "smallest workload size")
+      ("max-size", po::value<int>()->default_value(1000),
+       "largest workload size (at most 5000)")
+      ("max-work", po::value<double>()->default_value(1e10),
+       "skip runs where k times the number of entries exceeds this value")
+      ("repetitions", po::value<int>()->default_value(1),
+       "repetitions per run (the fastest one is reported)")
+      ("seed", po::value<int>()->default_value(1), "workload seed");
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch (const po::error& e) {
+    cerr << e.what() << endl << desc << endl;
+    return 1;
+  }
+  if (vm.count("help")) {
+    cout << desc << endl;
+    return 0;
+  }
+  int min_size = vm["min-size"].as<int>();
+  int max_size = vm["max-size"].as<int>();
+  double max_work = vm["max-work"].as<double>();
+  int num_repetitions = max(vm["repetitions"].as<int>(), 1);
+  uint64_t seed = vm["seed"].as<int>();
+
+  printf("workload\tr\tc\tk\tengine\tengine_used\tseed\tgraph_build_s\t"
+         "initial_potentials_s\taugmentation_s\ttotal_s\tentries_per_s\t"
+         "augmentations_per_s\tsupport_size\tobjective\tpeak_rss_kb\n");
+  fflush(stdout);
+  for (size_t ii = 0; ii < sizeof(kWorkloads) / sizeof(kWorkloads[0]); ++ii) {
+    const Workload& workload = kWorkloads[ii];
+    if (vm.count("workload") && vm["workload"].as<string>() != workload.name) {
+      continue;
+    }
+    for (size_t jj = 0; jj < sizeof(kSizes) / sizeof(kSizes[0]); ++jj) {
+      int size = kSizes[jj];
+      if (size < min_size || size > max_size) {
+        continue;
+      }
+      int r, c, degree, max_support;
+      GetDimensions(workload, size, &r, &c, &degree, &max_support);
+      double num_entries = static_cast<double>(r) * c;
+      int previous_k = 0;
+      for (size_t kk = 0;
+           kk < sizeof(kSparsityFractions) / sizeof(kSparsityFractions[0]);
+           ++kk) {
+        int k = max(1, static_cast<int>(kSparsityFractions[kk] * max_support
+                                        + 0.5));
+        // Small workloads give the same k for several fractions.
+        if (k == previous_k) {
+          continue;
+        }
+        previous_k = k;
+        if (k * num_entries > max_work) {
+          fprintf(stderr, "Skipping %s with size %d and k = %d (increase "
+                  "--max-work to run it).\n", workload.name, size, k);
+          continue;
+        }
+        for (int engine = 0; engine < kNumEngines; ++engine) {
+          if (vm.count("engine")
+              && vm["engine"].as<string>() != kEngineNames[engine]) {
+            continue;
+          }
+          if (engine == kSparseInput && workload.density >= 1.0) {
+            continue;
+          }
+          if (engine == kAssignment && degree > 1) {
+            continue;
+          }
+          if (engine == kCompacted && workload.active_fraction >= 1.0) {
+            continue;
+          }
+          pid_t pid = fork();
+          if (pid == 0) {
+            RunBenchmark(workload, size, kSparsityFractions[kk],
+                         static_cast<EngineConfiguration>(engine),
+                         num_repetitions, seed);
+            _exit(0);
+          }
+          int status;
+          waitpid(pid, &status, 0);
+        }
+      }
+    }
+  }
+  return 0;
+}
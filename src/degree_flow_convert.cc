@@ -0,0 +1,68 @@
+// Converts a problem in the text format of the degree_flow program (read
+// from stdin) to a binary problem file.
+//
+// Usage: degree_flow_convert [--float32] [--column-major] output_file
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "degree_flow_io.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+int main(int argc, char** argv) {
+  po::options_description desc("Reads a problem in text format from stdin "
+                               "and writes it as a binary problem file.\n"
+                               "Options");
+  desc.add_options()
+      ("help", "print this help message")
+      ("output", po::value<string>(), "the binary problem file")
+      ("float32", "store the amplitudes as float32 instead of float64")
+      ("column-major", "store the amplitudes in column-major order");
+  po::positional_options_description positional;
+  positional.add("output", 1);
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc)
+                  .positional(positional).run(), vm);
+    po::notify(vm);
+  } catch (const po::error& e) {
+    cerr << e.what() << endl << desc << endl;
+    return 1;
+  }
+  if (vm.count("help") || !vm.count("output")) {
+    cout << desc << endl;
+    return vm.count("help") ? 0 : 1;
+  }
+
+  vector<vector<double> > x;
+  int k;
+  vector<int> row_degrees;
+  vector<int> col_degrees;
+  if (!ReadDegreeFlowTextProblem(stdin, &x, &k, &row_degrees, &col_degrees)) {
+    cerr << "Could not read the problem from stdin." << endl;
+    return 1;
+  }
+
+  DegreeFlowDataType data_type = kDegreeFlowFloat64;
+  if (vm.count("float32")) {
+    data_type = kDegreeFlowFloat32;
+  }
+  DegreeFlowLayout layout = kDegreeFlowRowMajor;
+  if (vm.count("column-major")) {
+    layout = kDegreeFlowColumnMajor;
+  }
+  string error;
+  if (!WriteDegreeFlowProblemFile(vm["output"].as<string>().c_str(), x, k,
+                                  row_degrees, col_degrees, data_type, layout,
+                                  &error)) {
+    cerr << error << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,225 @@
+// Cost scaling engine of DegreeFlowSolver.
+//
+// Successive shortest paths need one shortest path computation per entry of
+// the support, which dominates for large k. This engine instead computes the
+// min-cost flow with the cost scaling push-relabel method of Goldberg and
+// Tarjan on the materialized graph of the graph engine:
+//
+// 1. A maximum flow of value at most k (Dinic's algorithm, i.e., the
+//    blocking flow of the graph engine with every residual arc admissible)
+//    fixes the size of the support.
+// 2. The costs are rounded to integers and multiplied by num_nodes_ + 1, so
+//    that an epsilon-optimal flow with epsilon = 1 is optimal for the
+//    rounded costs. Starting with epsilon = the largest cost, every refine
+//    step divides epsilon by kCostScalingFactor and turns the flow into an
+//    epsilon-optimal flow of the same value by saturating all residual arcs
+//    with negative reduced cost and pushing the excesses back with FIFO
+//    push-relabel.
+//
+// The reduced cost of an arc is cost + price_[from] - price_[to], as with the
+// potentials of the other engines, and an arc is admissible if its reduced
+// cost is negative. The costs are rounded to multiples of max |x| / R so
+// that all prices stay far below the int64_t range, where
+// R = min(2^52, 2^60 / n^2) with n = num_nodes_ + 1 (see
+// CostScalingMaxRoundedCost). Every amplitude changes by at most
+// max |x| / (2 R), a relative error of 2^-53 for tiny graphs but of about
+// n^2 / 2^61 for larger ones (e.g., 1e-7 for 10^4 rows and columns). The
+// support is optimal for the rounded costs, so on inputs with near-ties at
+// that precision it can differ from the other engines, and its objective
+// is at most s max |x| / R below the optimum for a support with s entries
+// (DegreeFlowStats::rounding_loss_bound). The automatic engine selection
+// only picks this engine if max |x| / (2 R) is below the tie tolerance
+// kAdmissibleTolerance.
+//
+// Every refine step keeps the flow, so the solver can stop between two
+// steps with a support of the same size that is not optimal yet. The
+// augmentation budget limits the value of the maximum flow instead, which
+// gives an optimal support with fewer entries.
+
+#include "degree_flow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+const int DegreeFlowSolver::kCostScalingFactor;
+
+// Returns the size of the support.
+int DegreeFlowSolver::SolveCostScaling(int k,
+                                       const DegreeFlowOptions& options) {
+  int max_flow = AugmentationBudget(k, options);
+  int flow = ComputeMaxFlow(max_flow);
+  stats_.num_augmentations += flow;
+  if (flow == max_flow && max_flow < k) {
+    stats_.termination = DegreeFlowStats::kAugmentationLimit;
+  }
+
+  double n = static_cast<double>(num_nodes_ + 1);
+  double max_rounded_cost = CostScalingMaxRoundedCost(num_nodes_);
+  double max_abs_cost = 0.0;
+  for (size_t arc = 0; arc < arc_cost_.size(); ++arc) {
+    max_abs_cost = max(max_abs_cost, abs(arc_cost_[arc]));
+  }
+  scaled_cost_.resize(arc_cost_.size());
+  cost_scaling_unit_ = 0.0;
+  if (max_abs_cost > 0.0) {
+    cost_scaling_unit_ = max_abs_cost / max_rounded_cost / n;
+  }
+  int64_t epsilon = 0;
+  for (size_t arc = 0; arc < arc_cost_.size(); ++arc) {
+    int64_t cost = 0;
+    if (max_abs_cost > 0.0) {
+      cost = static_cast<int64_t>(floor(arc_cost_[arc] / max_abs_cost
+                                        * max_rounded_cost + 0.5));
+    }
+    scaled_cost_[arc] = cost * static_cast<int64_t>(num_nodes_ + 1);
+    epsilon = max(epsilon, scaled_cost_[arc] < 0 ? -scaled_cost_[arc]
+                                                 : scaled_cost_[arc]);
+  }
+
+  // With prices 0, every flow is epsilon-optimal for the largest cost.
+  price_.assign(num_nodes_, 0);
+  excess_.assign(num_nodes_, 0);
+  active_nodes_.resize(num_nodes_);
+  while (epsilon > 1 && !StopRequested(options)) {
+    epsilon = max(epsilon / kCostScalingFactor, static_cast<int64_t>(1));
+    RefineCostScaling(epsilon);
+    stats_.num_scaling_phases += 1;
+  }
+
+  // Both the returned support and an optimal support have flow entries,
+  // whose costs are each off by at most max_abs_cost / max_rounded_cost / 2.
+  stats_.rounding_loss_bound = flow * max_abs_cost / max_rounded_cost;
+
+  // The support changed in the pushes, which do not keep support_entries_
+  // up to date.
+  ResetSupportEntries();
+  for (size_t entry = 0; entry < num_entries_; ++entry) {
+    if (edge_capacity_[EntryEdgeIndex(entry)] == 0) {
+      RecordSupportChange(entry, true);
+    }
+  }
+  return flow;
+}
+
+// Prices decrease by at most about 3 * num_nodes * epsilon per refine step,
+// so with n = num_nodes + 1 and largest rounded cost C, all prices stay below
+// 4 * n * n * C (see Goldberg and Tarjan). The largest rounded cost keeps
+// this (and the difference of two prices) below 2^62.
+double DegreeFlowSolver::CostScalingMaxRoundedCost(size_t num_nodes) {
+  double n = static_cast<double>(num_nodes + 1);
+  return min(4503599627370496.0,  // 2^52
+             floor(1152921504606846976.0 / (n * n)));
+}
+
+// Augments along shortest paths in the residual graph (ignoring the costs)
+// until the flow has value max_flow or is a maximum flow. Returns its value.
+int DegreeFlowSolver::ComputeMaxFlow(int max_flow) {
+  potential_.assign(num_nodes_, 0.0);
+  parent_.resize(num_nodes_);
+  edge_taken_to_.resize(num_nodes_);
+  admissible_tolerance_ = numeric_limits<double>::infinity();
+  max_flow_bound_ = MaxFlowBound(row_degree_, col_degree_);
+  if (max_flow_bound_ < max_flow) {
+    max_flow = static_cast<int>(max_flow_bound_);
+  }
+  return AugmentBlockingFlow(max_flow);
+}
+
+void DegreeFlowSolver::RefineCostScaling(int64_t epsilon) {
+  // Saturate the residual arcs with negative reduced cost. The flow becomes
+  // 0-optimal, but the nodes no longer satisfy flow conservation.
+  for (NodeIndex node = 0; node < num_nodes_; ++node) {
+    EdgeIndex arc_end = adjacency_offset_[node + 1];
+    for (EdgeIndex arc = adjacency_offset_[node]; arc < arc_end; ++arc) {
+      Count(&stats_.total_inner_iterations);
+      EdgeIndex edge = arc_edge_[arc];
+      int capacity = edge_capacity_[edge];
+      if (capacity > 0
+          && scaled_cost_[arc] + price_[node] - price_[arc_to_[arc]] < 0) {
+        edge_capacity_[edge] = 0;
+        edge_capacity_[OppositeEdgeIndex(edge)] += capacity;
+        excess_[node] -= capacity;
+        excess_[arc_to_[arc]] += capacity;
+      }
+    }
+  }
+
+  // Every node is in the ring of active nodes at most once: it is added
+  // when its excess becomes positive, and it is removed after it has been
+  // discharged completely.
+  num_active_nodes_ = 0;
+  active_head_ = 0;
+  for (NodeIndex node = 0; node < num_nodes_; ++node) {
+    if (excess_[node] > 0) {
+      ActivateNode(node);
+    }
+  }
+  current_arc_.assign(adjacency_offset_.begin(), adjacency_offset_.end() - 1);
+  while (num_active_nodes_ > 0) {
+    NodeIndex node = active_nodes_[active_head_];
+    active_head_ = (active_head_ + 1) % num_nodes_;
+    num_active_nodes_ -= 1;
+    Count(&stats_.num_queue_pops);
+    DischargeCostScaling(node, epsilon);
+  }
+}
+
+// Pushes the excess of node along admissible arcs, and relabels the node
+// whenever it has none left.
+void DegreeFlowSolver::DischargeCostScaling(NodeIndex node, int64_t epsilon) {
+  EdgeIndex arc_begin = adjacency_offset_[node];
+  EdgeIndex arc_end = adjacency_offset_[node + 1];
+  EdgeIndex& arc = current_arc_[node];
+  while (excess_[node] > 0) {
+    for (; arc < arc_end; ++arc) {
+      Count(&stats_.checking_inner_iterations);
+      EdgeIndex edge = arc_edge_[arc];
+      NodeIndex next_node = arc_to_[arc];
+      if (edge_capacity_[edge] > 0
+          && scaled_cost_[arc] + price_[node] - price_[next_node] < 0) {
+        Count(&stats_.updating_inner_iterations);
+        int amount = min(excess_[node], edge_capacity_[edge]);
+        edge_capacity_[edge] -= amount;
+        edge_capacity_[OppositeEdgeIndex(edge)] += amount;
+        excess_[node] -= amount;
+        excess_[next_node] += amount;
+        if (excess_[next_node] > 0 && excess_[next_node] <= amount) {
+          ActivateNode(next_node);
+        }
+        if (excess_[node] == 0) {
+          // The arc can still be admissible, so it stays the current arc.
+          return;
+        }
+      }
+    }
+    RelabelCostScaling(node, epsilon);
+    arc = arc_begin;
+  }
+}
+
+// Lowers the price of node until its cheapest residual arc has reduced cost
+// -epsilon. Before the call, no residual arc of node is admissible.
+void DegreeFlowSolver::RelabelCostScaling(NodeIndex node, int64_t epsilon) {
+  stats_.num_relabels += 1;
+  int64_t max_price = numeric_limits<int64_t>::min();
+  EdgeIndex arc_end = adjacency_offset_[node + 1];
+  for (EdgeIndex arc = adjacency_offset_[node]; arc < arc_end; ++arc) {
+    Count(&stats_.total_inner_iterations);
+    if (edge_capacity_[arc_edge_[arc]] > 0) {
+      max_price = max(max_price, price_[arc_to_[arc]] - scaled_cost_[arc]);
+    }
+  }
+  // A node with excess always has a residual arc (the opposite of the arc
+  // the excess arrived on).
+  price_[node] = max_price - epsilon;
+}
+
+void DegreeFlowSolver::ActivateNode(NodeIndex node) {
+  Count(&stats_.num_queue_pushes);
+  active_nodes_[(active_head_ + num_active_nodes_) % num_nodes_] = node;
+  num_active_nodes_ += 1;
+}
@@ -0,0 +1,428 @@
+// Implicit dense engine of DegreeFlowSolver.
+//
+// The engine works on the same flow graph as the graph engine in
+// degree_flow.cc but never materializes the r * c entry edges. The cost of
+// an entry is read from the input matrix, and the capacities of its forward
+// and backward edges are given by one bit in selected_. The arcs leaving a
+// node are enumerated in the same order as in the CSR adjacency of the graph
+// engine, so both engines break ties identically and return the same
+// supports.
+
+#include "degree_flow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+void DegreeFlowSolver::BuildDenseGraph(const DenseSignal& x) {
+  s_ = 0;
+  t_ = 1;
+  num_nodes_ = num_rows_ + num_cols_ + 2;
+
+  x_ = x;
+  row_flow_.assign(num_rows_, 0);
+  col_flow_.assign(num_cols_, 0);
+  selected_.assign((num_rows_ * num_cols_ + 63) / 64, 0);
+  ResetSupportEntries();
+}
+
+void DegreeFlowSolver::ComputeInitialPotentialsDense() {
+  potential_.clear();
+  // Initialize
+  potential_.resize(num_nodes_, numeric_limits<double>::infinity());
+
+  // Source and row nodes have potential 0
+  potential_[s_] = 0.0;
+  for (size_t row = 0; row < num_rows_; ++row) {
+    potential_[RowNodeIndex(row)] = 0.0;
+  }
+
+  // Column nodes
+  for (size_t row = 0; row < num_rows_; ++row) {
+    if (row_degree_[row] <= 0) {
+      continue;
+    }
+    const double* x_row = x_[row];
+    for (size_t col = 0; col < num_cols_; ++col) {
+      NodeIndex col_node = ColNodeIndex(col);
+      potential_[col_node] = min(potential_[col_node], -abs(x_row[col]));
+    }
+  }
+
+  // Sink
+  for (size_t col = 0; col < num_cols_; ++col) {
+    potential_[t_] = min(potential_[t_], potential_[ColNodeIndex(col)]);
+  }
+}
+
+void DegreeFlowSolver::ResetDenseDijkstra() {
+  settled_.assign(num_nodes_, 0.0);
+  dst_.assign(num_nodes_, numeric_limits<double>::infinity());
+  if (parent_.size() != num_nodes_) {
+    parent_.resize(num_nodes_, s_);
+  }
+  dst_[s_] = 0.0;
+}
+
+// Relaxes the arcs from a settled row node to all columns. The candidate
+// distances are computed for several columns at once from the contiguous
+// column parts of dst_, potential_ and settled_ and the row of the input.
+// Only columns whose distance decreases go through RelaxDense, which also
+// skips the columns of selected entries (they have no forward arc).
+void DegreeFlowSolver::RelaxEntryArcsDense(size_t row) {
+  NodeIndex row_node = RowNodeIndex(row);
+  NodeIndex col_node_0 = ColNodeIndex(0);
+  const double* x_row = x_[row];
+  const double* col_dst = &dst_[col_node_0];
+  const double* col_potential = &potential_[col_node_0];
+  const double* col_settled = &settled_[col_node_0];
+  double row_dst = dst_[row_node];
+  double row_potential = potential_[row_node];
+  Count(&stats_.total_inner_iterations, num_cols_);
+
+  size_t col = 0;
+#if defined(__AVX__)
+  const __m256d sign_mask = _mm256_set1_pd(-0.0);
+  const __m256d row_dst4 = _mm256_set1_pd(row_dst);
+  const __m256d row_potential4 = _mm256_set1_pd(row_potential);
+  for (; col + 4 <= num_cols_; col += 4) {
+    // The operations are the same as in RelaxDense so that both compute
+    // bitwise identical distances. -abs(x) is x with the sign bit set.
+    __m256d cost = _mm256_or_pd(_mm256_loadu_pd(x_row + col), sign_mask);
+    __m256d adjusted_edge_cost = _mm256_sub_pd(
+        _mm256_add_pd(cost, row_potential4),
+        _mm256_loadu_pd(col_potential + col));
+    __m256d candidate = _mm256_add_pd(
+        _mm256_add_pd(row_dst4, adjusted_edge_cost),
+        _mm256_loadu_pd(col_settled + col));
+    int improved = _mm256_movemask_pd(_mm256_cmp_pd(
+        candidate, _mm256_loadu_pd(col_dst + col), _CMP_LT_OQ));
+    for (; improved != 0; improved &= improved - 1) {
+      size_t cur_col = col + __builtin_ctz(improved);
+      if (!IsSelected(row, cur_col)) {
+        RelaxDense(row_node, col_node_0 + cur_col, -abs(x_row[cur_col]));
+      }
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128d sign_mask = _mm_set1_pd(-0.0);
+  const __m128d row_dst2 = _mm_set1_pd(row_dst);
+  const __m128d row_potential2 = _mm_set1_pd(row_potential);
+  for (; col + 2 <= num_cols_; col += 2) {
+    // The operations are the same as in RelaxDense so that both compute
+    // bitwise identical distances. -abs(x) is x with the sign bit set.
+    __m128d cost = _mm_or_pd(_mm_loadu_pd(x_row + col), sign_mask);
+    __m128d adjusted_edge_cost = _mm_sub_pd(
+        _mm_add_pd(cost, row_potential2), _mm_loadu_pd(col_potential + col));
+    __m128d candidate = _mm_add_pd(_mm_add_pd(row_dst2, adjusted_edge_cost),
+                                   _mm_loadu_pd(col_settled + col));
+    int improved = _mm_movemask_pd(_mm_cmplt_pd(
+        candidate, _mm_loadu_pd(col_dst + col)));
+    for (; improved != 0; improved &= improved - 1) {
+      size_t cur_col = col + __builtin_ctz(improved);
+      if (!IsSelected(row, cur_col)) {
+        RelaxDense(row_node, col_node_0 + cur_col, -abs(x_row[cur_col]));
+      }
+    }
+  }
+#endif
+  for (; col < num_cols_; ++col) {
+    if (col_settled[col] != 0.0 || IsSelected(row, col)) {
+      continue;
+    }
+    RelaxDense(row_node, col_node_0 + col, -abs(x_row[col]));
+  }
+}
+
+// Returns the unsettled node with the smallest distance and the largest
+// index among those. The minimum is computed first so that the vectorized
+// loop has no branches, and a second scan from the back finds its index.
+DegreeFlowSolver::NodeIndex DegreeFlowSolver::SelectMinDense() const {
+  const double* node_dst = &dst_[0];
+  const double* node_settled = &settled_[0];
+  double min_dst = numeric_limits<double>::infinity();
+  size_t node = 0;
+#if defined(__AVX__)
+  __m256d min_dst4 = _mm256_set1_pd(min_dst);
+  for (; node + 4 <= num_nodes_; node += 4) {
+    min_dst4 = _mm256_min_pd(min_dst4, _mm256_add_pd(
+        _mm256_loadu_pd(node_dst + node), _mm256_loadu_pd(node_settled + node)));
+  }
+  double min_dsts[4];
+  _mm256_storeu_pd(min_dsts, min_dst4);
+  min_dst = min(min(min_dsts[0], min_dsts[1]), min(min_dsts[2], min_dsts[3]));
+#elif defined(__SSE2__)
+  __m128d min_dst2 = _mm_set1_pd(min_dst);
+  for (; node + 2 <= num_nodes_; node += 2) {
+    min_dst2 = _mm_min_pd(min_dst2, _mm_add_pd(
+        _mm_loadu_pd(node_dst + node), _mm_loadu_pd(node_settled + node)));
+  }
+  double min_dsts[2];
+  _mm_storeu_pd(min_dsts, min_dst2);
+  min_dst = min(min_dsts[0], min_dsts[1]);
+#endif
+  for (; node < num_nodes_; ++node) {
+    min_dst = min(min_dst, node_dst[node] + node_settled[node]);
+  }
+
+  for (node = num_nodes_; node > 0; --node) {
+    if (node_dst[node - 1] + node_settled[node - 1] == min_dst) {
+      return node - 1;
+    }
+  }
+  return s_;
+}
+
+// Dijkstra with an array-based minimum selection instead of a heap: every
+// row node is adjacent to every column node, so a heap would hold O(E)
+// entries while a scan over all nodes costs only O(V) per settled node.
+// Ties are broken towards the larger node index, which settles the nodes in
+// the same order as the heap of the graph engine. As in the graph engine,
+// the search stops as soon as t is settled.
+bool DegreeFlowSolver::FindPathDense() {
+  ResetDenseDijkstra();
+
+  size_t num_settled_nodes = 0;
+  while (true) {
+    NodeIndex cur_node = SelectMinDense();
+    if (dst_[cur_node] + settled_[cur_node]
+        == numeric_limits<double>::infinity()) {
+      RecordShortestPathRun(num_settled_nodes);
+      return false;
+    }
+
+    settled_[cur_node] = numeric_limits<double>::infinity();
+    Count(&stats_.num_queue_pops);
+    if (kCountersEnabled) {
+      ++num_settled_nodes;
+    }
+    if (cur_node == t_) {
+      break;
+    }
+
+    if (cur_node == s_) {
+      // source -> rows with remaining degree
+      for (size_t row = 0; row < num_rows_; ++row) {
+        if (row_degree_[row] <= 0) {
+          continue;
+        }
+        Count(&stats_.total_inner_iterations);
+        NodeIndex row_node = RowNodeIndex(row);
+        if (row_flow_[row] < row_degree_[row] && settled_[row_node] == 0.0) {
+          RelaxDense(cur_node, row_node, 0.0);
+        }
+      }
+    } else if (IsRowNode(cur_node)) {
+      // row -> unselected entries, then row -> source
+      size_t row = cur_node - RowNodeIndex(0);
+      RelaxEntryArcsDense(row);
+      Count(&stats_.total_inner_iterations);
+      if (row_flow_[row] > 0 && settled_[s_] == 0.0) {
+        RelaxDense(cur_node, s_, 0.0);
+      }
+    } else {
+      // column -> rows of selected entries, then column -> sink. The number
+      // of selected entries in a column equals the flow on its sink edge.
+      size_t col = cur_node - ColNodeIndex(0);
+      int num_selected_left = col_flow_[col];
+      for (size_t row = 0; row < num_rows_ && num_selected_left > 0; ++row) {
+        Count(&stats_.total_inner_iterations);
+        if (row_degree_[row] <= 0 || !IsSelected(row, col)) {
+          continue;
+        }
+        num_selected_left -= 1;
+        NodeIndex row_node = RowNodeIndex(row);
+        if (settled_[row_node] == 0.0) {
+          RelaxDense(cur_node, row_node, abs(x_[row][col]));
+        }
+      }
+      Count(&stats_.total_inner_iterations);
+      if (col_flow_[col] < col_degree_[col] && settled_[t_] == 0.0) {
+        RelaxDense(cur_node, t_, 0.0);
+      }
+    }
+  }
+
+  RecordShortestPathRun(num_settled_nodes);
+
+  // change potentials
+  UpdatePotentials(dst_[t_]);
+
+  // change capacities
+  AugmentPathDense();
+
+  return true;
+}
+
+// Pushes one unit of flow along the path to t given by parent_.
+void DegreeFlowSolver::AugmentPathDense() {
+  NodeIndex cur_node = t_;
+  do {
+    NodeIndex prev_node = parent_[cur_node];
+    // A shortest path visits s and t only at its ends.
+    if (prev_node == s_) {
+      row_flow_[cur_node - RowNodeIndex(0)] += 1;
+    } else if (cur_node == t_) {
+      col_flow_[prev_node - ColNodeIndex(0)] += 1;
+    } else if (IsRowNode(prev_node)) {
+      // forward entry edge: select the entry
+      size_t row = prev_node - RowNodeIndex(0);
+      size_t col = cur_node - ColNodeIndex(0);
+      FlipSelected(row, col);
+      RecordSupportChange(EntryBitIndex(row, col), true);
+      if (solution_path_ != NULL) {
+        RecordChange(row, col, true);
+      }
+    } else {
+      // backward entry edge: deselect the entry
+      size_t row = cur_node - RowNodeIndex(0);
+      size_t col = prev_node - ColNodeIndex(0);
+      FlipSelected(row, col);
+      RecordSupportChange(EntryBitIndex(row, col), false);
+      if (solution_path_ != NULL) {
+        RecordChange(row, col, false);
+      }
+    }
+    cur_node = prev_node;
+  } while (cur_node != s_);
+
+  if (solution_path_ != NULL) {
+    RecordAugmentation();
+  }
+}
+
+// Number of implicit arcs of a node that can be on a path from s to t in the
+// level graph. Arcs into s and the arcs leaving t are never on such a path.
+DegreeFlowSolver::EdgeIndex DegreeFlowSolver::NumArcsDense(
+    NodeIndex node) const {
+  if (node == s_) {
+    return num_rows_;
+  } else if (node == t_) {
+    return 0;
+  } else if (IsRowNode(node)) {
+    return num_cols_;
+  } else {
+    return num_rows_ + 1;
+  }
+}
+
+// Returns the head of the given implicit arc leaving node if the arc is in
+// the admissible graph, and s otherwise. The arcs are numbered as in the
+// adjacency of the graph engine: the arcs of s and of the column nodes are
+// indexed by row (and the last arc of a column node goes to t), the arcs of
+// the row nodes by column.
+DegreeFlowSolver::NodeIndex DegreeFlowSolver::AdmissibleArcHeadDense(
+    NodeIndex node, EdgeIndex arc) const {
+  if (node == s_) {
+    NodeIndex row_node = RowNodeIndex(arc);
+    if (row_degree_[arc] > 0 && row_flow_[arc] < row_degree_[arc]
+        && IsAdmissibleDense(node, row_node, 0.0)) {
+      return row_node;
+    }
+  } else if (IsRowNode(node)) {
+    size_t row = node - RowNodeIndex(0);
+    NodeIndex col_node = ColNodeIndex(arc);
+    if (!IsSelected(row, arc)
+        && IsAdmissibleDense(node, col_node, -abs(x_[row][arc]))) {
+      return col_node;
+    }
+  } else {
+    size_t col = node - ColNodeIndex(0);
+    if (arc == num_rows_) {
+      if (col_flow_[col] < col_degree_[col]
+          && IsAdmissibleDense(node, t_, 0.0)) {
+        return t_;
+      }
+    } else {
+      NodeIndex row_node = RowNodeIndex(arc);
+      if (row_degree_[arc] > 0 && IsSelected(arc, col)
+          && IsAdmissibleDense(node, row_node, abs(x_[arc][col]))) {
+        return row_node;
+      }
+    }
+  }
+  return s_;
+}
+
+// The blocking flow of the dense engine works like the one of the graph
+// engine in degree_flow.cc, but on the implicit arcs.
+bool DegreeFlowSolver::ComputeAdmissibleLevelsDense() {
+  level_.assign(num_nodes_, -1);
+  bfs_queue_.clear();
+  level_[s_] = 0;
+  bfs_queue_.push_back(s_);
+  for (size_t head = 0; head < bfs_queue_.size(); ++head) {
+    NodeIndex cur_node = bfs_queue_[head];
+    EdgeIndex num_arcs = NumArcsDense(cur_node);
+    for (EdgeIndex arc = 0; arc < num_arcs; ++arc) {
+      Count(&stats_.total_inner_iterations);
+      NodeIndex next_node = AdmissibleArcHeadDense(cur_node, arc);
+      if (next_node != s_ && level_[next_node] < 0) {
+        level_[next_node] = level_[cur_node] + 1;
+        bfs_queue_.push_back(next_node);
+      }
+    }
+  }
+  return level_[t_] >= 0;
+}
+
+bool DegreeFlowSolver::FindAdmissiblePathDense() {
+  NodeIndex cur_node = s_;
+  while (cur_node != t_) {
+    EdgeIndex num_arcs = NumArcsDense(cur_node);
+    EdgeIndex& arc = current_arc_[cur_node];
+    NodeIndex next_node = s_;
+    for (; arc < num_arcs; ++arc) {
+      Count(&stats_.total_inner_iterations);
+      next_node = AdmissibleArcHeadDense(cur_node, arc);
+      if (next_node != s_ && level_[next_node] == level_[cur_node] + 1) {
+        break;
+      }
+    }
+    if (arc < num_arcs) {
+      parent_[next_node] = cur_node;
+      cur_node = next_node;
+    } else {
+      // t is not reachable from cur_node anymore.
+      if (cur_node == s_) {
+        return false;
+      }
+      level_[cur_node] = -1;
+      cur_node = parent_[cur_node];
+      ++current_arc_[cur_node];
+    }
+  }
+  return true;
+}
+
+bool DegreeFlowSolver::HasAdmissibleSinkArcDense() const {
+  for (size_t col = 0; col < num_cols_; ++col) {
+    if (col_flow_[col] < col_degree_[col]
+        && IsAdmissibleDense(ColNodeIndex(col), t_, 0.0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int DegreeFlowSolver::AugmentBlockingFlowDense(int max_paths) {
+  int num_paths = 0;
+  while (num_paths < max_paths && HasAdmissibleSinkArcDense()
+         && ComputeAdmissibleLevelsDense()) {
+    current_arc_.assign(num_nodes_, 0);
+    while (num_paths < max_paths && FindAdmissiblePathDense()) {
+      AugmentPathDense();
+      num_paths += 1;
+    }
+  }
+  return num_paths;
+}
@@ -0,0 +1,538 @@
+#include "degree_flow_io.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "degree_flow.h"
+
+using namespace std;
+
+namespace {
+
+const char kProblemMagic[8] = {'D', 'E', 'G', 'F', 'L', 'O', 'W', 'P'};
+const char kSupportMagic[8] = {'D', 'E', 'G', 'F', 'L', 'O', 'W', 'S'};
+const char kCertificateMagic[8] = {'D', 'E', 'G', 'F', 'L', 'O', 'W', 'C'};
+const uint32_t kProblemVersion = 1;
+
+struct ProblemHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t data_type;
+  uint32_t layout;
+  int32_t k;
+  uint64_t num_rows;
+  uint64_t num_cols;
+};
+
+size_t DataTypeSize(DegreeFlowDataType data_type) {
+  return data_type == kDegreeFlowFloat32 ? sizeof(float) : sizeof(double);
+}
+
+// Offset of the amplitudes from the start of the file
+uint64_t DataOffset(uint64_t num_rows, uint64_t num_cols) {
+  uint64_t offset = sizeof(ProblemHeader)
+                    + sizeof(int32_t) * (num_rows + num_cols);
+  return (offset + 7) / 8 * 8;
+}
+
+template <typename T>
+void ConvertMatrix(const T* data, size_t num_rows, size_t num_cols,
+                   DegreeFlowLayout layout, vector<vector<double> >* x) {
+  x->resize(num_rows);
+  for (size_t row = 0; row < num_rows; ++row) {
+    (*x)[row].resize(num_cols);
+  }
+  if (layout == kDegreeFlowRowMajor) {
+    for (size_t row = 0; row < num_rows; ++row) {
+      const T* data_row = data + row * num_cols;
+      double* x_row = &((*x)[row][0]);
+      for (size_t col = 0; col < num_cols; ++col) {
+        x_row[col] = data_row[col];
+      }
+    }
+  } else {
+    for (size_t col = 0; col < num_cols; ++col) {
+      const T* data_col = data + col * num_rows;
+      for (size_t row = 0; row < num_rows; ++row) {
+        (*x)[row][col] = data_col[row];
+      }
+    }
+  }
+}
+
+template <typename T>
+void AppendValues(const T* values, size_t num_values, vector<char>* buffer) {
+  const char* bytes = reinterpret_cast<const char*>(values);
+  buffer->insert(buffer->end(), bytes, bytes + sizeof(T) * num_values);
+}
+
+template <typename T>
+void AppendMatrix(const vector<vector<double> >& x, DegreeFlowLayout layout,
+                  vector<char>* buffer) {
+  size_t num_rows = x.size();
+  size_t num_cols = x[0].size();
+  size_t old_size = buffer->size();
+  buffer->resize(old_size + sizeof(T) * num_rows * num_cols);
+  T* values = reinterpret_cast<T*>(&((*buffer)[old_size]));
+  if (layout == kDegreeFlowRowMajor) {
+    for (size_t row = 0; row < num_rows; ++row) {
+      for (size_t col = 0; col < num_cols; ++col) {
+        values[row * num_cols + col] = static_cast<T>(x[row][col]);
+      }
+    }
+  } else {
+    for (size_t row = 0; row < num_rows; ++row) {
+      for (size_t col = 0; col < num_cols; ++col) {
+        values[col * num_rows + row] = static_cast<T>(x[row][col]);
+      }
+    }
+  }
+}
+
+bool ReadValues(FILE* input, vector<double>* values) {
+  return values->empty()
+         || fread(&((*values)[0]), sizeof(double), values->size(), input)
+            == values->size();
+}
+
+void AppendDegrees(const vector<int>& degrees, vector<char>* buffer) {
+  vector<int32_t> values(degrees.begin(), degrees.end());
+  if (!values.empty()) {
+    AppendValues(&values[0], values.size(), buffer);
+  }
+}
+
+}  // namespace
+
+DegreeFlowProblemFile::DegreeFlowProblemFile()
+    : mapping_(NULL), mapping_size_(0), num_rows_(0), num_cols_(0), k_(0),
+      data_type_(kDegreeFlowFloat64), layout_(kDegreeFlowRowMajor),
+      row_degrees_(NULL), col_degrees_(NULL), data_(NULL) { }
+
+DegreeFlowProblemFile::~DegreeFlowProblemFile() {
+  Close();
+}
+
+bool DegreeFlowProblemFile::Open(const char* filename, string* error) {
+  Close();
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    *error = string("Could not open ") + filename + ": " + strerror(errno);
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    *error = string("Could not stat ") + filename + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+  size_t file_size = file_stat.st_size;
+  if (file_size < sizeof(ProblemHeader)) {
+    *error = string(filename) + " is too short for a problem file.";
+    close(fd);
+    return false;
+  }
+  void* mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    *error = string("Could not map ") + filename + ": " + strerror(errno);
+    return false;
+  }
+  mapping_ = mapping;
+  mapping_size_ = file_size;
+  // The amplitudes are read once from the beginning to the end.
+  madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+
+  if (!Parse(mapping, file_size, error)) {
+    *error = string(filename) + ": " + *error;
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool DegreeFlowProblemFile::OpenBuffer(const void* data, size_t size,
+                                       string* error) {
+  Close();
+  if (!Parse(data, size, error)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool DegreeFlowProblemFile::Parse(const void* data, size_t size,
+                                  string* error) {
+  if (size < sizeof(ProblemHeader)) {
+    *error = "too short for a problem file.";
+    return false;
+  }
+  const ProblemHeader* header = static_cast<const ProblemHeader*>(data);
+  if (memcmp(header->magic, kProblemMagic, sizeof(kProblemMagic)) != 0
+      || header->version != kProblemVersion) {
+    *error = "not a problem file (or a different version or byte order).";
+    return false;
+  }
+  if (header->data_type > kDegreeFlowFloat32
+      || header->layout > kDegreeFlowColumnMajor) {
+    *error = "unknown data type or layout.";
+    return false;
+  }
+  data_type_ = static_cast<DegreeFlowDataType>(header->data_type);
+  layout_ = static_cast<DegreeFlowLayout>(header->layout);
+
+  // Check the size without overflows: the dimensions are bounded by the size
+  // before they are multiplied.
+  uint64_t num_rows = header->num_rows;
+  uint64_t num_cols = header->num_cols;
+  uint64_t total_size = size;
+  uint64_t value_size = DataTypeSize(data_type_);
+  bool valid_size = num_rows > 0 && num_cols > 0 && num_rows <= total_size
+      && num_cols <= total_size && num_rows <= total_size / num_cols
+      && DataOffset(num_rows, num_cols) <= total_size;
+  if (valid_size) {
+    uint64_t data_size = total_size - DataOffset(num_rows, num_cols);
+    valid_size = data_size % value_size == 0
+                 && data_size / value_size == num_rows * num_cols;
+  }
+  if (!valid_size) {
+    *error = "the size does not match the dimensions.";
+    return false;
+  }
+  num_rows_ = num_rows;
+  num_cols_ = num_cols;
+  k_ = header->k;
+
+  const char* bytes = static_cast<const char*>(data);
+  row_degrees_ = reinterpret_cast<const int32_t*>(bytes
+                                                  + sizeof(ProblemHeader));
+  col_degrees_ = row_degrees_ + num_rows_;
+  data_ = bytes + DataOffset(num_rows, num_cols);
+  return true;
+}
+
+void DegreeFlowProblemFile::Close() {
+  if (mapping_ != NULL) {
+    munmap(mapping_, mapping_size_);
+  }
+  mapping_ = NULL;
+  mapping_size_ = 0;
+  num_rows_ = 0;
+  num_cols_ = 0;
+  k_ = 0;
+  row_degrees_ = NULL;
+  col_degrees_ = NULL;
+  data_ = NULL;
+}
+
+void DegreeFlowProblemFile::GetDegrees(vector<int>* row_degrees,
+                                       vector<int>* col_degrees) const {
+  row_degrees->assign(row_degrees_, row_degrees_ + num_rows_);
+  col_degrees->assign(col_degrees_, col_degrees_ + num_cols_);
+}
+
+void DegreeFlowProblemFile::GetMatrix(vector<vector<double> >* x) const {
+  if (data_type_ == kDegreeFlowFloat32) {
+    ConvertMatrix(static_cast<const float*>(data_), num_rows_, num_cols_,
+                  layout_, x);
+  } else {
+    ConvertMatrix(static_cast<const double*>(data_), num_rows_, num_cols_,
+                  layout_, x);
+  }
+}
+
+void DegreeFlowProblemFile::GetMatrixView(
+    vector<double>* buffer, DegreeFlowMatrixView<const double>* view) const {
+  if (data_type_ == kDegreeFlowFloat64) {
+    *view = MatrixView<double>();
+    return;
+  }
+
+  DegreeFlowMatrixView<const float> data = MatrixView<float>();
+  buffer->resize(num_rows_ * num_cols_);
+  for (size_t row = 0; row < num_rows_; ++row) {
+    for (size_t col = 0; col < num_cols_; ++col) {
+      (*buffer)[row * num_cols_ + col] = data(row, col);
+    }
+  }
+  *view = DegreeFlowMatrixView<const double>::RowMajor(&(*buffer)[0],
+                                                       num_rows_, num_cols_);
+}
+
+bool ReadDegreeFlowTextProblem(FILE* input, vector<vector<double> >* x,
+                               int* k, vector<int>* row_degrees,
+                               vector<int>* col_degrees) {
+  int r, c;
+  if (fscanf(input, "%d %d %d", &r, &c, k) != 3 || r <= 0 || c <= 0) {
+    return false;
+  }
+  row_degrees->resize(r);
+  for (int ii = 0; ii < r; ++ii) {
+    if (fscanf(input, "%d", &(*row_degrees)[ii]) != 1) {
+      return false;
+    }
+  }
+  col_degrees->resize(c);
+  for (int jj = 0; jj < c; ++jj) {
+    if (fscanf(input, "%d", &(*col_degrees)[jj]) != 1) {
+      return false;
+    }
+  }
+  x->resize(r);
+  for (int ii = 0; ii < r; ++ii) {
+    (*x)[ii].resize(c);
+    for (int jj = 0; jj < c; ++jj) {
+      if (fscanf(input, "%lf", &(*x)[ii][jj]) != 1) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool EncodeDegreeFlowProblem(const vector<vector<double> >& x, int k,
+                             const vector<int>& row_degrees,
+                             const vector<int>& col_degrees,
+                             DegreeFlowDataType data_type,
+                             DegreeFlowLayout layout, vector<char>* buffer,
+                             string* error) {
+  if (x.empty() || x[0].empty() || row_degrees.size() != x.size()
+      || col_degrees.size() != x[0].size()) {
+    *error = "The degrees do not match the dimensions of the signal.";
+    return false;
+  }
+  for (size_t row = 1; row < x.size(); ++row) {
+    if (x[row].size() != x[0].size()) {
+      *error = "All rows of the signal must have the same size.";
+      return false;
+    }
+  }
+
+  ProblemHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kProblemMagic, sizeof(kProblemMagic));
+  header.version = kProblemVersion;
+  header.data_type = data_type;
+  header.layout = layout;
+  header.k = k;
+  header.num_rows = x.size();
+  header.num_cols = x[0].size();
+
+  buffer->clear();
+  AppendValues(&header, 1, buffer);
+  AppendDegrees(row_degrees, buffer);
+  AppendDegrees(col_degrees, buffer);
+  buffer->resize(DataOffset(header.num_rows, header.num_cols), 0);
+  if (data_type == kDegreeFlowFloat32) {
+    AppendMatrix<float>(x, layout, buffer);
+  } else {
+    AppendMatrix<double>(x, layout, buffer);
+  }
+  return true;
+}
+
+bool WriteDegreeFlowProblemFile(const char* filename,
+                                const vector<vector<double> >& x, int k,
+                                const vector<int>& row_degrees,
+                                const vector<int>& col_degrees,
+                                DegreeFlowDataType data_type,
+                                DegreeFlowLayout layout, string* error) {
+  vector<char> buffer;
+  if (!EncodeDegreeFlowProblem(x, k, row_degrees, col_degrees, data_type,
+                               layout, &buffer, error)) {
+    return false;
+  }
+  FILE* output = fopen(filename, "wb");
+  if (output == NULL) {
+    *error = string("Could not open ") + filename + ": " + strerror(errno);
+    return false;
+  }
+  bool success = fwrite(&buffer[0], 1, buffer.size(), output)
+                 == buffer.size();
+  if (fclose(output) != 0) {
+    success = false;
+  }
+  if (!success) {
+    *error = string("Could not write ") + filename + ".";
+  }
+  return success;
+}
+
+void EncodeDegreeFlowSupport(const vector<vector<bool> >& support,
+                             vector<char>* buffer) {
+  vector<uint32_t> indices;
+  for (size_t row = 0; row < support.size(); ++row) {
+    for (size_t col = 0; col < support[row].size(); ++col) {
+      if (support[row][col]) {
+        indices.push_back(row);
+        indices.push_back(col);
+      }
+    }
+  }
+  uint64_t num_entries = indices.size() / 2;
+  buffer->clear();
+  AppendValues(kSupportMagic, sizeof(kSupportMagic), buffer);
+  AppendValues(&num_entries, 1, buffer);
+  if (!indices.empty()) {
+    AppendValues(&indices[0], indices.size(), buffer);
+  }
+}
+
+void EncodeDegreeFlowSupport(const DegreeFlowMatrixView<const uint8_t>& mask,
+                             vector<char>* buffer) {
+  vector<uint32_t> indices;
+  for (size_t row = 0; row < mask.num_rows; ++row) {
+    for (size_t col = 0; col < mask.num_cols; ++col) {
+      if (mask(row, col) != 0) {
+        indices.push_back(row);
+        indices.push_back(col);
+      }
+    }
+  }
+  uint64_t num_entries = indices.size() / 2;
+  buffer->clear();
+  AppendValues(kSupportMagic, sizeof(kSupportMagic), buffer);
+  AppendValues(&num_entries, 1, buffer);
+  if (!indices.empty()) {
+    AppendValues(&indices[0], indices.size(), buffer);
+  }
+}
+
+void EncodeDegreeFlowSupport(const vector<pair<uint32_t, uint32_t> >& support,
+                             vector<char>* buffer) {
+  uint64_t num_entries = support.size();
+  buffer->clear();
+  AppendValues(kSupportMagic, sizeof(kSupportMagic), buffer);
+  AppendValues(&num_entries, 1, buffer);
+  for (size_t ii = 0; ii < support.size(); ++ii) {
+    uint32_t index[2] = {support[ii].first, support[ii].second};
+    AppendValues(index, 2, buffer);
+  }
+}
+
+bool DecodeDegreeFlowSupport(const char* data, size_t size,
+                             vector<pair<uint32_t, uint32_t> >* support) {
+  uint64_t num_entries;
+  if (size < sizeof(kSupportMagic) + sizeof(num_entries)
+      || memcmp(data, kSupportMagic, sizeof(kSupportMagic)) != 0) {
+    return false;
+  }
+  memcpy(&num_entries, data + sizeof(kSupportMagic), sizeof(num_entries));
+  const char* indices = data + sizeof(kSupportMagic) + sizeof(num_entries);
+  size_t indices_size = size - sizeof(kSupportMagic) - sizeof(num_entries);
+  if (indices_size % (2 * sizeof(uint32_t)) != 0
+      || indices_size / (2 * sizeof(uint32_t)) != num_entries) {
+    return false;
+  }
+  support->resize(num_entries);
+  for (size_t ii = 0; ii < num_entries; ++ii) {
+    uint32_t index[2];
+    memcpy(index, indices + 2 * sizeof(uint32_t) * ii, sizeof(index));
+    (*support)[ii] = make_pair(index[0], index[1]);
+  }
+  return true;
+}
+
+bool WriteDegreeFlowSupport(FILE* output,
+                            const vector<vector<bool> >& support) {
+  vector<char> buffer;
+  EncodeDegreeFlowSupport(support, &buffer);
+  return fwrite(&buffer[0], 1, buffer.size(), output) == buffer.size();
+}
+
+bool WriteDegreeFlowSupport(FILE* output,
+                            const DegreeFlowMatrixView<const uint8_t>& mask) {
+  vector<char> buffer;
+  EncodeDegreeFlowSupport(mask, &buffer);
+  return fwrite(&buffer[0], 1, buffer.size(), output) == buffer.size();
+}
+
+bool WriteDegreeFlowSupport(FILE* output,
+                            const vector<pair<uint32_t, uint32_t> >& support) {
+  vector<char> buffer;
+  EncodeDegreeFlowSupport(support, &buffer);
+  return fwrite(&buffer[0], 1, buffer.size(), output) == buffer.size();
+}
+
+bool ReadDegreeFlowSupport(FILE* input,
+                           vector<pair<uint32_t, uint32_t> >* support) {
+  char magic[sizeof(kSupportMagic)];
+  uint64_t num_entries;
+  if (fread(magic, sizeof(magic), 1, input) != 1
+      || memcmp(magic, kSupportMagic, sizeof(kSupportMagic)) != 0
+      || fread(&num_entries, sizeof(num_entries), 1, input) != 1) {
+    return false;
+  }
+  support->clear();
+  for (uint64_t ii = 0; ii < num_entries; ++ii) {
+    uint32_t index[2];
+    if (fread(index, sizeof(uint32_t), 2, input) != 2) {
+      return false;
+    }
+    support->push_back(make_pair(index[0], index[1]));
+  }
+  return true;
+}
+
+bool WriteDegreeFlowCertificate(FILE* output,
+                                const DegreeFlowCertificate& certificate) {
+  uint64_t dimensions[2] = {certificate.num_rows, certificate.num_cols};
+  double values[3] = {certificate.sparsity_dual, certificate.objective,
+                      certificate.dual_objective};
+  if (certificate.potential.size()
+          != certificate.num_rows + certificate.num_cols + 2
+      || certificate.row_dual.size() != certificate.num_rows
+      || certificate.col_dual.size() != certificate.num_cols) {
+    return false;
+  }
+  vector<char> buffer;
+  AppendValues(kCertificateMagic, sizeof(kCertificateMagic), &buffer);
+  AppendValues(dimensions, 2, &buffer);
+  AppendValues(values, 3, &buffer);
+  AppendValues(&certificate.potential[0], certificate.potential.size(),
+               &buffer);
+  if (!certificate.row_dual.empty()) {
+    AppendValues(&certificate.row_dual[0], certificate.row_dual.size(),
+                 &buffer);
+  }
+  if (!certificate.col_dual.empty()) {
+    AppendValues(&certificate.col_dual[0], certificate.col_dual.size(),
+                 &buffer);
+  }
+  return fwrite(&buffer[0], 1, buffer.size(), output) == buffer.size();
+}
+
+bool ReadDegreeFlowCertificate(FILE* input,
+                               DegreeFlowCertificate* certificate) {
+  char magic[sizeof(kCertificateMagic)];
+  uint64_t dimensions[2];
+  double values[3];
+  if (fread(magic, sizeof(magic), 1, input) != 1
+      || memcmp(magic, kCertificateMagic, sizeof(kCertificateMagic)) != 0
+      || fread(dimensions, sizeof(uint64_t), 2, input) != 2
+      || fread(values, sizeof(double), 3, input) != 3) {
+    return false;
+  }
+  // Guards the allocations below against corrupt files.
+  const uint64_t kMaxDimension = 1ULL << 40;
+  if (dimensions[0] > kMaxDimension || dimensions[1] > kMaxDimension) {
+    return false;
+  }
+  certificate->num_rows = dimensions[0];
+  certificate->num_cols = dimensions[1];
+  certificate->sparsity_dual = values[0];
+  certificate->objective = values[1];
+  certificate->dual_objective = values[2];
+  certificate->potential.resize(dimensions[0] + dimensions[1] + 2);
+  certificate->row_dual.resize(dimensions[0]);
+  certificate->col_dual.resize(dimensions[1]);
+  return ReadValues(input, &certificate->potential)
+         && ReadValues(input, &certificate->row_dual)
+         && ReadValues(input, &certificate->col_dual);
+}
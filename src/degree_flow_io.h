@@ -0,0 +1,168 @@
+#ifndef __DEGREE_FLOW_IO_H__
+#define __DEGREE_FLOW_IO_H__
+
+#include <cstddef>
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "degree_flow_view.h"
+
+// Binary problem files for the degree_flow command-line program.
+//
+// A problem file consists of
+//
+//   - a 40 byte header: the magic string "DEGFLOWP", the format version, the
+//     data type and the layout of the amplitudes (all uint32), k (int32) and
+//     the number of rows and columns (both uint64),
+//   - the row degrees and the column degrees (int32),
+//   - zero padding up to the next multiple of 8 bytes,
+//   - the amplitudes as float32 or float64 in row-major or column-major
+//     order.
+//
+// All numbers are stored in the byte order of the machine that wrote the
+// file. A file with the wrong byte order is rejected because its version
+// does not match.
+//
+// Supports are written as the magic string "DEGFLOWS", the number of entries
+// in the support (uint64) and the (row, column) index pairs of the entries
+// in row-major order (uint32 each).
+//
+// Certificates (see DegreeFlowCertificate) are written as the magic string
+// "DEGFLOWC", the number of rows and columns (uint64 each), the sparsity
+// dual, the objective and the dual objective, the r + c + 2 potentials, the
+// r row duals and the c column duals (float64 each).
+
+struct DegreeFlowCertificate;
+
+enum DegreeFlowDataType {
+  kDegreeFlowFloat64 = 0,
+  kDegreeFlowFloat32 = 1,
+};
+
+enum DegreeFlowLayout {
+  kDegreeFlowRowMajor = 0,
+  kDegreeFlowColumnMajor = 1,
+};
+
+// A problem file mapped into memory. The degrees and the amplitudes are read
+// directly from the mapping, so opening a file costs no parsing and no copy
+// of the amplitudes.
+class DegreeFlowProblemFile {
+ public:
+  DegreeFlowProblemFile();
+  ~DegreeFlowProblemFile();
+
+  // Returns false and sets *error if the file cannot be mapped or is not a
+  // valid problem file.
+  bool Open(const char* filename, std::string* error);
+  // Reads the problem from the contents of a problem file in memory. The
+  // buffer must stay alive until the file is closed and must be aligned to
+  // 8 bytes.
+  bool OpenBuffer(const void* data, size_t size, std::string* error);
+  void Close();
+
+  size_t num_rows() const { return num_rows_; }
+  size_t num_cols() const { return num_cols_; }
+  int k() const { return k_; }
+  DegreeFlowDataType data_type() const { return data_type_; }
+  DegreeFlowLayout layout() const { return layout_; }
+  const int32_t* row_degrees() const { return row_degrees_; }
+  const int32_t* col_degrees() const { return col_degrees_; }
+  // Points to the float or double amplitudes in the mapping
+  const void* data() const { return data_; }
+
+  void GetDegrees(std::vector<int>* row_degrees,
+                  std::vector<int>* col_degrees) const;
+  // Converts the amplitudes to the layout expected by DegreeFlowSolver.
+  void GetMatrix(std::vector<std::vector<double> >* x) const;
+  // Sets *view to the amplitudes. Float64 amplitudes are viewed in the
+  // mapping without a copy; float32 amplitudes are converted into *buffer
+  // in row-major order.
+  void GetMatrixView(std::vector<double>* buffer,
+                     DegreeFlowMatrixView<const double>* view) const;
+  // Views the amplitudes in the mapping. T has to match data_type().
+  template <typename T>
+  DegreeFlowMatrixView<const T> MatrixView() const {
+    const T* data = static_cast<const T*>(data_);
+    if (layout_ == kDegreeFlowRowMajor) {
+      return DegreeFlowMatrixView<const T>::RowMajor(data, num_rows_,
+                                                     num_cols_);
+    }
+    return DegreeFlowMatrixView<const T>::ColumnMajor(data, num_rows_,
+                                                      num_cols_);
+  }
+
+ private:
+  bool Parse(const void* data, size_t size, std::string* error);
+
+  // NULL if the problem was opened from a buffer
+  void* mapping_;
+  size_t mapping_size_;
+  size_t num_rows_;
+  size_t num_cols_;
+  int k_;
+  DegreeFlowDataType data_type_;
+  DegreeFlowLayout layout_;
+  const int32_t* row_degrees_;
+  const int32_t* col_degrees_;
+  const void* data_;
+
+  DegreeFlowProblemFile(const DegreeFlowProblemFile&);
+  DegreeFlowProblemFile& operator=(const DegreeFlowProblemFile&);
+};
+
+// Reads a problem in the text format of the degree_flow program: r, c and k,
+// followed by the r row degrees, the c column degrees and the amplitudes in
+// row-major order. Returns false if the input ends early or is malformed.
+bool ReadDegreeFlowTextProblem(FILE* input,
+                               std::vector<std::vector<double> >* x, int* k,
+                               std::vector<int>* row_degrees,
+                               std::vector<int>* col_degrees);
+
+// Writes the contents of a problem file into *buffer.
+bool EncodeDegreeFlowProblem(const std::vector<std::vector<double> >& x,
+                             int k, const std::vector<int>& row_degrees,
+                             const std::vector<int>& col_degrees,
+                             DegreeFlowDataType data_type,
+                             DegreeFlowLayout layout,
+                             std::vector<char>* buffer, std::string* error);
+
+bool WriteDegreeFlowProblemFile(const char* filename,
+                                const std::vector<std::vector<double> >& x,
+                                int k, const std::vector<int>& row_degrees,
+                                const std::vector<int>& col_degrees,
+                                DegreeFlowDataType data_type,
+                                DegreeFlowLayout layout, std::string* error);
+
+void EncodeDegreeFlowSupport(const std::vector<std::vector<bool> >& support,
+                             std::vector<char>* buffer);
+// The same for a support mask (nonzero entries are in the support)
+void EncodeDegreeFlowSupport(const DegreeFlowMatrixView<const uint8_t>& mask,
+                             std::vector<char>* buffer);
+// The same for the (row, column) indices of the support in row-major order
+void EncodeDegreeFlowSupport(
+    const std::vector<std::pair<uint32_t, uint32_t> >& support,
+    std::vector<char>* buffer);
+
+bool DecodeDegreeFlowSupport(const char* data, size_t size,
+    std::vector<std::pair<uint32_t, uint32_t> >* support);
+
+bool WriteDegreeFlowSupport(FILE* output,
+                            const std::vector<std::vector<bool> >& support);
+bool WriteDegreeFlowSupport(FILE* output,
+                            const DegreeFlowMatrixView<const uint8_t>& mask);
+bool WriteDegreeFlowSupport(
+    FILE* output, const std::vector<std::pair<uint32_t, uint32_t> >& support);
+
+bool ReadDegreeFlowSupport(FILE* input,
+    std::vector<std::pair<uint32_t, uint32_t> >* support);
+
+bool WriteDegreeFlowCertificate(FILE* output,
+                                const DegreeFlowCertificate& certificate);
+bool ReadDegreeFlowCertificate(FILE* input,
+                               DegreeFlowCertificate* certificate);
+
+#endif
@@ -0,0 +1,208 @@
+#include "degree_flow_io.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "degree_flow.h"
+#include "gtest/gtest.h"
+
+using namespace std;
+
+class DegreeFlowIOTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    char filename[] = "/tmp/degree_flow_io_test_XXXXXX";
+    int fd = mkstemp(filename);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    filename_ = filename;
+
+    // An odd number of degrees, so the amplitudes need padding.
+    x.resize(3);
+    for (int ii = 0; ii < 3; ++ii) {
+      x[ii].resize(4);
+      for (int jj = 0; jj < 4; ++jj) {
+        x[ii][jj] = 0.25 * (4 * ii + jj) - 1.5;
+      }
+    }
+    k = 5;
+    row_degrees.resize(3);
+    row_degrees[0] = 2;
+    row_degrees[1] = 0;
+    row_degrees[2] = 3;
+    col_degrees.assign(4, 1);
+  }
+
+  void TearDown() {
+    unlink(filename_.c_str());
+  }
+
+  void CheckRoundTrip(DegreeFlowDataType data_type, DegreeFlowLayout layout) {
+    string error;
+    ASSERT_TRUE(WriteDegreeFlowProblemFile(filename_.c_str(), x, k,
+                                           row_degrees, col_degrees,
+                                           data_type, layout, &error))
+        << error;
+    DegreeFlowProblemFile file;
+    ASSERT_TRUE(file.Open(filename_.c_str(), &error)) << error;
+    EXPECT_EQ(3u, file.num_rows());
+    EXPECT_EQ(4u, file.num_cols());
+    EXPECT_EQ(k, file.k());
+    EXPECT_EQ(data_type, file.data_type());
+    EXPECT_EQ(layout, file.layout());
+    vector<int> file_row_degrees;
+    vector<int> file_col_degrees;
+    file.GetDegrees(&file_row_degrees, &file_col_degrees);
+    EXPECT_EQ(row_degrees, file_row_degrees);
+    EXPECT_EQ(col_degrees, file_col_degrees);
+    // All amplitudes are exact in float32.
+    vector<vector<double> > file_x;
+    file.GetMatrix(&file_x);
+    EXPECT_EQ(x, file_x);
+
+    vector<double> buffer;
+    DegreeFlowMatrixView<const double> view;
+    file.GetMatrixView(&buffer, &view);
+    ASSERT_EQ(3u, view.num_rows);
+    ASSERT_EQ(4u, view.num_cols);
+    for (size_t row = 0; row < 3; ++row) {
+      for (size_t col = 0; col < 4; ++col) {
+        EXPECT_EQ(x[row][col], view(row, col));
+      }
+    }
+    // Float64 amplitudes are not copied.
+    if (data_type == kDegreeFlowFloat64) {
+      EXPECT_EQ(file.data(), static_cast<const void*>(view.data));
+    }
+  }
+
+  string filename_;
+  vector<vector<double> > x;
+  int k;
+  vector<int> row_degrees;
+  vector<int> col_degrees;
+};
+
+TEST_F(DegreeFlowIOTest, ProblemFileRoundTrip) {
+  CheckRoundTrip(kDegreeFlowFloat64, kDegreeFlowRowMajor);
+  CheckRoundTrip(kDegreeFlowFloat64, kDegreeFlowColumnMajor);
+  CheckRoundTrip(kDegreeFlowFloat32, kDegreeFlowRowMajor);
+  CheckRoundTrip(kDegreeFlowFloat32, kDegreeFlowColumnMajor);
+}
+
+TEST_F(DegreeFlowIOTest, TruncatedProblemFile) {
+  string error;
+  ASSERT_TRUE(WriteDegreeFlowProblemFile(filename_.c_str(), x, k,
+                                         row_degrees, col_degrees,
+                                         kDegreeFlowFloat64,
+                                         kDegreeFlowRowMajor, &error));
+  ASSERT_EQ(0, truncate(filename_.c_str(), 100));
+  DegreeFlowProblemFile file;
+  EXPECT_FALSE(file.Open(filename_.c_str(), &error));
+}
+
+TEST_F(DegreeFlowIOTest, TextProblem) {
+  FILE* file = fopen(filename_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  fprintf(file, "3 4 5\n2 0 3\n1 1 1 1\n");
+  for (int ii = 0; ii < 3; ++ii) {
+    for (int jj = 0; jj < 4; ++jj) {
+      fprintf(file, "%lf ", x[ii][jj]);
+    }
+    fprintf(file, "\n");
+  }
+  fclose(file);
+
+  vector<vector<double> > text_x;
+  int text_k;
+  vector<int> text_row_degrees;
+  vector<int> text_col_degrees;
+  file = fopen(filename_.c_str(), "r");
+  ASSERT_TRUE(ReadDegreeFlowTextProblem(file, &text_x, &text_k,
+                                        &text_row_degrees, &text_col_degrees));
+  fclose(file);
+  EXPECT_EQ(x, text_x);
+  EXPECT_EQ(k, text_k);
+  EXPECT_EQ(row_degrees, text_row_degrees);
+  EXPECT_EQ(col_degrees, text_col_degrees);
+}
+
+TEST_F(DegreeFlowIOTest, SupportRoundTrip) {
+  vector<vector<bool> > support(3, vector<bool>(4, false));
+  support[0][1] = true;
+  support[2][0] = true;
+  support[2][3] = true;
+  FILE* file = fopen(filename_.c_str(), "wb");
+  ASSERT_TRUE(file != NULL);
+  ASSERT_TRUE(WriteDegreeFlowSupport(file, support));
+  fclose(file);
+
+  vector<pair<uint32_t, uint32_t> > indices;
+  file = fopen(filename_.c_str(), "rb");
+  ASSERT_TRUE(ReadDegreeFlowSupport(file, &indices));
+  fclose(file);
+  ASSERT_EQ(3u, indices.size());
+  EXPECT_EQ(make_pair(0u, 1u), indices[0]);
+  EXPECT_EQ(make_pair(2u, 0u), indices[1]);
+  EXPECT_EQ(make_pair(2u, 3u), indices[2]);
+
+  // Index lists are encoded like the matrix they describe.
+  vector<char> matrix_buffer;
+  EncodeDegreeFlowSupport(support, &matrix_buffer);
+  vector<char> indices_buffer;
+  EncodeDegreeFlowSupport(indices, &indices_buffer);
+  EXPECT_EQ(matrix_buffer, indices_buffer);
+}
+
+TEST_F(DegreeFlowIOTest, CertificateRoundTrip) {
+  DegreeFlowCertificate certificate;
+  certificate.num_rows = 2;
+  certificate.num_cols = 3;
+  for (int ii = 0; ii < 7; ++ii) {
+    certificate.potential.push_back(0.5 * ii - 1.0);
+  }
+  certificate.row_dual.push_back(0.0);
+  certificate.row_dual.push_back(1.25);
+  certificate.col_dual.push_back(0.5);
+  certificate.col_dual.push_back(0.0);
+  certificate.col_dual.push_back(2.0);
+  certificate.sparsity_dual = 0.75;
+  certificate.objective = 3.5;
+  certificate.dual_objective = 3.5;
+  FILE* file = fopen(filename_.c_str(), "wb");
+  ASSERT_TRUE(file != NULL);
+  ASSERT_TRUE(WriteDegreeFlowCertificate(file, certificate));
+  fclose(file);
+
+  DegreeFlowCertificate read;
+  file = fopen(filename_.c_str(), "rb");
+  ASSERT_TRUE(ReadDegreeFlowCertificate(file, &read));
+  fclose(file);
+  EXPECT_EQ(certificate.num_rows, read.num_rows);
+  EXPECT_EQ(certificate.num_cols, read.num_cols);
+  EXPECT_EQ(certificate.potential, read.potential);
+  EXPECT_EQ(certificate.row_dual, read.row_dual);
+  EXPECT_EQ(certificate.col_dual, read.col_dual);
+  EXPECT_EQ(certificate.sparsity_dual, read.sparsity_dual);
+  EXPECT_EQ(certificate.objective, read.objective);
+  EXPECT_EQ(certificate.dual_objective, read.dual_objective);
+
+  // A support file is not a certificate.
+  vector<vector<bool> > support(2, vector<bool>(3, false));
+  file = fopen(filename_.c_str(), "wb");
+  ASSERT_TRUE(WriteDegreeFlowSupport(file, support));
+  fclose(file);
+  file = fopen(filename_.c_str(), "rb");
+  EXPECT_FALSE(ReadDegreeFlowCertificate(file, &read));
+  fclose(file);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,225 @@
+// Load generator for the projection server (degree_flow --server). Every
+// client thread opens one connection and sends its requests one after the
+// other. The program prints the throughput and the latency distribution.
+//
+// Usage: degree_flow_load_generator --socket path [options]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+#include "degree_flow_io.h"
+#include "degree_flow_server.h"
+#include "degree_flow_time.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+namespace {
+
+// Number of different problems each client cycles through
+const int kNumProblemsPerClient = 4;
+
+struct Client {
+  pthread_t thread;
+  string socket_path;
+  int num_requests;
+  bool file_requests;
+  // Inline payloads, or the paths of the problem files
+  vector<vector<char> > payloads;
+  vector<double> latencies;
+  double solve_time;
+  int num_failed_requests;
+  string error;
+};
+
+void GenerateProblem(int r, int c, unsigned int* seed,
+                     vector<vector<double> >* x) {
+  x->resize(r);
+  for (int ii = 0; ii < r; ++ii) {
+    (*x)[ii].resize(c);
+    for (int jj = 0; jj < c; ++jj) {
+      (*x)[ii][jj] = static_cast<double>(rand_r(seed)) / RAND_MAX - 0.5;
+    }
+  }
+}
+
+void* ClientMain(void* client_pointer) {
+  Client* client = static_cast<Client*>(client_pointer);
+  int connection = ConnectToDegreeFlowServer(client->socket_path.c_str(),
+                                             &client->error);
+  if (connection < 0) {
+    return NULL;
+  }
+  DegreeFlowRequestType type = (client->file_requests
+                                ? kDegreeFlowFileRequest
+                                : kDegreeFlowInlineRequest);
+  DegreeFlowResponse response;
+  for (int ii = 0; ii < client->num_requests; ++ii) {
+    const vector<char>& payload = client->payloads[ii
+                                                   % client->payloads.size()];
+    double start_time = WallTime();
+    if (!SendDegreeFlowRequest(connection, type, &payload[0], payload.size())
+        || !ReceiveDegreeFlowResponse(connection, &response)) {
+      client->error = "The connection to the server failed.";
+      break;
+    }
+    client->latencies.push_back(WallTime() - start_time);
+    client->solve_time += response.solve_time;
+    if (response.status != kDegreeFlowRequestSucceeded) {
+      client->num_failed_requests += 1;
+    }
+  }
+  close(connection);
+  return NULL;
+}
+
+double Percentile(const vector<double>& sorted_values, double fraction) {
+  size_t index = static_cast<size_t>(fraction * (sorted_values.size() - 1)
+                                     + 0.5);
+  return sorted_values[index];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  po::options_description desc("Sends random projection requests to a "
+                               "degree_flow server.\nOptions");
+  desc.add_options()
+      ("help", "print this help message")
+      ("socket", po::value<string>(), "socket path of the server")
+      ("clients", po::value<int>()->default_value(4),
+       "number of concurrent connections")
+      ("requests", po::value<int>()->default_value(100),
+       "number of requests per connection")
+      ("rows", po::value<int>()->default_value(50), "rows per problem")
+      ("cols", po::value<int>()->default_value(50), "columns per problem")
+      ("k", po::value<int>()->default_value(100), "sparsity per problem")
+      ("degree", po::value<int>()->default_value(2),
+       "row and column degree per problem")
+      ("files", "send the paths of problem files instead of inline problems")
+      ("shutdown", "shut the server down after the run");
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch (const po::error& e) {
+    cerr << e.what() << endl << desc << endl;
+    return 1;
+  }
+  if (vm.count("help") || !vm.count("socket")) {
+    cout << desc << endl;
+    return vm.count("help") ? 0 : 1;
+  }
+  string socket_path = vm["socket"].as<string>();
+  int num_clients = max(vm["clients"].as<int>(), 1);
+  int num_requests = max(vm["requests"].as<int>(), 1);
+  int r = vm["rows"].as<int>();
+  int c = vm["cols"].as<int>();
+  int k = vm["k"].as<int>();
+  vector<int> row_degrees(r, vm["degree"].as<int>());
+  vector<int> col_degrees(c, vm["degree"].as<int>());
+  bool file_requests = (vm.count("files") > 0);
+
+  vector<Client> clients(num_clients);
+  vector<string> problem_files;
+  vector<vector<double> > x;
+  string error;
+  for (int ii = 0; ii < num_clients; ++ii) {
+    Client& client = clients[ii];
+    client.socket_path = socket_path;
+    client.num_requests = num_requests;
+    client.file_requests = file_requests;
+    client.solve_time = 0.0;
+    client.num_failed_requests = 0;
+    client.payloads.resize(kNumProblemsPerClient);
+    unsigned int seed = ii + 1;
+    for (int jj = 0; jj < kNumProblemsPerClient; ++jj) {
+      GenerateProblem(r, c, &seed, &x);
+      vector<char>& payload = client.payloads[jj];
+      if (!EncodeDegreeFlowProblem(x, k, row_degrees, col_degrees,
+                                   kDegreeFlowFloat64, kDegreeFlowRowMajor,
+                                   &payload, &error)) {
+        cerr << error << endl;
+        return 1;
+      }
+      if (file_requests) {
+        char filename[] = "/tmp/degree_flow_load_XXXXXX";
+        int fd = mkstemp(filename);
+        if (fd < 0 || write(fd, &payload[0], payload.size())
+                      != static_cast<ssize_t>(payload.size())) {
+          cerr << "Could not write a problem file." << endl;
+          return 1;
+        }
+        close(fd);
+        problem_files.push_back(filename);
+        payload.assign(filename, filename + strlen(filename));
+      }
+    }
+  }
+
+  double start_time = WallTime();
+  for (int ii = 0; ii < num_clients; ++ii) {
+    pthread_create(&clients[ii].thread, NULL, ClientMain, &clients[ii]);
+  }
+  vector<double> latencies;
+  double solve_time = 0.0;
+  int num_failed_requests = 0;
+  for (int ii = 0; ii < num_clients; ++ii) {
+    pthread_join(clients[ii].thread, NULL);
+    if (!clients[ii].error.empty()) {
+      cerr << "Client " << ii << ": " << clients[ii].error << endl;
+    }
+    latencies.insert(latencies.end(), clients[ii].latencies.begin(),
+                     clients[ii].latencies.end());
+    solve_time += clients[ii].solve_time;
+    num_failed_requests += clients[ii].num_failed_requests;
+  }
+  double total_time = WallTime() - start_time;
+
+  for (size_t ii = 0; ii < problem_files.size(); ++ii) {
+    unlink(problem_files[ii].c_str());
+  }
+  if (vm.count("shutdown")) {
+    int connection = ConnectToDegreeFlowServer(socket_path.c_str(), &error);
+    DegreeFlowResponse response;
+    if (connection < 0
+        || !SendDegreeFlowRequest(connection, kDegreeFlowShutdownRequest,
+                                  NULL, 0)
+        || !ReceiveDegreeFlowResponse(connection, &response)) {
+      cerr << "Could not shut the server down." << endl;
+    }
+    if (connection >= 0) {
+      close(connection);
+    }
+  }
+  if (latencies.empty()) {
+    cerr << "No request succeeded." << endl;
+    return 1;
+  }
+
+  sort(latencies.begin(), latencies.end());
+  double mean_latency = 0.0;
+  for (size_t ii = 0; ii < latencies.size(); ++ii) {
+    mean_latency += latencies[ii];
+  }
+  mean_latency /= latencies.size();
+  printf("requests\tfailed\tclients\tr\tc\tk\tthroughput_per_s\t"
+         "mean_solve_ms\tmean_ms\tp50_ms\tp90_ms\tp99_ms\tmax_ms\n");
+  printf("%zu\t%d\t%d\t%d\t%d\t%d\t%.1f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",
+         latencies.size(), num_failed_requests, num_clients, r, c, k,
+         latencies.size() / total_time, 1e3 * solve_time / latencies.size(),
+         1e3 * mean_latency, 1e3 * Percentile(latencies, 0.5),
+         1e3 * Percentile(latencies, 0.9), 1e3 * Percentile(latencies, 0.99),
+         1e3 * latencies.back());
+  return 0;
+}
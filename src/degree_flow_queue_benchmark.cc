@@ -0,0 +1,124 @@
+// Compares the priority queues of the graph engine on random inputs.
+//
+// Usage: degree_flow_queue_benchmark [num_repetitions]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "degree_flow.h"
+#include "degree_flow_time.h"
+
+using namespace std;
+
+namespace {
+
+struct Workload {
+  const char* name;
+  int r;
+  int c;
+  int k;
+  int degree;
+  // Fraction of the entries that are nonzero
+  double density;
+};
+
+const Workload kWorkloads[] = {
+  {"dense", 200, 200, 400, 4, 1.0},
+  {"dense", 500, 500, 500, 2, 1.0},
+  {"sparse", 200, 200, 400, 4, 0.05},
+  {"sparse", 500, 500, 500, 2, 0.02},
+  {"rectangular", 20, 5000, 40, 2, 1.0},
+  {"rectangular", 5000, 20, 40, 2, 1.0},
+};
+
+const DegreeFlowOptions::Queue kQueues[] = {
+  DegreeFlowOptions::kLazyBinaryHeapQueue,
+  DegreeFlowOptions::kIndexedHeapQueue,
+  DegreeFlowOptions::kRadixHeapQueue,
+  DegreeFlowOptions::kBucketQueue,
+};
+
+const char* const kQueueNames[] = {
+  "lazy_binary_heap",
+  "indexed_4ary_heap",
+  "radix_heap",
+  "bucket_queue",
+};
+
+// The bucket queue needs integer costs, so its amplitudes are quantized
+// (the amplitudes are in [-0.5, 0.5]). Its support can therefore differ from
+// the others.
+const double kBucketQueuePrecision = 1e-3;
+
+void WriteToStderr(const char* s) {
+  fprintf(stderr, "%s", s);
+  fflush(stderr);
+}
+
+void GenerateWorkload(const Workload& workload, unsigned int seed,
+                      vector<vector<double> >* x) {
+  srand(seed);
+  x->resize(workload.r);
+  for (int ii = 0; ii < workload.r; ++ii) {
+    (*x)[ii].resize(workload.c);
+    for (int jj = 0; jj < workload.c; ++jj) {
+      double value = static_cast<double>(rand()) / RAND_MAX - 0.5;
+      if (static_cast<double>(rand()) / RAND_MAX >= workload.density) {
+        value = 0.0;
+      }
+      (*x)[ii][jj] = value;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int num_repetitions = 3;
+  if (argc > 1) {
+    num_repetitions = atoi(argv[1]);
+  }
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  vector<vector<bool> > result;
+  vector<vector<bool> > reference_result;
+
+  printf("workload\tr\tc\tk\tqueue\ttime_s\tsame_support\n");
+  for (size_t ii = 0; ii < sizeof(kWorkloads) / sizeof(kWorkloads[0]); ++ii) {
+    const Workload& workload = kWorkloads[ii];
+    vector<vector<double> > x;
+    GenerateWorkload(workload, ii + 1, &x);
+    vector<int> row_degrees(workload.r, workload.degree);
+    vector<int> col_degrees(workload.c, workload.degree);
+
+    for (size_t jj = 0; jj < sizeof(kQueues) / sizeof(kQueues[0]); ++jj) {
+      options.queue = kQueues[jj];
+      options.quantization_precision = 0.0;
+      if (kQueues[jj] == DegreeFlowOptions::kBucketQueue) {
+        options.quantization_precision = kBucketQueuePrecision;
+      }
+      double best_time = 0.0;
+      for (int rep = 0; rep < num_repetitions; ++rep) {
+        double start_time = WallTime();
+        solver.Solve(x, workload.k, row_degrees, col_degrees, options, false,
+                     WriteToStderr, &result);
+        double time = WallTime() - start_time;
+        if (rep == 0 || time < best_time) {
+          best_time = time;
+        }
+      }
+      if (jj == 0) {
+        reference_result = result;
+      }
+      printf("%s\t%d\t%d\t%d\t%s\t%.4f\t%d\n", workload.name, workload.r,
+             workload.c, workload.k, kQueueNames[jj], best_time,
+             result == reference_result ? 1 : 0);
+      fflush(stdout);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,395 @@
+#ifndef __DEGREE_FLOW_QUEUES_H__
+#define __DEGREE_FLOW_QUEUES_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// Priority queues for the heap-based Dijkstra of DegreeFlowSolver. All
+// queues have the same interface:
+//
+//   Reset(num_nodes)   empties the queue for nodes 0, ..., num_nodes - 1
+//   Update(node, key)  inserts node or decreases its key
+//   Empty()
+//   PopMin()           removes and returns a node with minimum key
+//   allocated_bytes()  the size of the storage of the queue
+//
+// The queues keep their storage between calls to Reset.
+
+// Binary heap with lazy deletion (the layout of std::priority_queue).
+// Update pushes a new element even if the node is already in the heap, so
+// PopMin can return nodes that have been popped before. The caller has to
+// skip them. Ties are broken towards the larger node index.
+class LazyBinaryHeap {
+ public:
+  void Reset(size_t /* num_nodes */) {
+    heap_.clear();
+  }
+
+  void Update(uint32_t node, double key) {
+    heap_.push_back(Element(-key, node));
+    std::push_heap(heap_.begin(), heap_.end());
+  }
+
+  bool Empty() const {
+    return heap_.empty();
+  }
+
+  uint32_t PopMin() {
+    std::pop_heap(heap_.begin(), heap_.end());
+    uint32_t node = heap_.back().second;
+    heap_.pop_back();
+    return node;
+  }
+
+  size_t allocated_bytes() const {
+    return heap_.capacity() * sizeof(Element);
+  }
+
+ private:
+  typedef std::pair<double, uint32_t> Element;
+  std::vector<Element> heap_;
+};
+
+// Indexed D-ary heap with decrease-key. Every node is in the heap at most
+// once, so the heap never has more than num_nodes elements. Ties are broken
+// towards the larger node index as in LazyBinaryHeap, so both queues pop
+// the nodes in the same order.
+template <int D>
+class IndexedDAryHeap {
+ public:
+  void Reset(size_t num_nodes) {
+    heap_.clear();
+    key_.resize(num_nodes);
+    position_.assign(num_nodes, kNotInHeap);
+  }
+
+  void Update(uint32_t node, double key) {
+    key_[node] = key;
+    if (position_[node] == kNotInHeap) {
+      position_[node] = heap_.size();
+      heap_.push_back(node);
+    }
+    SiftUp(position_[node]);
+  }
+
+  bool Empty() const {
+    return heap_.empty();
+  }
+
+  uint32_t PopMin() {
+    uint32_t node = heap_[0];
+    position_[node] = kNotInHeap;
+    uint32_t last = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty()) {
+      heap_[0] = last;
+      position_[last] = 0;
+      SiftDown(0);
+    }
+    return node;
+  }
+
+  size_t allocated_bytes() const {
+    return heap_.capacity() * sizeof(uint32_t)
+           + key_.capacity() * sizeof(double)
+           + position_.capacity() * sizeof(uint32_t);
+  }
+
+ private:
+  static const uint32_t kNotInHeap = 0xffffffff;
+
+  bool Less(uint32_t a, uint32_t b) const {
+    return key_[a] < key_[b] || (key_[a] == key_[b] && a > b);
+  }
+
+  void SiftUp(size_t pos) {
+    uint32_t node = heap_[pos];
+    while (pos > 0) {
+      size_t parent = (pos - 1) / D;
+      if (!Less(node, heap_[parent])) {
+        break;
+      }
+      heap_[pos] = heap_[parent];
+      position_[heap_[pos]] = pos;
+      pos = parent;
+    }
+    heap_[pos] = node;
+    position_[node] = pos;
+  }
+
+  void SiftDown(size_t pos) {
+    uint32_t node = heap_[pos];
+    size_t size = heap_.size();
+    while (true) {
+      size_t first_child = D * pos + 1;
+      if (first_child >= size) {
+        break;
+      }
+      size_t last_child = std::min(first_child + D, size);
+      size_t best_child = first_child;
+      for (size_t child = first_child + 1; child < last_child; ++child) {
+        if (Less(heap_[child], heap_[best_child])) {
+          best_child = child;
+        }
+      }
+      if (!Less(heap_[best_child], node)) {
+        break;
+      }
+      heap_[pos] = heap_[best_child];
+      position_[heap_[pos]] = pos;
+      pos = best_child;
+    }
+    heap_[pos] = node;
+    position_[node] = pos;
+  }
+
+  std::vector<uint32_t> heap_;
+  std::vector<double> key_;
+  std::vector<uint32_t> position_;
+};
+
+template <int D>
+const uint32_t IndexedDAryHeap<D>::kNotInHeap;
+
+// Radix heap with decrease-key. It relies on the keys being monotone: a key
+// passed to Update must not be smaller than the key of the last node
+// returned by PopMin. This holds in Dijkstra with non-negative reduced
+// costs. Keys that are slightly smaller due to floating-point noise are
+// rounded up to the last minimum.
+//
+// Non-negative doubles are ordered like their bit patterns, so the buckets
+// are defined on the bit patterns: bucket i > 0 contains the nodes whose
+// key differs from the last minimum first in bit i - 1 (counted from the
+// least significant bit), and bucket 0 contains the nodes whose key equals
+// the last minimum. Ties are broken arbitrarily.
+class RadixHeap {
+ public:
+  RadixHeap() : size_(0), last_min_(0) { }
+
+  void Reset(size_t num_nodes) {
+    for (int ii = 0; ii < kNumBuckets; ++ii) {
+      buckets_[ii].clear();
+    }
+    size_ = 0;
+    last_min_ = 0;
+    key_.resize(num_nodes);
+    bucket_.assign(num_nodes, static_cast<uint8_t>(kNotInHeap));
+    position_.resize(num_nodes);
+  }
+
+  void Update(uint32_t node, double key) {
+    if (bucket_[node] != kNotInHeap) {
+      Remove(node);
+    }
+    uint64_t key_bits = KeyBits(key);
+    key_[node] = std::max(key_bits, last_min_);
+    Insert(node);
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  uint32_t PopMin() {
+    if (buckets_[0].empty()) {
+      int bucket = 1;
+      while (buckets_[bucket].empty()) {
+        ++bucket;
+      }
+      // Move the nodes of the first non-empty bucket to smaller buckets
+      // relative to its minimum.
+      std::vector<uint32_t>& nodes = buckets_[bucket];
+      last_min_ = key_[nodes[0]];
+      for (size_t ii = 1; ii < nodes.size(); ++ii) {
+        last_min_ = std::min(last_min_, key_[nodes[ii]]);
+      }
+      for (size_t ii = 0; ii < nodes.size(); ++ii) {
+        bucket_[nodes[ii]] = kNotInHeap;
+        size_ -= 1;
+        Insert(nodes[ii]);
+      }
+      nodes.clear();
+    }
+    uint32_t node = buckets_[0].back();
+    buckets_[0].pop_back();
+    bucket_[node] = kNotInHeap;
+    size_ -= 1;
+    return node;
+  }
+
+  size_t allocated_bytes() const {
+    size_t bytes = key_.capacity() * sizeof(uint64_t)
+                   + bucket_.capacity() * sizeof(uint8_t)
+                   + position_.capacity() * sizeof(uint32_t);
+    for (int ii = 0; ii < kNumBuckets; ++ii) {
+      bytes += buckets_[ii].capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+  }
+
+ private:
+  static const int kNumBuckets = 65;
+  static const uint8_t kNotInHeap = 0xff;
+
+  static uint64_t KeyBits(double key) {
+    // Negative keys (including -0.0) are rounded up to 0.
+    if (!(key > 0.0)) {
+      return 0;
+    }
+    uint64_t key_bits;
+    memcpy(&key_bits, &key, sizeof(key_bits));
+    return key_bits;
+  }
+
+  int BucketIndex(uint64_t key_bits) const {
+    uint64_t diff = key_bits ^ last_min_;
+    if (diff == 0) {
+      return 0;
+    }
+    return 64 - __builtin_clzll(diff);
+  }
+
+  void Insert(uint32_t node) {
+    int bucket = BucketIndex(key_[node]);
+    bucket_[node] = bucket;
+    position_[node] = buckets_[bucket].size();
+    buckets_[bucket].push_back(node);
+    size_ += 1;
+  }
+
+  void Remove(uint32_t node) {
+    std::vector<uint32_t>& nodes = buckets_[bucket_[node]];
+    uint32_t last = nodes.back();
+    nodes[position_[node]] = last;
+    position_[last] = position_[node];
+    nodes.pop_back();
+    bucket_[node] = kNotInHeap;
+    size_ -= 1;
+  }
+
+  std::vector<uint32_t> buckets_[kNumBuckets];
+  size_t size_;
+  uint64_t last_min_;
+  std::vector<uint64_t> key_;
+  std::vector<uint8_t> bucket_;
+  std::vector<uint32_t> position_;
+};
+
+// Dial's bucket queue for integer keys (passed as doubles). Like RadixHeap,
+// it relies on the keys being monotone, and keys that are smaller than the
+// last minimum are rounded up to it. Bucket i contains the nodes whose key
+// is congruent to i modulo the number of buckets. The number of buckets is a
+// power of two that is larger than the difference between any key in the
+// queue and the last minimum, so every bucket contains nodes of only one
+// key. The buckets grow when a key does not fit. PopMin scans the buckets
+// from the last minimum, so the queue is fast if the reduced arc costs are
+// small integers. Ties are broken arbitrarily.
+class BucketQueue {
+ public:
+  BucketQueue() : size_(0), last_min_(0) {
+    buckets_.resize(kInitialNumBuckets);
+  }
+
+  void Reset(size_t num_nodes) {
+    for (size_t ii = 0; ii < buckets_.size(); ++ii) {
+      buckets_[ii].clear();
+    }
+    size_ = 0;
+    last_min_ = 0;
+    key_.resize(num_nodes);
+    position_.assign(num_nodes, static_cast<uint32_t>(kNotInQueue));
+  }
+
+  void Update(uint32_t node, double key) {
+    if (position_[node] != kNotInQueue) {
+      Remove(node);
+    }
+    int64_t int_key = (key > 0.0 ? static_cast<int64_t>(key + 0.5) : 0);
+    key_[node] = std::max(int_key, last_min_);
+    if (static_cast<uint64_t>(key_[node] - last_min_) >= buckets_.size()) {
+      Grow(key_[node] - last_min_);
+    }
+    Insert(node);
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  uint32_t PopMin() {
+    size_t mask = buckets_.size() - 1;
+    while (buckets_[last_min_ & mask].empty()) {
+      ++last_min_;
+    }
+    std::vector<uint32_t>& nodes = buckets_[last_min_ & mask];
+    uint32_t node = nodes.back();
+    nodes.pop_back();
+    position_[node] = kNotInQueue;
+    size_ -= 1;
+    return node;
+  }
+
+  size_t allocated_bytes() const {
+    size_t bytes = buckets_.capacity() * sizeof(std::vector<uint32_t>)
+                   + key_.capacity() * sizeof(int64_t)
+                   + position_.capacity() * sizeof(uint32_t);
+    for (size_t ii = 0; ii < buckets_.size(); ++ii) {
+      bytes += buckets_[ii].capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+  }
+
+ private:
+  static const size_t kInitialNumBuckets = 1024;
+  static const uint32_t kNotInQueue = 0xffffffff;
+
+  void Insert(uint32_t node) {
+    std::vector<uint32_t>& nodes = buckets_[key_[node]
+                                            & (buckets_.size() - 1)];
+    position_[node] = nodes.size();
+    nodes.push_back(node);
+    size_ += 1;
+  }
+
+  void Remove(uint32_t node) {
+    std::vector<uint32_t>& nodes = buckets_[key_[node]
+                                            & (buckets_.size() - 1)];
+    uint32_t last = nodes.back();
+    nodes[position_[node]] = last;
+    position_[last] = position_[node];
+    nodes.pop_back();
+    position_[node] = kNotInQueue;
+    size_ -= 1;
+  }
+
+  // Doubles the number of buckets until the key difference fits and
+  // redistributes the nodes.
+  void Grow(int64_t key_difference) {
+    std::vector<uint32_t> nodes;
+    for (size_t ii = 0; ii < buckets_.size(); ++ii) {
+      nodes.insert(nodes.end(), buckets_[ii].begin(), buckets_[ii].end());
+      buckets_[ii].clear();
+    }
+    size_t num_buckets = buckets_.size();
+    while (static_cast<uint64_t>(key_difference) >= num_buckets) {
+      num_buckets *= 2;
+    }
+    buckets_.resize(num_buckets);
+    size_ = 0;
+    for (size_t ii = 0; ii < nodes.size(); ++ii) {
+      Insert(nodes[ii]);
+    }
+  }
+
+  std::vector<std::vector<uint32_t> > buckets_;
+  size_t size_;
+  int64_t last_min_;
+  std::vector<int64_t> key_;
+  std::vector<uint32_t> position_;
+};
+
+#endif
@@ -0,0 +1,498 @@
+#include "degree_flow_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "degree_flow_io.h"
+#include "degree_flow_time.h"
+
+// Writing to a connection that the client has closed must not raise SIGPIPE.
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace std;
+
+namespace {
+
+const char kRequestMagic[8] = {'D', 'E', 'G', 'F', 'L', 'O', 'W', 'Q'};
+const char kResponseMagic[8] = {'D', 'E', 'G', 'F', 'L', 'O', 'W', 'A'};
+// Largest accepted payload (4 GB)
+const uint64_t kMaxPayloadSize = 1ULL << 32;
+// The payload buffer grows by at least this many bytes at a time.
+const size_t kPayloadChunkSize = 1 << 20;
+// A worker gives up on a connection that stalls in the middle of a request
+// or response for this long (in seconds).
+const int kConnectionTimeout = 30;
+const int kListenBacklog = 64;
+
+struct RequestHeader {
+  char magic[8];
+  uint32_t type;
+  uint32_t padding;
+  uint64_t payload_size;
+};
+
+struct ResponseHeader {
+  char magic[8];
+  uint32_t status;
+  int32_t worker;
+  double load_time;
+  double solve_time;
+  double objective;
+  uint64_t payload_size;
+};
+
+void WriteToStderr(const char* s) {
+  fprintf(stderr, "%s", s);
+  fflush(stderr);
+}
+
+bool ReadAll(int connection, void* data, size_t size) {
+  char* bytes = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t num_read = read(connection, bytes, size);
+    if (num_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_read <= 0) {
+      return false;
+    }
+    bytes += num_read;
+    size -= num_read;
+  }
+  return true;
+}
+
+// Reads a payload of the given size. The buffer grows with the data that
+// arrives, so a header that announces a large payload does not allocate
+// much more than the peer actually sends.
+bool ReadPayload(int connection, uint64_t size, vector<char>* payload) {
+  payload->clear();
+  while (payload->size() < size) {
+    size_t offset = payload->size();
+    size_t chunk_size = static_cast<size_t>(
+        min<uint64_t>(size - offset, max(offset, kPayloadChunkSize)));
+    payload->resize(offset + chunk_size);
+    if (!ReadAll(connection, &(*payload)[offset], chunk_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WriteAll(int connection, const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t num_written = send(connection, bytes, size, MSG_NOSIGNAL);
+    if (num_written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_written <= 0) {
+      return false;
+    }
+    bytes += num_written;
+    size -= num_written;
+  }
+  return true;
+}
+
+bool SetSocketPath(const char* socket_path, sockaddr_un* address,
+                   string* error) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address->sun_path)) {
+    *error = string("The socket path ") + socket_path + " is too long.";
+    return false;
+  }
+  strcpy(address->sun_path, socket_path);
+  return true;
+}
+
+bool SendResponse(int connection, const DegreeFlowResponse& response,
+                  const vector<char>& payload) {
+  ResponseHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kResponseMagic, sizeof(kResponseMagic));
+  header.status = response.status;
+  header.worker = response.worker;
+  header.load_time = response.load_time;
+  header.solve_time = response.solve_time;
+  header.objective = response.objective;
+  header.payload_size = payload.size();
+  return WriteAll(connection, &header, sizeof(header))
+      && (payload.empty() || WriteAll(connection, &payload[0], payload.size()));
+}
+
+bool SendError(int connection, DegreeFlowResponse* response,
+               const string& error) {
+  response->status = kDegreeFlowRequestFailed;
+  vector<char> payload(error.begin(), error.end());
+  return SendResponse(connection, *response, payload);
+}
+
+}  // namespace
+
+DegreeFlowServer::DegreeFlowServer(int num_threads)
+    : listen_socket_(-1), num_busy_workers_(0), shutting_down_(false) {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&connection_ready_, NULL);
+  if (pipe(wake_up_pipe_) == 0) {
+    fcntl(wake_up_pipe_[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_up_pipe_[1], F_SETFL, O_NONBLOCK);
+  } else {
+    wake_up_pipe_[0] = -1;
+    wake_up_pipe_[1] = -1;
+  }
+
+  // Only the workers whose thread started are kept (and joined), and Listen
+  // fails if any thread could not be started.
+  num_threads = max(num_threads, 1);
+  for (int ii = 0; ii < num_threads; ++ii) {
+    Worker* worker = new Worker();
+    worker->server = this;
+    worker->index = ii;
+    if (pthread_create(&(worker->thread), NULL, WorkerMain, worker) != 0) {
+      delete worker;
+      break;
+    }
+    workers_.push_back(worker);
+  }
+  workers_started_ = (static_cast<int>(workers_.size()) == num_threads);
+}
+
+DegreeFlowServer::~DegreeFlowServer() {
+  Shutdown();
+  StopWorkers();
+  for (size_t ii = 0; ii < idle_connections_.size(); ++ii) {
+    close(idle_connections_[ii]);
+  }
+  if (listen_socket_ >= 0) {
+    close(listen_socket_);
+    unlink(socket_path_.c_str());
+  }
+  if (wake_up_pipe_[0] >= 0) {
+    close(wake_up_pipe_[0]);
+    close(wake_up_pipe_[1]);
+  }
+  pthread_cond_destroy(&connection_ready_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool DegreeFlowServer::Listen(const char* socket_path, string* error) {
+  if (wake_up_pipe_[0] < 0) {
+    *error = "Could not create the wake-up pipe.";
+    return false;
+  }
+  if (!workers_started_) {
+    *error = "Could not start the worker threads.";
+    return false;
+  }
+  sockaddr_un address;
+  if (!SetSocketPath(socket_path, &address, error)) {
+    return false;
+  }
+  listen_socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_socket_ < 0) {
+    *error = string("Could not create a socket: ") + strerror(errno);
+    return false;
+  }
+  unlink(socket_path);
+  if (bind(listen_socket_, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) != 0
+      || listen(listen_socket_, kListenBacklog) != 0) {
+    *error = string("Could not listen on ") + socket_path + ": "
+             + strerror(errno);
+    close(listen_socket_);
+    listen_socket_ = -1;
+    return false;
+  }
+  socket_path_ = socket_path;
+  return true;
+}
+
+void DegreeFlowServer::Run() {
+  vector<pollfd> poll_fds;
+  vector<int> still_idle_connections;
+  while (true) {
+    pthread_mutex_lock(&mutex_);
+    idle_connections_.insert(idle_connections_.end(),
+                             returned_connections_.begin(),
+                             returned_connections_.end());
+    returned_connections_.clear();
+    bool shutting_down = shutting_down_;
+    bool all_served = ready_connections_.empty() && num_busy_workers_ == 0;
+    pthread_mutex_unlock(&mutex_);
+    if (shutting_down && all_served) {
+      break;
+    }
+
+    // While shutting down, only wait for the busy workers.
+    poll_fds.clear();
+    pollfd poll_fd;
+    poll_fd.fd = wake_up_pipe_[0];
+    poll_fd.events = POLLIN;
+    poll_fds.push_back(poll_fd);
+    if (!shutting_down) {
+      poll_fd.fd = listen_socket_;
+      poll_fds.push_back(poll_fd);
+      for (size_t ii = 0; ii < idle_connections_.size(); ++ii) {
+        poll_fd.fd = idle_connections_[ii];
+        poll_fds.push_back(poll_fd);
+      }
+    }
+    if (poll(&poll_fds[0], poll_fds.size(), -1) < 0) {
+      if (errno != EINTR) {
+        WriteToStderr("Could not poll the connections, shutting down.\n");
+        Shutdown();
+      }
+      continue;
+    }
+    if (poll_fds[0].revents != 0) {
+      char buffer[64];
+      while (read(wake_up_pipe_[0], buffer, sizeof(buffer)) > 0) { }
+    }
+    if (shutting_down) {
+      continue;
+    }
+
+    // A connection with an incoming request (or a closed connection) goes to
+    // the workers.
+    still_idle_connections.clear();
+    pthread_mutex_lock(&mutex_);
+    for (size_t ii = 0; ii < idle_connections_.size(); ++ii) {
+      if (poll_fds[ii + 2].revents != 0) {
+        ready_connections_.push_back(idle_connections_[ii]);
+        pthread_cond_signal(&connection_ready_);
+      } else {
+        still_idle_connections.push_back(idle_connections_[ii]);
+      }
+    }
+    pthread_mutex_unlock(&mutex_);
+    idle_connections_.swap(still_idle_connections);
+
+    if (poll_fds[1].revents != 0) {
+      int connection = accept(listen_socket_, NULL, NULL);
+      if (connection >= 0) {
+        // Idle connections are only polled, so the timeout only limits how
+        // long a worker waits for the rest of a request.
+        timeval timeout;
+        timeout.tv_sec = kConnectionTimeout;
+        timeout.tv_usec = 0;
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout));
+        setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                   sizeof(timeout));
+        idle_connections_.push_back(connection);
+      } else if (errno != EINTR && errno != ECONNABORTED) {
+        WriteToStderr("Could not accept a connection, shutting down.\n");
+        Shutdown();
+      }
+    }
+  }
+
+  for (size_t ii = 0; ii < idle_connections_.size(); ++ii) {
+    close(idle_connections_[ii]);
+  }
+  idle_connections_.clear();
+  StopWorkers();
+}
+
+void DegreeFlowServer::Shutdown() {
+  pthread_mutex_lock(&mutex_);
+  shutting_down_ = true;
+  pthread_cond_broadcast(&connection_ready_);
+  pthread_mutex_unlock(&mutex_);
+  WakeUp();
+}
+
+void DegreeFlowServer::WakeUp() {
+  char byte = 0;
+  // The pipe is non-blocking. If it is full, Run wakes up anyway.
+  if (write(wake_up_pipe_[1], &byte, 1) < 0) { }
+}
+
+void DegreeFlowServer::StopWorkers() {
+  for (size_t ii = 0; ii < workers_.size(); ++ii) {
+    pthread_join(workers_[ii]->thread, NULL);
+    delete workers_[ii];
+  }
+  workers_.clear();
+}
+
+void* DegreeFlowServer::WorkerMain(void* worker_pointer) {
+  Worker* worker = static_cast<Worker*>(worker_pointer);
+  DegreeFlowServer* server = worker->server;
+  while (true) {
+    pthread_mutex_lock(&server->mutex_);
+    while (server->ready_connections_.empty() && !server->shutting_down_) {
+      pthread_cond_wait(&server->connection_ready_, &server->mutex_);
+    }
+    if (server->ready_connections_.empty()) {
+      pthread_mutex_unlock(&server->mutex_);
+      return NULL;
+    }
+    int connection = server->ready_connections_.front();
+    server->ready_connections_.pop_front();
+    server->num_busy_workers_ += 1;
+    pthread_mutex_unlock(&server->mutex_);
+
+    bool keep_connection = server->ServeRequest(worker, connection);
+    if (!keep_connection) {
+      close(connection);
+    }
+    pthread_mutex_lock(&server->mutex_);
+    server->num_busy_workers_ -= 1;
+    if (keep_connection) {
+      server->returned_connections_.push_back(connection);
+    }
+    pthread_mutex_unlock(&server->mutex_);
+    server->WakeUp();
+  }
+}
+
+bool DegreeFlowServer::ServeRequest(Worker* worker, int connection) {
+  RequestHeader header;
+  if (!ReadAll(connection, &header, sizeof(header))) {
+    return false;
+  }
+  DegreeFlowResponse response;
+  response.worker = worker->index;
+  if (memcmp(header.magic, kRequestMagic, sizeof(kRequestMagic)) != 0
+      || header.type > kDegreeFlowShutdownRequest
+      || header.payload_size > kMaxPayloadSize) {
+    SendError(connection, &response, "Malformed request.");
+    return false;
+  }
+  if (!ReadPayload(connection, header.payload_size, &worker->payload)) {
+    return false;
+  }
+
+  if (header.type == kDegreeFlowShutdownRequest) {
+    Shutdown();
+    response.status = kDegreeFlowRequestSucceeded;
+    worker->response_payload.clear();
+    return SendResponse(connection, response, worker->response_payload);
+  }
+
+  double load_start_time = WallTime();
+  DegreeFlowProblemFile problem;
+  string error;
+  bool loaded = false;
+  if (header.type == kDegreeFlowInlineRequest) {
+    loaded = problem.OpenBuffer(&worker->payload[0], worker->payload.size(),
+                                &error);
+  } else {
+    string path(worker->payload.begin(), worker->payload.end());
+    loaded = problem.Open(path.c_str(), &error);
+  }
+  if (!loaded) {
+    return SendError(connection, &response, error);
+  }
+  int k = problem.k();
+  problem.GetDegrees(&worker->row_degrees, &worker->col_degrees);
+  response.load_time = WallTime() - load_start_time;
+
+  // The amplitudes are solved in place in the payload or the mapping, which
+  // stays open until the solve is done.
+  double solve_start_time = WallTime();
+  bool solved;
+  if (problem.data_type() == kDegreeFlowFloat32) {
+    solved = worker->solver.Solve(problem.MatrixView<float>(), k,
+                                  worker->row_degrees, worker->col_degrees,
+                                  DegreeFlowOptions(), false, WriteToStderr,
+                                  &worker->support, NULL);
+  } else {
+    solved = worker->solver.Solve(problem.MatrixView<double>(), k,
+                                  worker->row_degrees, worker->col_degrees,
+                                  DegreeFlowOptions(), false, WriteToStderr,
+                                  &worker->support, NULL);
+  }
+  response.solve_time = WallTime() - solve_start_time;
+  if (!solved) {
+    return SendError(connection, &response, "The solver rejected the "
+                     "problem (see the server output).");
+  }
+
+  for (size_t ii = 0; ii < worker->support.size(); ++ii) {
+    size_t row = worker->support[ii].first;
+    size_t col = worker->support[ii].second;
+    if (problem.data_type() == kDegreeFlowFloat32) {
+      response.objective += abs(problem.MatrixView<float>()(row, col));
+    } else {
+      response.objective += abs(problem.MatrixView<double>()(row, col));
+    }
+  }
+  problem.Close();
+  response.status = kDegreeFlowRequestSucceeded;
+  EncodeDegreeFlowSupport(worker->support, &worker->response_payload);
+  return SendResponse(connection, response, worker->response_payload);
+}
+
+int ConnectToDegreeFlowServer(const char* socket_path, string* error) {
+  sockaddr_un address;
+  if (!SetSocketPath(socket_path, &address, error)) {
+    return -1;
+  }
+  int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connection < 0) {
+    *error = string("Could not create a socket: ") + strerror(errno);
+    return -1;
+  }
+  if (connect(connection, reinterpret_cast<sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    *error = string("Could not connect to ") + socket_path + ": "
+             + strerror(errno);
+    close(connection);
+    return -1;
+  }
+  return connection;
+}
+
+bool SendDegreeFlowRequest(int connection, DegreeFlowRequestType type,
+                           const char* payload, size_t payload_size) {
+  RequestHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kRequestMagic, sizeof(kRequestMagic));
+  header.type = type;
+  header.payload_size = payload_size;
+  return WriteAll(connection, &header, sizeof(header))
+      && (payload_size == 0 || WriteAll(connection, payload, payload_size));
+}
+
+bool ReceiveDegreeFlowResponse(int connection, DegreeFlowResponse* response) {
+  ResponseHeader header;
+  if (!ReadAll(connection, &header, sizeof(header))
+      || memcmp(header.magic, kResponseMagic, sizeof(kResponseMagic)) != 0
+      || header.payload_size > kMaxPayloadSize) {
+    return false;
+  }
+  vector<char> payload;
+  if (!ReadPayload(connection, header.payload_size, &payload)) {
+    return false;
+  }
+  response->status = static_cast<DegreeFlowResponseStatus>(header.status);
+  response->worker = header.worker;
+  response->load_time = header.load_time;
+  response->solve_time = header.solve_time;
+  response->objective = header.objective;
+  response->support.clear();
+  response->error.clear();
+  if (response->status == kDegreeFlowRequestFailed) {
+    response->error.assign(payload.begin(), payload.end());
+    return true;
+  }
+  return payload.empty()
+      || DecodeDegreeFlowSupport(&payload[0], payload.size(),
+                                 &response->support);
+}
@@ -0,0 +1,140 @@
+#ifndef __DEGREE_FLOW_SERVER_H__
+#define __DEGREE_FLOW_SERVER_H__
+
+#include <cstddef>
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+
+#include "degree_flow.h"
+
+// Projection server on a Unix domain socket.
+//
+// A client sends any number of requests over one connection and reads one
+// response per request. A request is a 24 byte header (the magic string
+// "DEGFLOWQ", the request type as uint32, four bytes of padding and the
+// payload size as uint64) followed by the payload:
+//
+//   - kDegreeFlowInlineRequest: the contents of a problem file (see
+//     degree_flow_io.h),
+//   - kDegreeFlowFileRequest: the path of a problem file, which the server
+//     maps,
+//   - kDegreeFlowShutdownRequest: no payload. The server stops (see
+//     DegreeFlowServer::Run).
+//
+// A response is a 48 byte header (the magic string "DEGFLOWA", the status as
+// uint32, the index of the worker as int32, the time spent loading the
+// problem, the time spent solving it, the objective value of the support as
+// doubles and the payload size as uint64) followed by the support in the
+// encoding of EncodeDegreeFlowSupport, or by an error message if the status
+// is kDegreeFlowRequestFailed.
+
+enum DegreeFlowRequestType {
+  kDegreeFlowInlineRequest = 0,
+  kDegreeFlowFileRequest = 1,
+  kDegreeFlowShutdownRequest = 2,
+};
+
+enum DegreeFlowResponseStatus {
+  kDegreeFlowRequestSucceeded = 0,
+  kDegreeFlowRequestFailed = 1,
+};
+
+struct DegreeFlowResponse {
+  DegreeFlowResponseStatus status;
+  // Worker thread that solved the request
+  int worker;
+  // Time spent reading the problem from the request or the mapped file (in
+  // seconds)
+  double load_time;
+  // Time spent in DegreeFlowSolver::Solve (in seconds)
+  double solve_time;
+  // Sum of the absolute values of the amplitudes in the support
+  double objective;
+  // (row, column) indices of the support in row-major order
+  std::vector<std::pair<uint32_t, uint32_t> > support;
+  // Set if status is kDegreeFlowRequestFailed
+  std::string error;
+
+  DegreeFlowResponse() : status(kDegreeFlowRequestFailed), worker(-1),
+                         load_time(0.0), solve_time(0.0), objective(0.0) { }
+};
+
+// Serves requests on a pool of worker threads. Run polls the open
+// connections and hands every connection with an incoming request to the
+// next free worker, which serves that one request. So requests from many
+// connections share the workers fairly, and idle connections do not block a
+// worker. The amplitudes are solved in place in the request payload or the
+// mapped problem file. Each worker keeps its DegreeFlowSolver and its
+// buffers between requests, so repeated requests of similar size do not
+// allocate. A worker closes a connection that stalls for 30 seconds in the
+// middle of a request or response.
+class DegreeFlowServer {
+ public:
+  explicit DegreeFlowServer(int num_threads);
+  ~DegreeFlowServer();
+
+  // Creates the socket. An existing socket file at socket_path is replaced.
+  // Fails if the constructor could not start all worker threads.
+  bool Listen(const char* socket_path, std::string* error);
+  // Serves requests until a shutdown request arrives or Shutdown is called.
+  // Requests that are being served are completed, then all connections are
+  // closed.
+  void Run();
+  // Can be called from any thread.
+  void Shutdown();
+
+ private:
+  struct Worker {
+    DegreeFlowServer* server;
+    int index;
+    pthread_t thread;
+    DegreeFlowSolver solver;
+    std::vector<int> row_degrees;
+    std::vector<int> col_degrees;
+    std::vector<std::pair<uint32_t, uint32_t> > support;
+    std::vector<char> payload;
+    std::vector<char> response_payload;
+  };
+
+  static void* WorkerMain(void* worker);
+  // Returns false if the connection has to be closed.
+  bool ServeRequest(Worker* worker, int connection);
+  void WakeUp();
+  void StopWorkers();
+
+  std::string socket_path_;
+  int listen_socket_;
+  // Workers write to the pipe to wake up the poll in Run.
+  int wake_up_pipe_[2];
+  std::vector<Worker*> workers_;
+  // Connections without a pending request (only used by Run)
+  std::vector<int> idle_connections_;
+
+  pthread_mutex_t mutex_;
+  pthread_cond_t connection_ready_;
+  // Connections with a pending request that wait for a worker
+  std::deque<int> ready_connections_;
+  // Connections whose request has been served, to be polled again
+  std::vector<int> returned_connections_;
+  int num_busy_workers_;
+  bool shutting_down_;
+  // Set if the threads of all workers started
+  bool workers_started_;
+
+  DegreeFlowServer(const DegreeFlowServer&);
+  DegreeFlowServer& operator=(const DegreeFlowServer&);
+};
+
+// Client side of the protocol. The functions return false if the connection
+// fails.
+int ConnectToDegreeFlowServer(const char* socket_path, std::string* error);
+bool SendDegreeFlowRequest(int connection, DegreeFlowRequestType type,
+                           const char* payload, size_t payload_size);
+bool ReceiveDegreeFlowResponse(int connection, DegreeFlowResponse* response);
+
+#endif
@@ -0,0 +1,151 @@
+#include "degree_flow_server.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "degree_flow_io.h"
+#include "gtest/gtest.h"
+
+using namespace std;
+
+void WriteToStderr(const char* s) {
+  fprintf(stderr, "%s", s);
+  fflush(stderr);
+}
+
+void* RunServer(void* server) {
+  static_cast<DegreeFlowServer*>(server)->Run();
+  return NULL;
+}
+
+void RandomMatrix(int r, int c, unsigned int seed,
+                  vector<vector<double> >* x) {
+  srand(seed);
+  x->resize(r);
+  for (int ii = 0; ii < r; ++ii) {
+    (*x)[ii].resize(c);
+    for (int jj = 0; jj < c; ++jj) {
+      (*x)[ii][jj] = static_cast<double>(rand()) / RAND_MAX;
+    }
+  }
+}
+
+void SupportIndices(const vector<vector<bool> >& support,
+                    vector<pair<uint32_t, uint32_t> >* indices) {
+  indices->clear();
+  for (size_t row = 0; row < support.size(); ++row) {
+    for (size_t col = 0; col < support[row].size(); ++col) {
+      if (support[row][col]) {
+        indices->push_back(make_pair(row, col));
+      }
+    }
+  }
+}
+
+TEST(DegreeFlowServerTest, InlineAndFileRequests) {
+  char socket_path[] = "/tmp/degree_flow_server_test_XXXXXX";
+  int fd = mkstemp(socket_path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  char problem_path[] = "/tmp/degree_flow_server_test_XXXXXX";
+  fd = mkstemp(problem_path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  DegreeFlowServer server(2);
+  string error;
+  ASSERT_TRUE(server.Listen(socket_path, &error)) << error;
+  pthread_t server_thread;
+  pthread_create(&server_thread, NULL, RunServer, &server);
+
+  int connection = ConnectToDegreeFlowServer(socket_path, &error);
+  ASSERT_GE(connection, 0) << error;
+  DegreeFlowSolver solver;
+  vector<vector<bool> > expected_support;
+  vector<pair<uint32_t, uint32_t> > expected_indices;
+  DegreeFlowResponse response;
+  for (int ii = 0; ii < 4; ++ii) {
+    int r = 10 + 5 * ii;
+    int c = 30 - 5 * ii;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, ii + 1, &x);
+    vector<int> row_degrees(r, 2);
+    vector<int> col_degrees(c, 1);
+    int k = 12;
+    solver.Solve(x, k, row_degrees, col_degrees, DegreeFlowOptions(), false,
+                 WriteToStderr, &expected_support);
+    SupportIndices(expected_support, &expected_indices);
+
+    // Even requests are inline, odd requests send the path of a problem
+    // file.
+    vector<char> payload;
+    ASSERT_TRUE(EncodeDegreeFlowProblem(x, k, row_degrees, col_degrees,
+                                        kDegreeFlowFloat64,
+                                        kDegreeFlowRowMajor, &payload,
+                                        &error));
+    if (ii % 2 == 0) {
+      ASSERT_TRUE(SendDegreeFlowRequest(connection, kDegreeFlowInlineRequest,
+                                        &payload[0], payload.size()));
+    } else {
+      ASSERT_TRUE(WriteDegreeFlowProblemFile(problem_path, x, k, row_degrees,
+                                             col_degrees, kDegreeFlowFloat64,
+                                             kDegreeFlowColumnMajor, &error));
+      string path(problem_path);
+      ASSERT_TRUE(SendDegreeFlowRequest(connection, kDegreeFlowFileRequest,
+                                        path.c_str(), path.size()));
+    }
+    ASSERT_TRUE(ReceiveDegreeFlowResponse(connection, &response));
+    EXPECT_EQ(kDegreeFlowRequestSucceeded, response.status) << response.error;
+    EXPECT_EQ(expected_indices, response.support);
+    double objective = 0.0;
+    for (size_t jj = 0; jj < expected_indices.size(); ++jj) {
+      objective += x[expected_indices[jj].first][expected_indices[jj].second];
+    }
+    EXPECT_NEAR(objective, response.objective, 1e-9);
+  }
+
+  // A missing file fails the request, but not the connection.
+  string missing_path("/nonexistent/problem");
+  ASSERT_TRUE(SendDegreeFlowRequest(connection, kDegreeFlowFileRequest,
+                                    missing_path.c_str(),
+                                    missing_path.size()));
+  ASSERT_TRUE(ReceiveDegreeFlowResponse(connection, &response));
+  EXPECT_EQ(kDegreeFlowRequestFailed, response.status);
+  EXPECT_FALSE(response.error.empty());
+
+  // A client that announces a large payload and then closes the connection
+  // does not affect the other connections.
+  int truncated_connection = ConnectToDegreeFlowServer(socket_path, &error);
+  ASSERT_GE(truncated_connection, 0) << error;
+  char header[24] = {'D', 'E', 'G', 'F', 'L', 'O', 'W', 'Q'};
+  uint64_t payload_size = 1ULL << 31;
+  memcpy(&header[16], &payload_size, sizeof(payload_size));
+  ASSERT_EQ(24, write(truncated_connection, header, sizeof(header)));
+  ASSERT_EQ(4, write(truncated_connection, header, 4));
+  close(truncated_connection);
+  ASSERT_TRUE(SendDegreeFlowRequest(connection, kDegreeFlowFileRequest,
+                                    missing_path.c_str(),
+                                    missing_path.size()));
+  ASSERT_TRUE(ReceiveDegreeFlowResponse(connection, &response));
+  EXPECT_EQ(kDegreeFlowRequestFailed, response.status);
+
+  ASSERT_TRUE(SendDegreeFlowRequest(connection, kDegreeFlowShutdownRequest,
+                                    NULL, 0));
+  ASSERT_TRUE(ReceiveDegreeFlowResponse(connection, &response));
+  EXPECT_EQ(kDegreeFlowRequestSucceeded, response.status);
+  close(connection);
+  pthread_join(server_thread, NULL);
+  unlink(problem_path);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
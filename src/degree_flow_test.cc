@@ -1,8 +1,15 @@
 #include "degree_flow.h"
+#include "degree_flow_verify.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <string>
 #include <vector>
 
+#include <pthread.h>
+
 #include "boost/assign/list_of.hpp"
 #include "gtest/gtest.h"
 
@@ -45,6 +52,74 @@ void run_degree_flow(const vector<vector<double> >& x,
   vector<vector<bool> > result;
   degree_flow(x, k, row_degrees, col_degrees, true, WriteToStderr, &result);
   CheckResult(expected_result, result);
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result, result);
+  options.engine = DegreeFlowOptions::kDenseEngine;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result, result);
+  options.blocking_flow = true;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result, result);
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result, result);
+}
+
+void RandomMatrix(int r, int c, unsigned int seed,
+                  vector<vector<double> >* x) {
+  srand(seed);
+  x->resize(r);
+  for (int ii = 0; ii < r; ++ii) {
+    (*x)[ii].resize(c);
+    for (int jj = 0; jj < c; ++jj) {
+      (*x)[ii][jj] = static_cast<double>(rand()) / RAND_MAX - 0.5;
+    }
+  }
+}
+
+void RandomDegrees(int n, int max_degree, vector<int>* degrees) {
+  degrees->resize(n);
+  for (int ii = 0; ii < n; ++ii) {
+    (*degrees)[ii] = rand() % (max_degree + 1);
+  }
+}
+
+// Runs the given options on random instances with degrees up to max_degree
+// and compares the supports to the supports of the graph engine.
+void CompareWithGraphEngine(const DegreeFlowOptions& options,
+                            int max_degree = 3) {
+  DegreeFlowOptions graph_options;
+  graph_options.engine = DegreeFlowOptions::kGraphEngine;
+  DegreeFlowSolver graph_solver;
+  DegreeFlowSolver solver;
+  for (unsigned int seed = 1; seed <= 20; ++seed) {
+    int r = 1 + seed % 7 * 5;
+    int c = 1 + seed % 5 * 7;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, seed, &x);
+    vector<int> row_degrees;
+    RandomDegrees(r, max_degree, &row_degrees);
+    vector<int> col_degrees;
+    RandomDegrees(c, max_degree, &col_degrees);
+    int k = rand() % (r + c + 1);
+
+    vector<vector<bool> > expected_result;
+    graph_solver.Solve(x, k, row_degrees, col_degrees, graph_options, false,
+                       WriteToStderr, &expected_result);
+    vector<vector<bool> > result;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &result);
+    SCOPED_TRACE(seed);
+    CheckResult(expected_result, result);
+  }
 }
 
 TEST(DegreeFlowTest, SimpleSingleSelection) {
@@ -243,6 +318,1614 @@ TEST(DegreeFlowTest, NonSquare) {
   run_degree_flow(x, k, row_degrees, col_degrees, result);
 }
 
+TEST(DegreeFlowTest, RandomDenseEngine) {
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kDenseEngine;
+  CompareWithGraphEngine(options);
+}
+
+TEST(DegreeFlowTest, RandomLazyBinaryHeapQueue) {
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  options.queue = DegreeFlowOptions::kLazyBinaryHeapQueue;
+  CompareWithGraphEngine(options);
+}
+
+TEST(DegreeFlowTest, RandomRadixHeapQueue) {
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  options.queue = DegreeFlowOptions::kRadixHeapQueue;
+  CompareWithGraphEngine(options);
+}
+
+TEST(DegreeFlowTest, RandomBlockingFlow) {
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  options.blocking_flow = true;
+  CompareWithGraphEngine(options);
+}
+
+TEST(DegreeFlowTest, RandomDenseEngineBlockingFlow) {
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kDenseEngine;
+  options.blocking_flow = true;
+  CompareWithGraphEngine(options);
+}
+
+TEST(DegreeFlowTest, RandomAssignmentEngine) {
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kAssignmentEngine;
+  CompareWithGraphEngine(options, 1);
+  // The automatic selection uses the assignment engine for these degrees.
+  CompareWithGraphEngine(DegreeFlowOptions(), 1);
+  // The assignment engine does not use the blocking flow.
+  options.blocking_flow = true;
+  CompareWithGraphEngine(options, 1);
+}
+
+TEST(DegreeFlowTest, RandomCostScalingEngine) {
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kCostScalingEngine;
+  CompareWithGraphEngine(options);
+  CompareWithGraphEngine(options, 1);
+}
+
+double Objective(const vector<vector<double> >& x,
+                 const vector<vector<bool> >& support) {
+  double objective = 0.0;
+  for (size_t ii = 0; ii < x.size(); ++ii) {
+    for (size_t jj = 0; jj < x[ii].size(); ++jj) {
+      if (support[ii][jj]) {
+        objective += abs(x[ii][jj]);
+      }
+    }
+  }
+  return objective;
+}
+
+// The quantized supports must be within the reported loss bound of the
+// optimum, for all engines.
+TEST(DegreeFlowTest, RandomQuantization) {
+  DegreeFlowSolver solver;
+  for (unsigned int seed = 1; seed <= 20; ++seed) {
+    int r = 1 + seed % 7 * 5;
+    int c = 1 + seed % 5 * 7;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, seed, &x);
+    vector<int> row_degrees;
+    RandomDegrees(r, 3, &row_degrees);
+    vector<int> col_degrees;
+    RandomDegrees(c, 3, &col_degrees);
+    int k = rand() % (r + c + 1);
+    SCOPED_TRACE(seed);
+
+    DegreeFlowOptions options;
+    vector<vector<bool> > result;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &result);
+    double optimum = Objective(x, result);
+
+    options.quantization_precision = 0.01 * (seed % 3 + 1);
+    for (int engine = 0; engine < 2; ++engine) {
+      options.engine = (engine == 0 ? DegreeFlowOptions::kGraphEngine
+                                    : DegreeFlowOptions::kDenseEngine);
+      solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                   WriteToStderr, &result);
+      double bound = solver.quantization_loss_bound();
+      EXPECT_GE(bound, 0.0);
+      EXPECT_LE(bound, k * options.quantization_precision);
+      EXPECT_GE(Objective(x, result), optimum - bound - 1e-9);
+    }
+  }
+}
+
+// Integer amplitudes are quantized without loss at precision 1, so the
+// bucket queue must find the same objective as the graph engine.
+TEST(DegreeFlowTest, RandomIntegerBucketQueue) {
+  DegreeFlowSolver solver;
+  for (unsigned int seed = 1; seed <= 20; ++seed) {
+    int r = 1 + seed % 7 * 5;
+    int c = 1 + seed % 5 * 7;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, seed, &x);
+    for (int ii = 0; ii < r; ++ii) {
+      for (int jj = 0; jj < c; ++jj) {
+        x[ii][jj] = floor(100 * x[ii][jj]);
+      }
+    }
+    vector<int> row_degrees;
+    RandomDegrees(r, 3, &row_degrees);
+    vector<int> col_degrees;
+    RandomDegrees(c, 3, &col_degrees);
+    int k = rand() % (r + c + 1);
+    SCOPED_TRACE(seed);
+
+    DegreeFlowOptions options;
+    options.engine = DegreeFlowOptions::kGraphEngine;
+    vector<vector<bool> > expected_result;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &expected_result);
+    options.quantization_precision = 1.0;
+    vector<vector<bool> > result;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &result);
+    EXPECT_EQ(0.0, solver.quantization_loss_bound());
+    EXPECT_EQ(Objective(x, expected_result), Objective(x, result));
+  }
+}
+
+// With many ties, the blocking flow can return a different support, but the
+// support must have the same size and objective value.
+TEST(DegreeFlowTest, BlockingFlowWithTies) {
+  vector<vector<double> > x;
+  RandomMatrix(30, 40, 1, &x);
+  for (size_t ii = 0; ii < x.size(); ++ii) {
+    for (size_t jj = 0; jj < x[ii].size(); ++jj) {
+      x[ii][jj] = static_cast<int>(10 * x[ii][jj]);
+    }
+  }
+  vector<int> row_degrees(30, 3);
+  vector<int> col_degrees(40, 2);
+  int k = 70;
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  vector<vector<bool> > expected_result;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &expected_result);
+
+  options.blocking_flow = true;
+  for (int engine = DegreeFlowOptions::kGraphEngine;
+       engine <= DegreeFlowOptions::kDenseEngine; ++engine) {
+    options.engine = static_cast<DegreeFlowOptions::Engine>(engine);
+    vector<vector<bool> > result;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &result);
+    int expected_size = 0;
+    int size = 0;
+    double expected_objective = 0.0;
+    double objective = 0.0;
+    for (size_t ii = 0; ii < x.size(); ++ii) {
+      for (size_t jj = 0; jj < x[ii].size(); ++jj) {
+        if (expected_result[ii][jj]) {
+          expected_size += 1;
+          expected_objective += abs(x[ii][jj]);
+        }
+        if (result[ii][jj]) {
+          size += 1;
+          objective += abs(x[ii][jj]);
+        }
+      }
+    }
+    EXPECT_EQ(expected_size, size);
+    EXPECT_DOUBLE_EQ(expected_objective, objective);
+  }
+}
+
+// With a single candidate per row and column, most instances need several
+// rounds of candidate expansion.
+TEST(DegreeFlowTest, RandomCandidatePruning) {
+  DegreeFlowOptions options;
+  options.pruning_candidates = 1;
+  CompareWithGraphEngine(options);
+  options.pruning_candidates = 4;
+  CompareWithGraphEngine(options);
+}
+
+// The candidates (0, 0), (2, 1), and (2, 2) only fit two entries, but the
+// full matrix fits three.
+TEST(DegreeFlowTest, CandidatePruningExpandsReachableEntries) {
+  vector<vector<double> > x;
+  x.push_back(list_of(9)(1)(1));
+  x.push_back(list_of(1)(9)(1));
+  x.push_back(list_of(1)(2)(9));
+  vector<int> row_degrees = list_of(2)(0)(1);
+  vector<int> col_degrees = list_of(1)(1)(1);
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.pruning_candidates = 1;
+  vector<vector<bool> > result;
+  solver.Solve(x, 3, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+
+  vector<vector<bool> > expected_result;
+  expected_result.push_back(list_of(1)(1)(0));
+  expected_result.push_back(list_of(0)(0)(0));
+  expected_result.push_back(list_of(0)(0)(1));
+  CheckResult(expected_result, result);
+}
+
+TEST(DegreeFlowTest, RandomAutomaticEngine) {
+  CompareWithGraphEngine(DegreeFlowOptions());
+}
+
+// The supports in the solution path must agree with separate solves.
+TEST(DegreeFlowTest, SolutionPath) {
+  vector<vector<double> > x;
+  RandomMatrix(15, 20, 3, &x);
+  vector<int> row_degrees(15, 2);
+  vector<int> col_degrees(20, 2);
+  int k = 25;
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  for (int engine = DegreeFlowOptions::kGraphEngine;
+       engine <= DegreeFlowOptions::kDenseEngine; ++engine) {
+    for (int blocking_flow = 0; blocking_flow <= 1; ++blocking_flow) {
+      options.engine = static_cast<DegreeFlowOptions::Engine>(engine);
+      options.blocking_flow = blocking_flow;
+      SCOPED_TRACE(engine);
+      SCOPED_TRACE(blocking_flow);
+
+      DegreeFlowSolutionPath path;
+      vector<vector<bool> > result;
+      solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                   WriteToStderr, &result, &path);
+      ASSERT_EQ(k, path.max_k());
+      vector<vector<bool> > path_support;
+      path.GetSupport(k, &path_support);
+      CheckResult(result, path_support);
+
+      for (int kk = 1; kk < k; ++kk) {
+        solver.Solve(x, kk, row_degrees, col_degrees, options, false,
+                     WriteToStderr, &result);
+        path.GetSupport(kk, &path_support);
+        CheckResult(result, path_support);
+
+        double objective = 0.0;
+        for (size_t ii = 0; ii < x.size(); ++ii) {
+          for (size_t jj = 0; jj < x[ii].size(); ++jj) {
+            if (result[ii][jj]) {
+              objective += abs(x[ii][jj]);
+            }
+          }
+        }
+        EXPECT_NEAR(objective, path.objective[kk - 1], 1e-9);
+      }
+    }
+  }
+}
+
+// Copies x into a buffer with the given strides and returns the view.
+DegreeFlowMatrixView<const double> StridedCopy(
+    const vector<vector<double> >& x, size_t row_stride, size_t col_stride,
+    vector<double>* buffer) {
+  size_t r = x.size();
+  size_t c = x[0].size();
+  buffer->assign((r - 1) * row_stride + (c - 1) * col_stride + 1, 0.0);
+  for (size_t ii = 0; ii < r; ++ii) {
+    for (size_t jj = 0; jj < c; ++jj) {
+      (*buffer)[ii * row_stride + jj * col_stride] = x[ii][jj];
+    }
+  }
+  return DegreeFlowMatrixView<const double>(&(*buffer)[0], r, c, row_stride,
+                                            col_stride);
+}
+
+void MaskToMatrix(const vector<uint8_t>& mask, size_t r, size_t c,
+                  vector<vector<bool> >* result) {
+  result->assign(r, vector<bool>(c, false));
+  for (size_t ii = 0; ii < r; ++ii) {
+    for (size_t jj = 0; jj < c; ++jj) {
+      (*result)[ii][jj] = (mask[ii * c + jj] != 0);
+    }
+  }
+}
+
+// Row-major, column-major (solved as the transpose) and general strided
+// views must give the same supports as the vector interface.
+TEST(DegreeFlowTest, RandomMatrixViews) {
+  DegreeFlowSolver solver;
+  DegreeFlowSolver view_solver;
+  for (int engine = DegreeFlowOptions::kGraphEngine;
+       engine <= DegreeFlowOptions::kDenseEngine; ++engine) {
+    DegreeFlowOptions options;
+    options.engine = static_cast<DegreeFlowOptions::Engine>(engine);
+    for (unsigned int seed = 1; seed <= 10; ++seed) {
+      int r = 1 + seed % 7 * 5;
+      int c = 1 + seed % 5 * 7;
+      vector<vector<double> > x;
+      RandomMatrix(r, c, seed, &x);
+      vector<int> row_degrees;
+      RandomDegrees(r, 3, &row_degrees);
+      vector<int> col_degrees;
+      RandomDegrees(c, 3, &col_degrees);
+      int k = rand() % (r + c + 1);
+      vector<vector<bool> > expected_result;
+      solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                   WriteToStderr, &expected_result);
+
+      const size_t strides[3][2] = {{static_cast<size_t>(c), 1},
+                                    {1, static_cast<size_t>(r)},
+                                    {2 * static_cast<size_t>(c) + 1, 2}};
+      for (int layout = 0; layout < 3; ++layout) {
+        vector<double> buffer;
+        DegreeFlowMatrixView<const double> view =
+            StridedCopy(x, strides[layout][0], strides[layout][1], &buffer);
+        vector<uint8_t> mask(r * c, 2);
+        ASSERT_TRUE(view_solver.Solve(view, k, row_degrees, col_degrees,
+            options, false, WriteToStderr,
+            DegreeFlowMatrixView<uint8_t>::RowMajor(&mask[0], r, c), NULL));
+        vector<vector<bool> > result;
+        MaskToMatrix(mask, r, c, &result);
+        SCOPED_TRACE(engine);
+        SCOPED_TRACE(seed);
+        SCOPED_TRACE(layout);
+        CheckResult(expected_result, result);
+      }
+    }
+  }
+}
+
+// Solves x, stored as T in a larger array with the given leading dimension,
+// and returns the support as an index list and as a mask.
+template <typename T>
+void SolveFlat(const vector<vector<double> >& x, bool column_major,
+               size_t leading_dimension, int k, const vector<int>& row_degrees,
+               const vector<int>& col_degrees, DegreeFlowSolver* solver,
+               vector<pair<uint32_t, uint32_t> >* indices,
+               vector<vector<bool> >* result) {
+  size_t r = x.size();
+  size_t c = x[0].size();
+  vector<T> buffer(leading_dimension * (column_major ? c : r), 0);
+  DegreeFlowMatrixView<T> view = column_major
+      ? DegreeFlowMatrixView<T>::ColumnMajor(&buffer[0], r, c,
+                                             leading_dimension)
+      : DegreeFlowMatrixView<T>::RowMajor(&buffer[0], r, c,
+                                          leading_dimension);
+  for (size_t ii = 0; ii < r; ++ii) {
+    for (size_t jj = 0; jj < c; ++jj) {
+      view(ii, jj) = x[ii][jj];
+    }
+  }
+  DegreeFlowMatrixView<const T> const_view(view.data, r, c, view.row_stride,
+                                           view.col_stride);
+  ASSERT_TRUE(solver->Solve(const_view, k, row_degrees, col_degrees,
+                            DegreeFlowOptions(), false, WriteToStderr,
+                            indices, NULL));
+  vector<uint8_t> mask(r * c);
+  ASSERT_TRUE(solver->Solve(const_view, k, row_degrees, col_degrees,
+      DegreeFlowOptions(), false, WriteToStderr,
+      DegreeFlowMatrixView<uint8_t>::RowMajor(&mask[0], r, c), NULL));
+  MaskToMatrix(mask, r, c, result);
+}
+
+// Float and double arrays in both layouts with padding between the rows
+// (columns) must give the support of the vector interface, and the index
+// list must list the support in row-major order.
+TEST(DegreeFlowTest, RandomFlatMatrices) {
+  DegreeFlowSolver solver;
+  DegreeFlowSolver flat_solver;
+  for (unsigned int seed = 1; seed <= 10; ++seed) {
+    int r = 1 + seed % 7 * 5;
+    int c = 1 + seed % 5 * 7;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, seed, &x);
+    // Amplitudes that are exact in float
+    for (int ii = 0; ii < r; ++ii) {
+      for (int jj = 0; jj < c; ++jj) {
+        x[ii][jj] = static_cast<float>(x[ii][jj]);
+      }
+    }
+    vector<int> row_degrees;
+    RandomDegrees(r, 3, &row_degrees);
+    vector<int> col_degrees;
+    RandomDegrees(c, 3, &col_degrees);
+    int k = rand() % (r + c + 1);
+    vector<vector<bool> > expected_result;
+    solver.Solve(x, k, row_degrees, col_degrees, false, WriteToStderr,
+                 &expected_result);
+    vector<pair<uint32_t, uint32_t> > expected_indices;
+    for (int ii = 0; ii < r; ++ii) {
+      for (int jj = 0; jj < c; ++jj) {
+        if (expected_result[ii][jj]) {
+          expected_indices.push_back(make_pair(ii, jj));
+        }
+      }
+    }
+
+    for (int column_major = 0; column_major <= 1; ++column_major) {
+      size_t leading_dimension = (column_major ? r : c) + 3;
+      SCOPED_TRACE(seed);
+      SCOPED_TRACE(column_major);
+      vector<pair<uint32_t, uint32_t> > indices;
+      vector<vector<bool> > result;
+      SolveFlat<double>(x, column_major, leading_dimension, k, row_degrees,
+                        col_degrees, &flat_solver, &indices, &result);
+      EXPECT_EQ(expected_indices, indices);
+      CheckResult(expected_result, result);
+      SolveFlat<float>(x, column_major, leading_dimension, k, row_degrees,
+                       col_degrees, &flat_solver, &indices, &result);
+      EXPECT_EQ(expected_indices, indices);
+      CheckResult(expected_result, result);
+    }
+  }
+}
+
+// The solution path of a column-major view refers to the rows and columns
+// of the caller.
+TEST(DegreeFlowTest, ColumnMajorViewSolutionPath) {
+  vector<vector<double> > x;
+  RandomMatrix(8, 12, 5, &x);
+  vector<int> row_degrees(8, 2);
+  vector<int> col_degrees(12, 1);
+  int k = 10;
+
+  DegreeFlowSolver solver;
+  vector<vector<bool> > expected_result;
+  DegreeFlowSolutionPath expected_path;
+  solver.Solve(x, k, row_degrees, col_degrees, DegreeFlowOptions(), false,
+               WriteToStderr, &expected_result, &expected_path);
+
+  vector<double> buffer;
+  DegreeFlowMatrixView<const double> view = StridedCopy(x, 1, 8, &buffer);
+  vector<uint8_t> mask(8 * 12);
+  DegreeFlowSolutionPath path;
+  ASSERT_TRUE(solver.Solve(view, k, row_degrees, col_degrees,
+      DegreeFlowOptions(), false, WriteToStderr,
+      DegreeFlowMatrixView<uint8_t>::ColumnMajor(&mask[0], 8, 12), &path));
+  EXPECT_EQ(8u, path.num_rows);
+  EXPECT_EQ(12u, path.num_cols);
+  ASSERT_EQ(k, path.max_k());
+  for (int kk = 1; kk <= k; ++kk) {
+    vector<vector<bool> > expected_support;
+    expected_path.GetSupport(kk, &expected_support);
+    vector<vector<bool> > support;
+    path.GetSupport(kk, &support);
+    SCOPED_TRACE(kk);
+    CheckResult(expected_support, support);
+    EXPECT_NEAR(expected_path.objective[kk - 1], path.objective[kk - 1],
+                1e-9);
+  }
+  vector<vector<bool> > path_support;
+  path.GetSupport(k, &path_support);
+  for (size_t ii = 0; ii < 8; ++ii) {
+    for (size_t jj = 0; jj < 12; ++jj) {
+      EXPECT_EQ(path_support[ii][jj], mask[ii + 8 * jj] != 0);
+    }
+  }
+}
+
+TEST(DegreeFlowTest, InvalidMatrixView) {
+  vector<double> x(6, 1.0);
+  vector<uint8_t> mask(6, 1);
+  vector<int> degrees(3, 1);
+  DegreeFlowSolver solver;
+  EXPECT_FALSE(solver.Solve(
+      DegreeFlowMatrixView<const double>::RowMajor(&x[0], 2, 3), 2,
+      vector<int>(2, 1), degrees, DegreeFlowOptions(), false, WriteToStderr,
+      DegreeFlowMatrixView<uint8_t>::RowMajor(&mask[0], 3, 2), NULL));
+  EXPECT_FALSE(solver.Solve(
+      DegreeFlowMatrixView<const double>::RowMajor(&x[0], 0, 3), 2,
+      vector<int>(), degrees, DegreeFlowOptions(), false, WriteToStderr,
+      DegreeFlowMatrixView<uint8_t>::RowMajor(&mask[0], 0, 3), NULL));
+}
+
+void CheckSupportEntries(const vector<vector<double> >& x,
+                         const vector<vector<bool> >& expected_result,
+                         const DegreeFlowSupport& support) {
+  vector<vector<bool> > result;
+  support.GetMatrix(&result);
+  CheckResult(expected_result, result);
+  double objective = 0.0;
+  for (size_t ii = 0; ii < support.entries.size(); ++ii) {
+    const DegreeFlowSupport::Entry& entry = support.entries[ii];
+    EXPECT_EQ(x[entry.row][entry.col], entry.amplitude);
+    objective += abs(entry.amplitude);
+    if (ii > 0) {
+      const DegreeFlowSupport::Entry& previous = support.entries[ii - 1];
+      EXPECT_TRUE(previous.row < entry.row
+                  || (previous.row == entry.row && previous.col < entry.col));
+    }
+  }
+  EXPECT_NEAR(objective, support.objective, 1e-9);
+}
+
+// The entry list must describe the same support as the bool matrix for all
+// engines and modes, including warm starts, whose list is carried over from
+// the previous call.
+TEST(DegreeFlowTest, RandomSupportEntries) {
+  vector<DegreeFlowOptions> all_options(6);
+  all_options[0].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[1].engine = DegreeFlowOptions::kDenseEngine;
+  all_options[2].engine = DegreeFlowOptions::kDenseEngine;
+  all_options[2].blocking_flow = true;
+  all_options[3].pruning_candidates = 3;
+  all_options[4].quantization_precision = 0.01;
+  all_options[5].warm_start = true;
+  for (size_t ii = 0; ii < all_options.size(); ++ii) {
+    DegreeFlowSolver solver;
+    DegreeFlowSolver entry_solver;
+    for (unsigned int seed = 1; seed <= 10; ++seed) {
+      int r = 10 + seed % 3;
+      int c = 12;
+      vector<vector<double> > x;
+      RandomMatrix(r, c, seed % 3, &x);
+      for (int row = 0; row < r; ++row) {
+        x[row][seed % c] += 0.1 * seed;
+      }
+      vector<int> row_degrees(r, 2);
+      vector<int> col_degrees(c, 2);
+      int k = 3 * seed;
+
+      vector<vector<bool> > expected_result;
+      solver.Solve(x, k, row_degrees, col_degrees, all_options[ii], false,
+                   WriteToStderr, &expected_result);
+      DegreeFlowSupport support;
+      entry_solver.Solve(x, k, row_degrees, col_degrees, all_options[ii],
+                         false, WriteToStderr, &support, NULL);
+      SCOPED_TRACE(ii);
+      SCOPED_TRACE(seed);
+      EXPECT_EQ(static_cast<size_t>(r), support.num_rows);
+      EXPECT_EQ(static_cast<size_t>(c), support.num_cols);
+      CheckSupportEntries(x, expected_result, support);
+
+      // Column-major views are solved as the transpose.
+      if (all_options[ii].quantization_precision == 0.0) {
+        vector<double> buffer;
+        DegreeFlowMatrixView<const double> view =
+            StridedCopy(x, 1, r, &buffer);
+        ASSERT_TRUE(entry_solver.Solve(view, k, row_degrees, col_degrees,
+                                       all_options[ii], false, WriteToStderr,
+                                       &support, NULL));
+        EXPECT_EQ(static_cast<size_t>(r), support.num_rows);
+        CheckSupportEntries(x, expected_result, support);
+      }
+    }
+  }
+}
+
+// Warm starts on a sequence of perturbed matrices with changing k must give
+// the same supports as cold starts.
+TEST(DegreeFlowTest, WarmStart) {
+  vector<vector<double> > x;
+  RandomMatrix(20, 25, 5, &x);
+  vector<int> row_degrees(20, 2);
+  vector<int> col_degrees(25, 2);
+  const int ks[] = {20, 20, 30, 12, 12, 40, 1, 25};
+  const int num_ks = sizeof(ks) / sizeof(ks[0]);
+
+  DegreeFlowSolver warm_solver;
+  DegreeFlowSolver cold_solver;
+  DegreeFlowOptions warm_options;
+  warm_options.warm_start = true;
+  DegreeFlowOptions cold_options;
+  cold_options.engine = DegreeFlowOptions::kGraphEngine;
+  for (int ii = 0; ii < num_ks; ++ii) {
+    SCOPED_TRACE(ii);
+    if (ii == num_ks - 1) {
+      // A completely different matrix
+      RandomMatrix(20, 25, 6, &x);
+    } else {
+      for (size_t row = 0; row < x.size(); ++row) {
+        for (size_t col = 0; col < x[row].size(); ++col) {
+          x[row][col] += 0.05 * (static_cast<double>(rand()) / RAND_MAX - 0.5);
+        }
+      }
+    }
+
+    vector<vector<bool> > expected_result;
+    cold_solver.Solve(x, ks[ii], row_degrees, col_degrees, cold_options,
+                      false, WriteToStderr, &expected_result);
+    vector<vector<bool> > result;
+    warm_solver.Solve(x, ks[ii], row_degrees, col_degrees, warm_options,
+                      false, WriteToStderr, &result);
+    CheckResult(expected_result, result);
+  }
+}
+
+TEST(DegreeFlowTest, SparseMatrixFromTriplets) {
+  vector<uint32_t> rows = list_of(2)(0)(2)(0)(2);
+  vector<uint32_t> cols = list_of(1)(3)(0)(0)(1);
+  vector<double> values = list_of(1.0)(2.0)(3.0)(4.0)(5.0);
+  DegreeFlowSparseMatrix x;
+  EXPECT_TRUE(x.AssignTriplets(3, 4, rows, cols, values));
+
+  vector<size_t> expected_row_offset = list_of(0)(2)(2)(4);
+  vector<uint32_t> expected_col_index = list_of(0)(3)(0)(1);
+  vector<double> expected_value = list_of(4.0)(2.0)(3.0)(6.0);
+  EXPECT_EQ(expected_row_offset, x.row_offset);
+  EXPECT_EQ(expected_col_index, x.col_index);
+  EXPECT_EQ(expected_value, x.value);
+
+  // Coordinates outside the matrix are rejected, and so is the matrix.
+  DegreeFlowSolver solver;
+  vector<int> row_degrees(3, 1);
+  vector<int> col_degrees(4, 1);
+  vector<bool> result(1, true);
+  rows[1] = 3;
+  EXPECT_FALSE(x.AssignTriplets(3, 4, rows, cols, values));
+  solver.Solve(x, 2, row_degrees, col_degrees, DegreeFlowOptions(), false,
+               WriteToStderr, &result);
+  EXPECT_TRUE(result.empty());
+  rows[1] = 0;
+  cols[2] = 4;
+  EXPECT_FALSE(x.AssignTriplets(3, 4, rows, cols, values));
+  cols[2] = 0;
+  values.pop_back();
+  EXPECT_FALSE(x.AssignTriplets(3, 4, rows, cols, values));
+}
+
+// A sparse signal that stores every entry has the same flow graph as the
+// dense signal, so the supports must be identical.
+TEST(DegreeFlowTest, RandomSparseAllEntriesStored) {
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  DegreeFlowSolver solver;
+  for (unsigned int seed = 1; seed <= 20; ++seed) {
+    int r = 1 + seed % 7 * 5;
+    int c = 1 + seed % 5 * 7;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, seed, &x);
+    vector<int> row_degrees;
+    RandomDegrees(r, 3, &row_degrees);
+    vector<int> col_degrees;
+    RandomDegrees(c, 3, &col_degrees);
+    int k = rand() % (r + c + 1);
+
+    // Add the triplets in column-major order.
+    vector<uint32_t> rows;
+    vector<uint32_t> cols;
+    vector<double> values;
+    for (int jj = 0; jj < c; ++jj) {
+      for (int ii = 0; ii < r; ++ii) {
+        rows.push_back(ii);
+        cols.push_back(jj);
+        values.push_back(x[ii][jj]);
+      }
+    }
+    DegreeFlowSparseMatrix sparse_x;
+    sparse_x.AssignTriplets(r, c, rows, cols, values);
+
+    options.blocking_flow = (seed % 2 == 0);
+    vector<vector<bool> > expected_result;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &expected_result);
+    vector<bool> sparse_result;
+    solver.Solve(sparse_x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &sparse_result);
+
+    SCOPED_TRACE(seed);
+    ASSERT_EQ(static_cast<size_t>(r * c), sparse_result.size());
+    vector<vector<bool> > result(r, vector<bool>(c, false));
+    for (int ii = 0; ii < r; ++ii) {
+      for (size_t entry = sparse_x.row_offset[ii];
+           entry < sparse_x.row_offset[ii + 1]; ++entry) {
+        result[ii][sparse_x.col_index[entry]] = sparse_result[entry];
+      }
+    }
+    CheckResult(expected_result, result);
+  }
+}
+
+// Entries that are not stored cannot be selected, even if the degrees would
+// allow a larger support. Column 2 has no entries.
+TEST(DegreeFlowTest, SparseMissingEntries) {
+  vector<uint32_t> rows = list_of(0)(0)(1)(2);
+  vector<uint32_t> cols = list_of(0)(1)(1)(1);
+  vector<double> values = list_of(3.0)(-2.0)(1.0)(4.0);
+  DegreeFlowSparseMatrix x;
+  x.AssignTriplets(3, 3, rows, cols, values);
+  vector<int> row_degrees = list_of(1)(1)(1);
+  vector<int> col_degrees = list_of(1)(1)(1);
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  vector<bool> result;
+  solver.Solve(x, 2, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  vector<bool> expected_result = list_of(1)(0)(0)(1);
+  EXPECT_EQ(expected_result, result);
+
+  solver.Solve(x, 3, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  EXPECT_EQ(expected_result, result);
+}
+
+TEST(DegreeFlowTest, ReusedSolver) {
+  vector<vector<double> > x1;
+  x1.push_back(list_of(1)(3)(8));
+  x1.push_back(list_of(7)(0)(10));
+  x1.push_back(list_of(3)(2)(5));
+  vector<int> row_degrees1 = list_of(1)(1)(1);
+  vector<int> col_degrees1 = list_of(1)(1)(1);
+
+  vector<vector<bool> > expected_result1;
+  expected_result1.push_back(list_of(0)(0)(1));
+  expected_result1.push_back(list_of(1)(0)(0));
+  expected_result1.push_back(list_of(0)(1)(0));
+
+  vector<vector<double> > x2;
+  x2.push_back(list_of(1)(0));
+  x2.push_back(list_of(3)(3));
+  vector<int> row_degrees2 = list_of(1)(1);
+  vector<int> col_degrees2 = list_of(1)(1);
+
+  vector<vector<bool> > expected_result2;
+  expected_result2.push_back(list_of(1)(0));
+  expected_result2.push_back(list_of(0)(1));
+
+  DegreeFlowSolver solver;
+  vector<vector<bool> > result;
+  solver.Solve(x1, 3, row_degrees1, col_degrees1, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result1, result);
+  solver.Solve(x2, 2, row_degrees2, col_degrees2, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result2, result);
+  solver.Solve(x1, 3, row_degrees1, col_degrees1, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result1, result);
+}
+
+struct ConcurrentSolveData {
+  const vector<vector<double> >* x;
+  vector<vector<bool> > result;
+};
+
+void* ConcurrentSolve(void* arg) {
+  ConcurrentSolveData* data = static_cast<ConcurrentSolveData*>(arg);
+  vector<int> degrees(data->x->size(), 2);
+  DegreeFlowSolver solver;
+  for (int ii = 0; ii < 20; ++ii) {
+    solver.Solve(*(data->x), 6, degrees, degrees, false, WriteToStderr,
+                 &(data->result));
+  }
+  return NULL;
+}
+
+TEST(DegreeFlowTest, ConcurrentSolvers) {
+  vector<vector<double> > x;
+  x.push_back(list_of(1)(3)(8)(4));
+  x.push_back(list_of(7)(1)(10)(8));
+  x.push_back(list_of(3)(2)(5)(0));
+  x.push_back(list_of(9)(7)(2)(6));
+  vector<int> degrees(4, 2);
+
+  vector<vector<bool> > expected_result;
+  degree_flow(x, 6, degrees, degrees, false, WriteToStderr, &expected_result);
+
+  const int num_threads = 4;
+  ConcurrentSolveData data[num_threads];
+  pthread_t threads[num_threads];
+  for (int ii = 0; ii < num_threads; ++ii) {
+    data[ii].x = &x;
+    ASSERT_EQ(0, pthread_create(&threads[ii], NULL, ConcurrentSolve,
+                                &data[ii]));
+  }
+  for (int ii = 0; ii < num_threads; ++ii) {
+    pthread_join(threads[ii], NULL);
+    CheckResult(expected_result, data[ii].result);
+  }
+}
+
+void CheckStats(const DegreeFlowStats& stats, int expected_num_runs) {
+  EXPECT_EQ(expected_num_runs, stats.num_shortest_path_runs);
+  EXPECT_GE(stats.phase_times.graph_build, 0.0);
+  EXPECT_GE(stats.phase_times.initial_potentials, 0.0);
+  EXPECT_GE(stats.phase_times.augmentation, 0.0);
+  EXPECT_GE(stats.total_time, stats.phase_times.graph_build
+                              + stats.phase_times.initial_potentials
+                              + stats.phase_times.augmentation);
+  EXPECT_GT(stats.allocated_bytes, 0u);
+  if (stats.counters_enabled) {
+    long long num_runs = 0;
+    for (size_t ii = 0; ii < stats.settled_nodes_histogram.size(); ++ii) {
+      num_runs += stats.settled_nodes_histogram[ii];
+    }
+    EXPECT_EQ(stats.num_shortest_path_runs, num_runs);
+    EXPECT_GE(stats.num_queue_pushes, stats.num_queue_pops);
+    EXPECT_GE(stats.checking_inner_iterations,
+              stats.updating_inner_iterations);
+    EXPECT_GT(stats.updating_inner_iterations, 0);
+  } else {
+    EXPECT_EQ(0, stats.total_inner_iterations);
+    EXPECT_EQ(0, stats.num_queue_pushes);
+    EXPECT_EQ(0, stats.num_queue_pops);
+    EXPECT_TRUE(stats.settled_nodes_histogram.empty());
+  }
+}
+
+// Every augmentation of a feasible problem needs exactly one successful
+// Dijkstra run, and the statistics are reset by every call.
+TEST(DegreeFlowTest, Stats) {
+  vector<vector<double> > x;
+  RandomMatrix(20, 30, 1, &x);
+  vector<int> row_degrees(20, 2);
+  vector<int> col_degrees(30, 2);
+  int k = 30;
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  vector<vector<bool> > result;
+  for (int ii = 0; ii < 2; ++ii) {
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &result);
+    EXPECT_EQ(DegreeFlowOptions::kGraphEngine, solver.stats().engine);
+    CheckStats(solver.stats(), k);
+  }
+  options.engine = DegreeFlowOptions::kDenseEngine;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  EXPECT_EQ(DegreeFlowOptions::kDenseEngine, solver.stats().engine);
+  CheckStats(solver.stats(), k);
+
+  DegreeFlowStats stats;
+  degree_flow(x, k, row_degrees, col_degrees, false, WriteToStderr, &result,
+              &stats);
+  CheckStats(stats, k);
+  string json;
+  stats.ToJson(&json);
+  EXPECT_EQ('{', json[0]);
+  EXPECT_EQ('}', json[json.size() - 1]);
+  EXPECT_NE(string::npos, json.find("\"num_shortest_path_runs\": 30,"));
+  EXPECT_NE(string::npos, json.find("\"settled_nodes_histogram\": ["));
+}
+
+// Candidate pruning sums the statistics of all candidate problems.
+TEST(DegreeFlowTest, StatsCandidatePruning) {
+  vector<vector<double> > x;
+  RandomMatrix(30, 30, 2, &x);
+  vector<int> row_degrees(30, 3);
+  vector<int> col_degrees(30, 3);
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.pruning_candidates = 3;
+  vector<vector<bool> > result;
+  solver.Solve(x, 60, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  EXPECT_GE(solver.stats().num_shortest_path_runs, 60);
+  EXPECT_GT(solver.stats().total_time, 0.0);
+}
+
+// The automatic selection uses the cost scaling engine for large k, but not
+// if a solution path is requested, and the engine is reported in the
+// statistics.
+// Number of shortest path runs that settled fewer than max_settled_nodes
+// nodes (a power of two), from the histogram of the hot-path counters
+long long NumShortRuns(const DegreeFlowStats& stats,
+                       size_t max_settled_nodes) {
+  long long num_runs = 0;
+  for (size_t ii = 0; ii < stats.settled_nodes_histogram.size()
+                      && (static_cast<size_t>(2) << ii) <= max_settled_nodes;
+       ++ii) {
+    num_runs += stats.settled_nodes_histogram[ii];
+  }
+  return num_runs;
+}
+
+// The second path of the first instance swaps (0, 0) for (0, 1) and (1, 0),
+// so it runs through the nodes settled by the first search and through
+// columns whose potentials were capped at the distance of the sink. On the
+// wide second instance, the searches stop at the sink well before they
+// settle all reachable nodes. The cost scaling engine, which does not use
+// Dijkstra, is the reference.
+TEST(DegreeFlowTest, EarlyExitDijkstra) {
+  int r = 2;
+  int c = 30;
+  vector<vector<double> > x;
+  RandomMatrix(r, c, 3, &x);
+  x[0][0] = 9.0;
+  x[0][1] = 8.0;
+  x[1][0] = 8.0;
+  x[1][1] = 1.0;
+  vector<int> row_degrees(r, 1);
+  vector<int> col_degrees(c, 1);
+  vector<vector<bool> > expected_result(r, vector<bool>(c, false));
+  expected_result[0][1] = true;
+  expected_result[1][0] = true;
+  run_degree_flow(x, 2, row_degrees, col_degrees, expected_result);
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  vector<vector<bool> > result;
+  options.engine = DegreeFlowOptions::kCostScalingEngine;
+  solver.Solve(x, 2, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result, result);
+
+  r = 4;
+  c = 80;
+  RandomMatrix(r, c, 3, &x);
+  row_degrees.assign(r, 3);
+  col_degrees.assign(c, 1);
+  for (int k = 1; k <= 12; ++k) {
+    SCOPED_TRACE(k);
+    vector<vector<bool> > reference_result;
+    options.engine = DegreeFlowOptions::kCostScalingEngine;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &reference_result);
+    options.engine = DegreeFlowOptions::kDenseEngine;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &result);
+    CheckResult(reference_result, result);
+    options.engine = DegreeFlowOptions::kGraphEngine;
+    solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                 WriteToStderr, &result);
+    CheckResult(reference_result, result);
+  }
+  // All 86 nodes stay reachable, so without the early exit every search
+  // would settle all of them.
+  EXPECT_EQ(12, solver.stats().num_shortest_path_runs);
+  if (solver.stats().counters_enabled) {
+    EXPECT_GT(NumShortRuns(solver.stats(), 64), 0);
+  }
+}
+
+// With row degrees (1, 1, 0), at most two entries fit, so a larger k stops
+// after two shortest paths instead of running a third search that settles
+// every reachable node and fails.
+TEST(DegreeFlowTest, MaxFlowBoundShortCircuit) {
+  vector<vector<double> > x;
+  x.push_back(list_of(1)(5)(2));
+  x.push_back(list_of(4)(6)(3));
+  x.push_back(list_of(9)(9)(9));
+  vector<int> row_degrees = list_of(1)(1)(0);
+  vector<int> col_degrees = list_of(2)(2)(2);
+  vector<vector<bool> > expected_result;
+  expected_result.push_back(list_of(false)(true)(false));
+  expected_result.push_back(list_of(false)(true)(false));
+  expected_result.push_back(list_of(false)(false)(false));
+  run_degree_flow(x, 5, row_degrees, col_degrees, expected_result);
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  vector<vector<bool> > result;
+  options.engine = DegreeFlowOptions::kCostScalingEngine;
+  solver.Solve(x, 5, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result, result);
+
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  solver.Solve(x, 5, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result, result);
+  EXPECT_EQ(2, solver.stats().num_shortest_path_runs);
+  EXPECT_EQ(2, solver.stats().num_augmentations);
+  EXPECT_EQ(DegreeFlowStats::kFinished, solver.stats().termination);
+  options.engine = DegreeFlowOptions::kDenseEngine;
+  solver.Solve(x, 5, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  CheckResult(expected_result, result);
+  EXPECT_EQ(2, solver.stats().num_shortest_path_runs);
+}
+
+TEST(DegreeFlowTest, CostScalingEngine) {
+  vector<vector<double> > x;
+  RandomMatrix(40, 50, 6, &x);
+  vector<int> row_degrees(40, 10);
+  vector<int> col_degrees(50, 8);
+  int k = 350;
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  DegreeFlowSupport support;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &support, NULL);
+  EXPECT_EQ(DegreeFlowOptions::kCostScalingEngine, solver.stats().engine);
+  EXPECT_GT(solver.stats().num_scaling_phases, 0);
+  EXPECT_EQ(0, solver.stats().num_shortest_path_runs);
+  // 350 entries, amplitudes below 0.5 and R = 2^60 / 93^2
+  double rounding_loss_bound = solver.stats().rounding_loss_bound;
+  EXPECT_GT(rounding_loss_bound, 0.0);
+  EXPECT_LT(rounding_loss_bound, 350 * 0.5 * 93 * 93 / 1.15e18);
+  string json;
+  solver.stats().ToJson(&json);
+  EXPECT_NE(string::npos, json.find("\"engine\": \"cost_scaling\""));
+  EXPECT_NE(string::npos, json.find("\"rounding_loss_bound\": "));
+
+  DegreeFlowSolutionPath path;
+  DegreeFlowSupport path_support;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &path_support, &path);
+  EXPECT_EQ(DegreeFlowOptions::kDenseEngine, solver.stats().engine);
+  EXPECT_EQ(0.0, solver.stats().rounding_loss_bound);
+  ASSERT_EQ(support.entries.size(), path_support.entries.size());
+  EXPECT_LE(path_support.objective,
+            support.objective + rounding_loss_bound + 1e-12);
+  EXPECT_NEAR(path_support.objective, support.objective, 1e-9);
+  for (size_t ii = 0; ii < support.entries.size(); ++ii) {
+    EXPECT_EQ(path_support.entries[ii].row, support.entries[ii].row);
+    EXPECT_EQ(path_support.entries[ii].col, support.entries[ii].col);
+  }
+
+  // k larger than the largest support
+  k = 1000;
+  options.engine = DegreeFlowOptions::kCostScalingEngine;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &support, NULL);
+  EXPECT_EQ(400u, support.entries.size());
+
+  vector<uint8_t> mask(40 * 50);
+  vector<double> flat_x;
+  DegreeFlowMatrixView<const double> view = StridedCopy(x, 50, 1, &flat_x);
+  EXPECT_FALSE(solver.Solve(view, k, row_degrees, col_degrees, options,
+                            false, WriteToStderr,
+                            DegreeFlowMatrixView<uint8_t>::RowMajor(&mask[0],
+                                                                    40, 50),
+                            &path));
+}
+
+// The automatic selection uses the assignment engine if all degrees are 0
+// or 1, its solution path agrees with the graph engine, and an explicit
+// request with larger degrees fails.
+TEST(DegreeFlowTest, AssignmentEngine) {
+  vector<vector<double> > x;
+  RandomMatrix(20, 25, 5, &x);
+  vector<int> row_degrees(20, 1);
+  vector<int> col_degrees(25, 1);
+  row_degrees[3] = 0;
+  col_degrees[7] = 0;
+  int k = 19;
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  DegreeFlowSolutionPath path;
+  vector<vector<bool> > result;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result, &path);
+  EXPECT_EQ(DegreeFlowOptions::kAssignmentEngine, solver.stats().engine);
+  CheckStats(solver.stats(), k);
+
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  DegreeFlowSolutionPath expected_path;
+  vector<vector<bool> > expected_result;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &expected_result, &expected_path);
+  CheckResult(expected_result, result);
+  ASSERT_EQ(k, path.max_k());
+  for (int kk = 1; kk <= k; ++kk) {
+    EXPECT_NEAR(expected_path.objective[kk - 1], path.objective[kk - 1],
+                1e-9);
+    vector<vector<bool> > path_support;
+    vector<vector<bool> > expected_path_support;
+    path.GetSupport(kk, &path_support);
+    expected_path.GetSupport(kk, &expected_path_support);
+    CheckResult(expected_path_support, path_support);
+  }
+
+  vector<uint8_t> mask(20 * 25);
+  vector<double> flat_x;
+  DegreeFlowMatrixView<const double> view = StridedCopy(x, 25, 1, &flat_x);
+  options.engine = DegreeFlowOptions::kAssignmentEngine;
+  col_degrees[7] = 2;
+  EXPECT_FALSE(solver.Solve(view, k, row_degrees, col_degrees, options,
+                            false, WriteToStderr,
+                            DegreeFlowMatrixView<uint8_t>::RowMajor(&mask[0],
+                                                                    20, 25),
+                            NULL));
+}
+
+// Checks that the support satisfies the degrees and returns its size.
+int CheckSupportDegrees(const vector<vector<bool> >& support,
+                        const vector<int>& row_degrees,
+                        const vector<int>& col_degrees) {
+  int size = 0;
+  vector<int> col_counts(col_degrees.size(), 0);
+  for (size_t ii = 0; ii < support.size(); ++ii) {
+    int row_count = 0;
+    for (size_t jj = 0; jj < support[ii].size(); ++jj) {
+      if (support[ii][jj]) {
+        row_count += 1;
+        col_counts[jj] += 1;
+      }
+    }
+    EXPECT_LE(row_count, row_degrees[ii]);
+    size += row_count;
+  }
+  for (size_t jj = 0; jj < col_degrees.size(); ++jj) {
+    EXPECT_LE(col_counts[jj], col_degrees[jj]);
+  }
+  return size;
+}
+
+// Solves stopped after a few augmentations must return feasible supports
+// whose objective bound is at least the optimum, for all engines.
+TEST(DegreeFlowTest, RandomAugmentationLimit) {
+  vector<DegreeFlowOptions> all_options(7);
+  all_options[0].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[1].engine = DegreeFlowOptions::kDenseEngine;
+  all_options[2].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[2].blocking_flow = true;
+  all_options[3].engine = DegreeFlowOptions::kCostScalingEngine;
+  all_options[4].pruning_candidates = 2;
+  all_options[5].quantization_precision = 0.01;
+  all_options[6].engine = DegreeFlowOptions::kAssignmentEngine;
+
+  DegreeFlowSolver solver;
+  for (unsigned int seed = 1; seed <= 20; ++seed) {
+    int r = 1 + seed % 7 * 5;
+    int c = 1 + seed % 5 * 7;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, seed, &x);
+    vector<int> row_degrees;
+    RandomDegrees(r, 3, &row_degrees);
+    vector<int> col_degrees;
+    RandomDegrees(c, 3, &col_degrees);
+    int k = rand() % (r + c + 1);
+    SCOPED_TRACE(seed);
+
+    for (size_t ii = 0; ii < all_options.size(); ++ii) {
+      SCOPED_TRACE(ii);
+      DegreeFlowOptions options = all_options[ii];
+      vector<int> option_row_degrees = row_degrees;
+      vector<int> option_col_degrees = col_degrees;
+      if (options.engine == DegreeFlowOptions::kAssignmentEngine) {
+        for (int row = 0; row < r; ++row) {
+          option_row_degrees[row] = min(option_row_degrees[row], 1);
+        }
+        for (int col = 0; col < c; ++col) {
+          option_col_degrees[col] = min(option_col_degrees[col], 1);
+        }
+      }
+
+      vector<vector<bool> > result;
+      solver.Solve(x, k, option_row_degrees, option_col_degrees, options,
+                   false, WriteToStderr, &result);
+      double optimum = Objective(x, result);
+      int optimum_size = CheckSupportDegrees(result, option_row_degrees,
+                                             option_col_degrees);
+      EXPECT_EQ(DegreeFlowStats::kFinished, solver.stats().termination);
+      EXPECT_GE(solver.objective_bound(), optimum - 1e-9);
+      if (options.quantization_precision == 0.0) {
+        EXPECT_NEAR(optimum, solver.objective_bound(), 1e-9);
+      }
+
+      // 0 would disable the limit
+      options.max_augmentations = max(k / 2, 1);
+      solver.Solve(x, k, option_row_degrees, option_col_degrees, options,
+                   false, WriteToStderr, &result);
+      int size = CheckSupportDegrees(result, option_row_degrees,
+                                     option_col_degrees);
+      EXPECT_LE(size, options.max_augmentations);
+      if (options.pruning_candidates == 0) {
+        EXPECT_EQ(min(optimum_size, options.max_augmentations), size);
+      }
+      if (size < optimum_size) {
+        EXPECT_NE(DegreeFlowStats::kFinished, solver.stats().termination);
+      }
+      EXPECT_LE(Objective(x, result), optimum + 1e-9);
+      EXPECT_GE(solver.objective_bound(), optimum - 1e-9);
+    }
+  }
+}
+
+bool StopAfterThreeCalls(void* data) {
+  int* num_calls = static_cast<int*>(data);
+  *num_calls += 1;
+  return *num_calls >= 3;
+}
+
+// should_stop is called before every augmentation, so the solver stops
+// with two entries.
+TEST(DegreeFlowTest, ShouldStopCallback) {
+  vector<vector<double> > x;
+  RandomMatrix(20, 25, 7, &x);
+  vector<int> row_degrees(20, 2);
+  vector<int> col_degrees(25, 2);
+  int k = 30;
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kGraphEngine;
+  vector<vector<bool> > result;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &result);
+  double optimum = Objective(x, result);
+
+  int num_calls = 0;
+  options.should_stop = StopAfterThreeCalls;
+  options.should_stop_data = &num_calls;
+  DegreeFlowSupport support;
+  solver.Solve(x, k, row_degrees, col_degrees, options, false, WriteToStderr,
+               &support, NULL);
+  EXPECT_EQ(3, num_calls);
+  EXPECT_EQ(2u, support.entries.size());
+  EXPECT_EQ(DegreeFlowStats::kStopped, solver.stats().termination);
+  EXPECT_EQ(2, solver.stats().num_augmentations);
+  EXPECT_GE(solver.objective_bound(), optimum - 1e-9);
+  EXPECT_LT(support.objective, optimum);
+  string json;
+  solver.stats().ToJson(&json);
+  EXPECT_NE(string::npos, json.find("\"termination\": \"stopped\""));
+
+  // The sparse graph engine
+  DegreeFlowSparseMatrix sparse_x;
+  vector<uint32_t> rows;
+  vector<uint32_t> cols;
+  vector<double> values;
+  for (uint32_t row = 0; row < 20; ++row) {
+    for (uint32_t col = 0; col < 25; ++col) {
+      rows.push_back(row);
+      cols.push_back(col);
+      values.push_back(x[row][col]);
+    }
+  }
+  sparse_x.AssignTriplets(20, 25, rows, cols, values);
+  num_calls = 0;
+  vector<bool> sparse_result;
+  solver.Solve(sparse_x, k, row_degrees, col_degrees, options, false,
+               WriteToStderr, &sparse_result);
+  EXPECT_EQ(2, count(sparse_result.begin(), sparse_result.end(), true));
+  EXPECT_EQ(DegreeFlowStats::kStopped, solver.stats().termination);
+  EXPECT_GE(solver.objective_bound(), optimum - 1e-9);
+}
+
+// A time limit that has passed before the first augmentation gives an
+// empty support and the bound of the initial potentials, i.e., k times the
+// largest amplitude.
+TEST(DegreeFlowTest, TimeLimit) {
+  vector<vector<double> > x;
+  RandomMatrix(30, 30, 3, &x);
+  vector<int> degrees(30, 3);
+  int k = 40;
+  double max_abs_amplitude = 0.0;
+  for (int row = 0; row < 30; ++row) {
+    for (int col = 0; col < 30; ++col) {
+      max_abs_amplitude = max(max_abs_amplitude, abs(x[row][col]));
+    }
+  }
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.engine = DegreeFlowOptions::kDenseEngine;
+  options.time_limit = 1e-12;
+  vector<vector<bool> > result;
+  solver.Solve(x, k, degrees, degrees, options, false, WriteToStderr,
+               &result);
+  EXPECT_EQ(0, CheckSupportDegrees(result, degrees, degrees));
+  EXPECT_EQ(DegreeFlowStats::kTimeLimit, solver.stats().termination);
+  EXPECT_NEAR(k * max_abs_amplitude, solver.objective_bound(), 1e-9);
+
+  options.time_limit = 1000.0;
+  solver.Solve(x, k, degrees, degrees, options, false, WriteToStderr,
+               &result);
+  EXPECT_EQ(k, CheckSupportDegrees(result, degrees, degrees));
+  EXPECT_EQ(DegreeFlowStats::kFinished, solver.stats().termination);
+}
+
+// The certificates of all engines must prove the optimality of their
+// supports, also if k entries do not fit into the matrix, and must not
+// accept a support with its largest entry removed, which is worse than the
+// support with its smallest entry removed.
+TEST(DegreeFlowTest, RandomCertificate) {
+  vector<DegreeFlowOptions> all_options(6);
+  all_options[0].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[1].engine = DegreeFlowOptions::kDenseEngine;
+  all_options[2].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[2].blocking_flow = true;
+  all_options[3].engine = DegreeFlowOptions::kCostScalingEngine;
+  all_options[4].pruning_candidates = 2;
+  all_options[5].engine = DegreeFlowOptions::kAssignmentEngine;
+
+  DegreeFlowSolver solver;
+  for (unsigned int seed = 1; seed <= 20; ++seed) {
+    int r = 1 + seed % 7 * 5;
+    int c = 1 + seed % 5 * 7;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, seed, &x);
+    vector<double> buffer;
+    for (int row = 0; row < r; ++row) {
+      buffer.insert(buffer.end(), x[row].begin(), x[row].end());
+    }
+    // Column-major views are solved as their transpose.
+    vector<double> column_major_buffer(r * c);
+    for (int row = 0; row < r; ++row) {
+      for (int col = 0; col < c; ++col) {
+        column_major_buffer[col * r + row] = x[row][col];
+      }
+    }
+    vector<int> row_degrees;
+    RandomDegrees(r, 3, &row_degrees);
+    vector<int> col_degrees;
+    RandomDegrees(c, 3, &col_degrees);
+    int k = rand() % (r + c + 1);
+    SCOPED_TRACE(seed);
+
+    for (size_t ii = 0; ii < 2 * all_options.size(); ++ii) {
+      SCOPED_TRACE(ii);
+      DegreeFlowOptions options = all_options[ii % all_options.size()];
+      options.certificate = true;
+      DegreeFlowMatrixView<const double> view =
+          DegreeFlowMatrixView<const double>::RowMajor(&buffer[0], r, c);
+      if (ii >= all_options.size()) {
+        view = DegreeFlowMatrixView<const double>::ColumnMajor(
+            &column_major_buffer[0], r, c);
+      }
+      vector<int> option_row_degrees = row_degrees;
+      vector<int> option_col_degrees = col_degrees;
+      if (options.engine == DegreeFlowOptions::kAssignmentEngine) {
+        for (int row = 0; row < r; ++row) {
+          option_row_degrees[row] = min(option_row_degrees[row], 1);
+        }
+        for (int col = 0; col < c; ++col) {
+          option_col_degrees[col] = min(option_col_degrees[col], 1);
+        }
+      }
+
+      vector<pair<uint32_t, uint32_t> > support;
+      ASSERT_TRUE(solver.Solve(view, k, option_row_degrees,
+                               option_col_degrees, options, false,
+                               WriteToStderr, &support, NULL));
+      const DegreeFlowCertificate& certificate = solver.certificate();
+      EXPECT_EQ(static_cast<size_t>(r), certificate.num_rows);
+      EXPECT_EQ(static_cast<size_t>(r + c + 2), certificate.potential.size());
+      EXPECT_NEAR(certificate.objective, certificate.dual_objective, 1e-9);
+
+      DegreeFlowVerification verification;
+      EXPECT_TRUE(VerifyDegreeFlowSolution(view, k, option_row_degrees,
+                                           option_col_degrees, support,
+                                           certificate, 1e-9, 3,
+                                           &verification));
+      EXPECT_TRUE(verification.feasible);
+      EXPECT_EQ(support.size(), verification.support_size);
+      EXPECT_NEAR(certificate.objective, verification.objective, 1e-9);
+      EXPECT_NEAR(verification.objective, verification.dual_objective,
+                  1e-9);
+
+      if (support.size() >= 2) {
+        size_t largest = 0;
+        for (size_t jj = 1; jj < support.size(); ++jj) {
+          if (abs(view(support[jj].first, support[jj].second))
+              > abs(view(support[largest].first, support[largest].second))) {
+            largest = jj;
+          }
+        }
+        support.erase(support.begin() + largest);
+        EXPECT_FALSE(VerifyDegreeFlowSolution(view, k, option_row_degrees,
+                                              option_col_degrees, support,
+                                              certificate, 1e-9, 3,
+                                              &verification));
+        EXPECT_TRUE(verification.feasible);
+        EXPECT_GT(verification.max_violation, 0.0);
+      }
+    }
+  }
+}
+
+// The certificate of a quantized solve is optimal for the quantized
+// amplitudes, so the violations are at most half the precision.
+TEST(DegreeFlowTest, QuantizedCertificate) {
+  vector<vector<double> > x;
+  RandomMatrix(30, 40, 5, &x);
+  vector<double> buffer;
+  for (int row = 0; row < 30; ++row) {
+    buffer.insert(buffer.end(), x[row].begin(), x[row].end());
+  }
+  DegreeFlowMatrixView<const double> view =
+      DegreeFlowMatrixView<const double>::RowMajor(&buffer[0], 30, 40);
+  vector<int> row_degrees(30, 2);
+  vector<int> col_degrees(40, 2);
+  int k = 50;
+
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  options.quantization_precision = 0.01;
+  options.certificate = true;
+  vector<pair<uint32_t, uint32_t> > support;
+  ASSERT_TRUE(solver.Solve(view, k, row_degrees, col_degrees, options, false,
+                           WriteToStderr, &support, NULL));
+  DegreeFlowVerification verification;
+  VerifyDegreeFlowSolution(view, k, row_degrees, col_degrees, support,
+                           solver.certificate(), 1e-9, 1, &verification);
+  EXPECT_TRUE(verification.feasible);
+  EXPECT_LE(verification.max_violation, 0.005 + 1e-9);
+  EXPECT_GE(verification.dual_objective, verification.objective - 1e-9);
+}
+
+// The only support with 3 entries is {(0, 0), (1, 0), (1, 1)}, so the
+// solver must swap out the entry (0, 1) of the best support with 2 entries
+// and pad the support with a loss. The certificate proves optimality among
+// the supports with 3 entries with a negative sparsity dual, also if k is
+// larger than the maximum support size.
+TEST(DegreeFlowTest, PaddedCertificate) {
+  double buffer[4] = {0.0, 10.0,
+                      5.0, 0.0};
+  DegreeFlowMatrixView<const double> view =
+      DegreeFlowMatrixView<const double>::RowMajor(buffer, 2, 2);
+  vector<int> row_degrees(2, 1);
+  row_degrees[1] = 2;
+  vector<int> col_degrees(2, 1);
+  col_degrees[0] = 2;
+  vector<DegreeFlowOptions> all_options(6);
+  all_options[0].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[1].engine = DegreeFlowOptions::kDenseEngine;
+  all_options[2].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[2].blocking_flow = true;
+  all_options[3].engine = DegreeFlowOptions::kCostScalingEngine;
+  all_options[4].pruning_candidates = 1;
+  all_options[5].quantization_precision = 1e-3;
+
+  DegreeFlowSolver solver;
+  for (int k = 2; k <= 4; ++k) {
+    SCOPED_TRACE(k);
+    for (size_t ii = 0; ii < all_options.size(); ++ii) {
+      SCOPED_TRACE(ii);
+      DegreeFlowOptions options = all_options[ii];
+      options.certificate = true;
+      vector<pair<uint32_t, uint32_t> > support;
+      ASSERT_TRUE(solver.Solve(view, k, row_degrees, col_degrees, options,
+                               false, WriteToStderr, &support, NULL));
+      const DegreeFlowCertificate& certificate = solver.certificate();
+      DegreeFlowVerification verification;
+      EXPECT_TRUE(VerifyDegreeFlowSolution(view, k, row_degrees,
+                                           col_degrees, support, certificate,
+                                           1e-9, 2, &verification))
+          << verification.error;
+      EXPECT_NEAR(verification.objective, verification.dual_objective,
+                  1e-9);
+      if (k == 2) {
+        EXPECT_EQ(2u, support.size());
+        EXPECT_NEAR(15.0, verification.objective, 1e-9);
+        EXPECT_GE(certificate.sparsity_dual, 0.0);
+      } else {
+        EXPECT_EQ(3u, support.size());
+        EXPECT_NEAR(5.0, verification.objective, 1e-9);
+        EXPECT_LT(certificate.sparsity_dual, 0.0);
+      }
+    }
+  }
+}
+
+// Infeasible supports are rejected before the duals are checked.
+TEST(DegreeFlowTest, VerifyInfeasibleSupport) {
+  vector<vector<double> > x;
+  RandomMatrix(4, 5, 2, &x);
+  vector<double> buffer;
+  for (int row = 0; row < 4; ++row) {
+    buffer.insert(buffer.end(), x[row].begin(), x[row].end());
+  }
+  DegreeFlowMatrixView<const double> view =
+      DegreeFlowMatrixView<const double>::RowMajor(&buffer[0], 4, 5);
+  vector<int> row_degrees(4, 1);
+  vector<int> col_degrees(5, 2);
+  row_degrees[3] = 0;
+  DegreeFlowCertificate certificate;
+  DegreeFlowVerification verification;
+
+  vector<pair<uint32_t, uint32_t> > support;
+  support.push_back(make_pair(0, 1));
+  support.push_back(make_pair(0, 2));
+  EXPECT_FALSE(VerifyDegreeFlowSolution(view, 3, row_degrees, col_degrees,
+                                        support, certificate, 1e-9, 2,
+                                        &verification));
+  EXPECT_FALSE(verification.feasible);
+  support[1] = make_pair(3, 2);
+  EXPECT_FALSE(VerifyDegreeFlowSolution(view, 3, row_degrees, col_degrees,
+                                        support, certificate, 1e-9, 2,
+                                        &verification));
+  EXPECT_FALSE(verification.feasible);
+  support[1] = make_pair(1, 2);
+  EXPECT_FALSE(VerifyDegreeFlowSolution(view, 1, row_degrees, col_degrees,
+                                        support, certificate, 1e-9, 2,
+                                        &verification));
+  EXPECT_FALSE(verification.feasible);
+  // Feasible, but the certificate is empty
+  EXPECT_FALSE(VerifyDegreeFlowSolution(view, 2, row_degrees, col_degrees,
+                                        support, certificate, 1e-9, 2,
+                                        &verification));
+  EXPECT_TRUE(verification.feasible);
+  EXPECT_FALSE(verification.error.empty());
+}
+
+// Masked rows and columns (degree 0) and degrees larger than the number of
+// partners are removed and clamped by the compaction, which must not change
+// the support, the solution path or the validity of the certificate.
+TEST(DegreeFlowTest, RandomCompaction) {
+  vector<DegreeFlowOptions> all_options(6);
+  all_options[0].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[1].engine = DegreeFlowOptions::kDenseEngine;
+  all_options[2].engine = DegreeFlowOptions::kCostScalingEngine;
+  all_options[3].pruning_candidates = 2;
+  all_options[4].quantization_precision = 1e-6;
+  all_options[5].engine = DegreeFlowOptions::kGraphEngine;
+  all_options[5].warm_start = true;
+
+  DegreeFlowSolver solver;
+  DegreeFlowSolver uncompacted_solver;
+  for (unsigned int seed = 1; seed <= 20; ++seed) {
+    int r = 1 + seed % 7 * 5;
+    int c = 1 + seed % 5 * 7;
+    vector<vector<double> > x;
+    RandomMatrix(r, c, seed, &x);
+    // More than half of the rows and columns are masked out. Their
+    // amplitudes are the largest ones, so they would be in every support
+    // that does not respect the mask.
+    vector<int> row_degrees;
+    RandomDegrees(r, c + 2, &row_degrees);
+    for (int row = 0; row < r; ++row) {
+      if (rand() % 5 < 3) {
+        row_degrees[row] = 0;
+        x[row].assign(c, 10.0);
+      }
+    }
+    vector<int> col_degrees;
+    RandomDegrees(c, r + 2, &col_degrees);
+    for (int col = 0; col < c; ++col) {
+      if (rand() % 5 < 3) {
+        col_degrees[col] = 0;
+        for (int row = 0; row < r; ++row) {
+          x[row][col] = -10.0;
+        }
+      }
+    }
+    int k = rand() % (r + c + 1);
+    vector<double> buffer;
+    for (int row = 0; row < r; ++row) {
+      buffer.insert(buffer.end(), x[row].begin(), x[row].end());
+    }
+    SCOPED_TRACE(seed);
+
+    DegreeFlowSolutionPath expected_path;
+    vector<vector<bool> > path_result;
+    DegreeFlowOptions path_options;
+    uncompacted_solver.Solve(x, k, row_degrees, col_degrees, path_options,
+                             false, WriteToStderr, &path_result,
+                             &expected_path);
+    DegreeFlowSolutionPath path;
+    path_options.compaction = true;
+    solver.Solve(x, k, row_degrees, col_degrees, path_options, false,
+                 WriteToStderr, &path_result, &path);
+    EXPECT_EQ(static_cast<size_t>(r), path.num_rows);
+    EXPECT_EQ(static_cast<size_t>(c), path.num_cols);
+    ASSERT_EQ(expected_path.max_k(), path.max_k());
+    for (int kk = 1; kk <= path.max_k(); ++kk) {
+      EXPECT_NEAR(expected_path.objective[kk - 1], path.objective[kk - 1],
+                  1e-9);
+      vector<vector<bool> > expected_support;
+      expected_path.GetSupport(kk, &expected_support);
+      vector<vector<bool> > support;
+      path.GetSupport(kk, &support);
+      CheckResult(expected_support, support);
+    }
+    for (size_t ii = 0; ii < all_options.size(); ++ii) {
+      SCOPED_TRACE(ii);
+      DegreeFlowOptions options = all_options[ii];
+      DegreeFlowOptions uncompacted_options = options;
+      options.compaction = true;
+      options.certificate = true;
+
+      vector<vector<bool> > expected_result;
+      uncompacted_solver.Solve(x, k, row_degrees, col_degrees,
+                               uncompacted_options, false, WriteToStderr,
+                               &expected_result);
+      vector<vector<bool> > result;
+      solver.Solve(x, k, row_degrees, col_degrees, options, false,
+                   WriteToStderr, &result);
+      CheckResult(expected_result, result);
+      for (int row = 0; row < r; ++row) {
+        for (int col = 0; col < c; ++col) {
+          if (row_degrees[row] == 0 || col_degrees[col] == 0) {
+            EXPECT_FALSE(result[row][col]);
+          }
+        }
+      }
+
+      DegreeFlowMatrixView<const double> view =
+          DegreeFlowMatrixView<const double>::RowMajor(&buffer[0], r, c);
+      vector<pair<uint32_t, uint32_t> > support;
+      ASSERT_TRUE(solver.Solve(view, k, row_degrees, col_degrees, options,
+                               false, WriteToStderr, &support, NULL));
+      const DegreeFlowCertificate& certificate = solver.certificate();
+      EXPECT_EQ(static_cast<size_t>(r), certificate.num_rows);
+      EXPECT_EQ(static_cast<size_t>(c), certificate.num_cols);
+      EXPECT_EQ(static_cast<size_t>(r + c + 2), certificate.potential.size());
+      DegreeFlowVerification verification;
+      double tolerance = (options.quantization_precision > 0.0 ? 1e-5
+                                                               : 1e-9);
+      EXPECT_TRUE(VerifyDegreeFlowSolution(view, k, row_degrees,
+                                           col_degrees, support, certificate,
+                                           tolerance, 2, &verification))
+          << verification.error;
+      EXPECT_TRUE(verification.feasible);
+      EXPECT_NEAR(verification.objective, certificate.objective, 1e-9);
+    }
+  }
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,13 @@
+#ifndef __DEGREE_FLOW_TIME_H__
+#define __DEGREE_FLOW_TIME_H__
+
+#include <ctime>
+
+// Seconds on the monotonic clock, for measuring elapsed times
+inline double WallTime() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,290 @@
+// Optimality verifier for the supports of DegreeFlowSolver.
+//
+// The solver adds entries until the support has m = min(k, maximum support
+// size) entries, even if the last ones lower the objective, so it solves the
+// problem with the equality sum_rc y_rc = m. A support y with m entries is
+// optimal for it iff it is feasible and there are duals u, v >= 0 and a free
+// l (see DegreeFlowCertificate) with complementary slackness:
+//
+// - an entry in the support has |x_rc| >= u_r + v_c + l, an entry outside
+//   the support |x_rc| <= u_r + v_c + l (with w_rc = max(0, |x_rc| - u_r -
+//   v_c - l), the dual constraint of the entry is tight iff y_rc > 0 or
+//   w_rc = 0),
+// - a row with u_r > 0 has d_r entries, and a column with v_c > 0 has d'_c
+//   entries.
+//
+// The equality holds for every support with m entries, so it needs no
+// condition on l. The solver gives a padded support a negative l.
+//
+// Rows and columns with degree 0 have no constraints. A row can have at most
+// as many entries as there are columns with positive degree, so, as in a
+// compacted DegreeFlowSolver problem, d_r is clamped to that number (and
+// d'_c likewise).
+//
+// The degrees and the duals take O(r + c) time to check. The entries take
+// a pass over x, which is split into blocks of consecutive rows.
+
+#include "degree_flow_verify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include <pthread.h>
+
+using namespace std;
+
+namespace {
+
+const size_t kErrorBufferSize = 256;
+
+// The pass over the rows [row_begin, row_end) of x
+struct VerifyBlock {
+  const DegreeFlowMatrixView<const double>* x;
+  const vector<int>* row_degrees;
+  const vector<int>* col_degrees;
+  // The support in row-major order, and the first entry of every row
+  const vector<pair<uint32_t, uint32_t> >* support;
+  const vector<size_t>* row_begin_entry;
+  const DegreeFlowCertificate* certificate;
+  size_t row_begin;
+  size_t row_end;
+
+  double max_violation;
+  // The sum of the w_rc
+  double entry_dual_sum;
+  double objective;
+  double max_abs_amplitude;
+};
+
+void* VerifyRows(void* arg) {
+  VerifyBlock* block = static_cast<VerifyBlock*>(arg);
+  const DegreeFlowMatrixView<const double>& x = *(block->x);
+  const vector<int>& col_degrees = *(block->col_degrees);
+  const vector<pair<uint32_t, uint32_t> >& support = *(block->support);
+  const vector<double>& col_dual = block->certificate->col_dual;
+  double sparsity_dual = block->certificate->sparsity_dual;
+  block->max_violation = 0.0;
+  block->entry_dual_sum = 0.0;
+  block->objective = 0.0;
+  block->max_abs_amplitude = 0.0;
+  for (size_t row = block->row_begin; row < block->row_end; ++row) {
+    // Rows with degree 0 have no support entries (checked before) and no
+    // dual constraints.
+    if ((*block->row_degrees)[row] <= 0) {
+      continue;
+    }
+    double offset = block->certificate->row_dual[row] + sparsity_dual;
+    size_t next_entry = (*block->row_begin_entry)[row];
+    size_t end_entry = (*block->row_begin_entry)[row + 1];
+    for (size_t col = 0; col < x.num_cols; ++col) {
+      if (col_degrees[col] <= 0) {
+        continue;
+      }
+      double amplitude = abs(x(row, col));
+      block->max_abs_amplitude = max(block->max_abs_amplitude, amplitude);
+      double slack = amplitude - offset - col_dual[col];
+      if (slack > 0.0) {
+        block->entry_dual_sum += slack;
+      }
+      if (next_entry < end_entry && support[next_entry].second == col) {
+        next_entry += 1;
+        block->objective += amplitude;
+        block->max_violation = max(block->max_violation, -slack);
+      } else {
+        block->max_violation = max(block->max_violation, slack);
+      }
+    }
+  }
+  return NULL;
+}
+
+bool IsFiniteDual(double dual) {
+  return abs(dual) < numeric_limits<double>::infinity();
+}
+
+bool IsValidDual(double dual) {
+  return dual >= 0.0 && IsFiniteDual(dual);
+}
+
+}  // namespace
+
+bool VerifyDegreeFlowSolution(
+    const DegreeFlowMatrixView<const double>& x, int k,
+    const vector<int>& row_degrees, const vector<int>& col_degrees,
+    const vector<pair<uint32_t, uint32_t> >& support,
+    const DegreeFlowCertificate& certificate, double tolerance,
+    int num_threads, DegreeFlowVerification* verification) {
+  DegreeFlowVerification& result = *verification;
+  result = DegreeFlowVerification();
+  char error[kErrorBufferSize];
+  size_t num_rows = x.num_rows;
+  size_t num_cols = x.num_cols;
+  if (row_degrees.size() != num_rows || col_degrees.size() != num_cols) {
+    result.error = "The degrees do not match the signal.";
+    return false;
+  }
+
+  // Feasibility
+  vector<pair<uint32_t, uint32_t> > sorted_support(support);
+  sort(sorted_support.begin(), sorted_support.end());
+  result.support_size = sorted_support.size();
+  vector<int> row_count(num_rows, 0);
+  vector<int> col_count(num_cols, 0);
+  for (size_t ii = 0; ii < sorted_support.size(); ++ii) {
+    size_t row = sorted_support[ii].first;
+    size_t col = sorted_support[ii].second;
+    if (row >= num_rows || col >= num_cols) {
+      snprintf(error, kErrorBufferSize, "The support entry (%zd, %zd) is "
+               "outside of the signal.", row, col);
+      result.error = error;
+      return false;
+    }
+    if (ii > 0 && sorted_support[ii] == sorted_support[ii - 1]) {
+      snprintf(error, kErrorBufferSize, "The support entry (%zd, %zd) is "
+               "repeated.", row, col);
+      result.error = error;
+      return false;
+    }
+    row_count[row] += 1;
+    col_count[col] += 1;
+  }
+  for (size_t row = 0; row < num_rows; ++row) {
+    if (row_count[row] > max(row_degrees[row], 0)) {
+      snprintf(error, kErrorBufferSize, "Row %zd has %d support entries, "
+               "but degree %d.", row, row_count[row], row_degrees[row]);
+      result.error = error;
+      return false;
+    }
+  }
+  for (size_t col = 0; col < num_cols; ++col) {
+    if (col_count[col] > max(col_degrees[col], 0)) {
+      snprintf(error, kErrorBufferSize, "Column %zd has %d support entries, "
+               "but degree %d.", col, col_count[col], col_degrees[col]);
+      result.error = error;
+      return false;
+    }
+  }
+  if (sorted_support.size() > static_cast<size_t>(max(k, 0))) {
+    snprintf(error, kErrorBufferSize, "The support has %zd entries, but k = "
+             "%d.", sorted_support.size(), k);
+    result.error = error;
+    return false;
+  }
+  result.feasible = true;
+
+  // Dual feasibility
+  if (certificate.num_rows != num_rows || certificate.num_cols != num_cols
+      || certificate.row_dual.size() != num_rows
+      || certificate.col_dual.size() != num_cols) {
+    result.error = "The certificate does not match the signal.";
+    return false;
+  }
+  bool valid_duals = IsFiniteDual(certificate.sparsity_dual);
+  for (size_t row = 0; row < num_rows; ++row) {
+    if (row_degrees[row] > 0 && !IsValidDual(certificate.row_dual[row])) {
+      valid_duals = false;
+    }
+  }
+  for (size_t col = 0; col < num_cols; ++col) {
+    if (col_degrees[col] > 0 && !IsValidDual(certificate.col_dual[col])) {
+      valid_duals = false;
+    }
+  }
+  if (!valid_duals) {
+    result.error = "The certificate has negative or infinite duals.";
+    return false;
+  }
+
+  // The entries
+  vector<size_t> row_begin_entry(num_rows + 1, 0);
+  for (size_t row = 0; row < num_rows; ++row) {
+    row_begin_entry[row + 1] = row_begin_entry[row] + row_count[row];
+  }
+  size_t num_blocks = static_cast<size_t>(max(num_threads, 1));
+  num_blocks = max(min(num_blocks, num_rows), static_cast<size_t>(1));
+  vector<VerifyBlock> blocks(num_blocks);
+  for (size_t ii = 0; ii < num_blocks; ++ii) {
+    VerifyBlock& block = blocks[ii];
+    block.x = &x;
+    block.row_degrees = &row_degrees;
+    block.col_degrees = &col_degrees;
+    block.support = &sorted_support;
+    block.row_begin_entry = &row_begin_entry;
+    block.certificate = &certificate;
+    block.row_begin = num_rows * ii / num_blocks;
+    block.row_end = num_rows * (ii + 1) / num_blocks;
+  }
+  // The calling thread takes the first block.
+  vector<pthread_t> threads(num_blocks);
+  vector<bool> started(num_blocks, false);
+  for (size_t ii = 1; ii < num_blocks; ++ii) {
+    started[ii] = (pthread_create(&threads[ii], NULL, VerifyRows,
+                                  &blocks[ii]) == 0);
+  }
+  for (size_t ii = 0; ii < num_blocks; ++ii) {
+    if (ii == 0 || !started[ii]) {
+      VerifyRows(&blocks[ii]);
+    }
+  }
+  double entry_dual_sum = 0.0;
+  double max_abs_amplitude = 0.0;
+  for (size_t ii = 0; ii < num_blocks; ++ii) {
+    if (started[ii]) {
+      pthread_join(threads[ii], NULL);
+    }
+    result.max_violation = max(result.max_violation,
+                               blocks[ii].max_violation);
+    entry_dual_sum += blocks[ii].entry_dual_sum;
+    result.objective += blocks[ii].objective;
+    max_abs_amplitude = max(max_abs_amplitude, blocks[ii].max_abs_amplitude);
+  }
+
+  // The degree constraints and the dual objective
+  int num_active_rows = 0;
+  for (size_t row = 0; row < num_rows; ++row) {
+    if (row_degrees[row] > 0) {
+      num_active_rows += 1;
+    }
+  }
+  int num_active_cols = 0;
+  for (size_t col = 0; col < num_cols; ++col) {
+    if (col_degrees[col] > 0) {
+      num_active_cols += 1;
+    }
+  }
+  double dual_objective = entry_dual_sum;
+  for (size_t row = 0; row < num_rows; ++row) {
+    if (row_degrees[row] <= 0) {
+      continue;
+    }
+    int degree = min(row_degrees[row], num_active_cols);
+    double dual = certificate.row_dual[row];
+    dual_objective += degree * dual;
+    if (dual > 0.0 && row_count[row] < degree) {
+      result.max_violation = max(result.max_violation, dual);
+    }
+  }
+  for (size_t col = 0; col < num_cols; ++col) {
+    if (col_degrees[col] <= 0) {
+      continue;
+    }
+    int degree = min(col_degrees[col], num_active_rows);
+    double dual = certificate.col_dual[col];
+    dual_objective += degree * dual;
+    if (dual > 0.0 && col_count[col] < degree) {
+      result.max_violation = max(result.max_violation, dual);
+    }
+  }
+  dual_objective += certificate.sparsity_dual * sorted_support.size();
+  result.dual_objective = dual_objective;
+
+  result.optimal = (result.max_violation <= tolerance * max_abs_amplitude);
+  if (!result.optimal) {
+    snprintf(error, kErrorBufferSize, "Complementary slackness is violated "
+             "by %g.", result.max_violation);
+    result.error = error;
+  }
+  return result.optimal;
+}
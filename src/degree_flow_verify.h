@@ -0,0 +1,59 @@
+#ifndef __DEGREE_FLOW_VERIFY_H__
+#define __DEGREE_FLOW_VERIFY_H__
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "degree_flow.h"
+#include "degree_flow_view.h"
+
+struct DegreeFlowVerification {
+  // The support satisfies the degrees and k.
+  bool feasible;
+  // The support is feasible, and the duals of the certificate satisfy dual
+  // feasibility and complementary slackness up to the tolerance, so the
+  // support is optimal.
+  bool optimal;
+  size_t support_size;
+  // The objective of the support and the dual objective of the certificate,
+  // both computed from x
+  double objective;
+  double dual_objective;
+  // The largest violation of complementary slackness (in units of the
+  // amplitudes)
+  double max_violation;
+  // The first reason why the support is infeasible or the certificate is
+  // invalid
+  std::string error;
+
+  DegreeFlowVerification() : feasible(false), optimal(false),
+                             support_size(0), objective(0.0),
+                             dual_objective(0.0), max_violation(0.0) { }
+};
+
+// Checks a support against the degrees and k and verifies its optimality
+// with the duals of a certificate (see DegreeFlowOptions::certificate),
+// without solving the problem again. The support is a list of (row, column)
+// indices in any order. The pass over x takes O(r * c) time and is split
+// into blocks of rows for num_threads threads. A violation counts if it is
+// larger than tolerance times the largest amplitude. Returns
+// verification->optimal.
+//
+// Optimality is checked among the supports with as many entries as the
+// given one, which is the problem the solver solves: it augments to
+// min(k, maximum support size) entries even when the last augmentations
+// lower the objective (e.g., if k is close to the maximum support size,
+// whose last entries can only be fit by swapping out larger ones). The
+// sparsity dual of such a padded support is negative, and the support
+// verifies.
+bool VerifyDegreeFlowSolution(
+    const DegreeFlowMatrixView<const double>& x, int k,
+    const std::vector<int>& row_degrees, const std::vector<int>& col_degrees,
+    const std::vector<std::pair<uint32_t, uint32_t> >& support,
+    const DegreeFlowCertificate& certificate, double tolerance,
+    int num_threads, DegreeFlowVerification* verification);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef __DEGREE_FLOW_VIEW_H__
+#define __DEGREE_FLOW_VIEW_H__
+
+#include <cstddef>
+
+// A view of a dense matrix in memory owned by the caller. Entry (r, c) is
+// data[r * row_stride + c * col_stride], so a row-major array has
+// col_stride 1 and a column-major array (e.g., a MATLAB array) has
+// row_stride 1. Nothing is copied when a view is created or passed around.
+template <typename T>
+struct DegreeFlowMatrixView {
+  T* data;
+  size_t num_rows;
+  size_t num_cols;
+  size_t row_stride;
+  size_t col_stride;
+
+  DegreeFlowMatrixView() : data(NULL), num_rows(0), num_cols(0),
+                           row_stride(0), col_stride(0) { }
+
+  DegreeFlowMatrixView(T* _data, size_t _num_rows, size_t _num_cols,
+                       size_t _row_stride, size_t _col_stride)
+    : data(_data), num_rows(_num_rows), num_cols(_num_cols),
+      row_stride(_row_stride), col_stride(_col_stride) { }
+
+  static DegreeFlowMatrixView RowMajor(T* data, size_t num_rows,
+                                       size_t num_cols) {
+    return DegreeFlowMatrixView(data, num_rows, num_cols, num_cols, 1);
+  }
+
+  static DegreeFlowMatrixView ColumnMajor(T* data, size_t num_rows,
+                                          size_t num_cols) {
+    return DegreeFlowMatrixView(data, num_rows, num_cols, 1, num_rows);
+  }
+
+  // A submatrix of a larger array (as with the lda argument of BLAS): the
+  // rows (or columns) start leading_dimension entries apart.
+  static DegreeFlowMatrixView RowMajor(T* data, size_t num_rows,
+                                       size_t num_cols,
+                                       size_t leading_dimension) {
+    return DegreeFlowMatrixView(data, num_rows, num_cols, leading_dimension,
+                                1);
+  }
+
+  static DegreeFlowMatrixView ColumnMajor(T* data, size_t num_rows,
+                                          size_t num_cols,
+                                          size_t leading_dimension) {
+    return DegreeFlowMatrixView(data, num_rows, num_cols, 1,
+                                leading_dimension);
+  }
+
+  T& operator()(size_t row, size_t col) const {
+    return data[row * row_stride + col * col_stride];
+  }
+
+  // The same matrix with rows and columns exchanged
+  DegreeFlowMatrixView Transposed() const {
+    return DegreeFlowMatrixView(data, num_cols, num_rows, col_stride,
+                                row_stride);
+  }
+};
+
+#endif
@@ -1,49 +1,248 @@
+#include <algorithm>
 #include <vector>
 #include <cstdio>
 #include <cmath>
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
 
 #include "degree_flow.h"
+#include "degree_flow_io.h"
+#include "degree_flow_server.h"
+#include "degree_flow_verify.h"
 
 using namespace std;
+namespace po = boost::program_options;
 
-int r, c;
 int k;
 vector<int> row_degrees;
 vector<int> col_degrees;
 vector<vector<double> > a;
-vector<vector<double> > support;
+vector<double> a_buffer;
 
 void output_function(const char* s) {
-  fprintf(stderr, s);
+  fprintf(stderr, "%s", s);
   fflush(stderr);
 }
 
-int main() {
-  scanf("%d %d %d", &r, &c, &k);
-  row_degrees.resize(r);
-  for (int ii = 0; ii < r; ++ii) {
-    scanf("%d", &row_degrees[ii]);
+int main(int argc, char** argv) {
+  po::options_description desc("Reads a problem from stdin (or from a binary "
+                               "problem file) and writes the support to "
+                               "stdout.\nOptions");
+  desc.add_options()
+      ("help", "print this help message")
+      ("input", po::value<string>(), "read the problem from a binary problem "
+                                      "file (see degree_flow_convert)")
+      ("binary-output", "write the support as a binary list of (row, column) "
+                        "indices")
+      ("path", "also print the changes of the support for every sparsity up "
+               "to k")
+      ("stats-json", po::value<string>(), "write the statistics of the solve "
+                                           "as JSON to the given file")
+      ("time-limit", po::value<double>(), "stop after the given number of "
+                                          "seconds with the support found so "
+                                          "far")
+      ("max-augmentations", po::value<int>(), "stop after the given number "
+                                              "of augmentations")
+      ("compaction", "remove the rows and columns with degree 0 before "
+                     "building the flow graph")
+      ("certificate", po::value<string>(), "write the duals that certify "
+                                            "the optimality of the support "
+                                            "to the given file")
+      ("verify", po::value<string>(), "instead of solving, check the support "
+                                       "given by --support with the "
+                                       "certificate in the given file")
+      ("support", po::value<string>(), "the support to verify (written "
+                                        "with --binary-output)")
+      ("tolerance", po::value<double>()->default_value(1e-9),
+       "largest violation accepted by --verify, relative to the largest "
+       "amplitude")
+      ("server", po::value<string>(), "serve projection requests on a Unix "
+                                       "domain socket at the given path")
+      ("threads", po::value<int>()->default_value(4),
+       "number of worker threads of the server and of --verify");
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+  } catch (const po::error& e) {
+    cerr << e.what() << endl << desc << endl;
+    return 1;
   }
-  col_degrees.resize(c);
-  for (int jj = 0; jj < c; ++jj) {
-    scanf("%d", &col_degrees[jj]);
+  if (vm.count("help")) {
+    cout << desc << endl;
+    return 0;
+  }
+  if (vm.count("server")) {
+    DegreeFlowServer server(vm["threads"].as<int>());
+    string error;
+    if (!server.Listen(vm["server"].as<string>().c_str(), &error)) {
+      cerr << error << endl;
+      return 1;
+    }
+    server.Run();
+    return 0;
   }
 
-  a.resize(r);
-  for (int ii = 0; ii < r; ++ii) {
-    a[ii].resize(c);
-    for (int jj = 0; jj < c; ++jj) {
-      scanf("%lf", &(a[ii][jj]));
+  bool print_path = (vm.count("path") > 0);
+  bool binary_output = (vm.count("binary-output") > 0);
+  if (print_path && binary_output) {
+    cerr << "--path cannot be combined with --binary-output." << endl;
+    return 1;
+  }
+
+  // Problem files are solved in place in the mapping; the text format is
+  // read into one row-major buffer.
+  DegreeFlowProblemFile file;
+  DegreeFlowMatrixView<const double> x;
+  if (vm.count("input")) {
+    string error;
+    if (!file.Open(vm["input"].as<string>().c_str(), &error)) {
+      cerr << error << endl;
+      return 1;
+    }
+    k = file.k();
+    file.GetDegrees(&row_degrees, &col_degrees);
+    file.GetMatrixView(&a_buffer, &x);
+  } else {
+    if (!ReadDegreeFlowTextProblem(stdin, &a, &k, &row_degrees,
+                                   &col_degrees)) {
+      cerr << "Could not read the problem from stdin." << endl;
+      return 1;
+    }
+    a_buffer.resize(a.size() * a[0].size());
+    for (size_t ii = 0; ii < a.size(); ++ii) {
+      copy(a[ii].begin(), a[ii].end(), a_buffer.begin() + ii * a[0].size());
     }
+    x = DegreeFlowMatrixView<const double>::RowMajor(&a_buffer[0], a.size(),
+                                                     a[0].size());
   }
+  int r = x.num_rows;
+  int c = x.num_cols;
 
-  vector<vector<bool> > result;
-  degree_flow(a, k, row_degrees, col_degrees, true, output_function, &result);
+  if (vm.count("verify")) {
+    if (!vm.count("support")) {
+      cerr << "--verify needs the support to check (--support)." << endl;
+      return 1;
+    }
+    DegreeFlowCertificate certificate;
+    FILE* certificate_file = fopen(vm["verify"].as<string>().c_str(), "rb");
+    bool success = (certificate_file != NULL
+                    && ReadDegreeFlowCertificate(certificate_file,
+                                                 &certificate));
+    if (certificate_file != NULL) {
+      fclose(certificate_file);
+    }
+    if (!success) {
+      cerr << "Could not read the certificate." << endl;
+      return 1;
+    }
+    vector<pair<uint32_t, uint32_t> > support;
+    FILE* support_file = fopen(vm["support"].as<string>().c_str(), "rb");
+    success = (support_file != NULL
+               && ReadDegreeFlowSupport(support_file, &support));
+    if (support_file != NULL) {
+      fclose(support_file);
+    }
+    if (!success) {
+      cerr << "Could not read the support." << endl;
+      return 1;
+    }
 
+    DegreeFlowVerification verification;
+    VerifyDegreeFlowSolution(x, k, row_degrees, col_degrees, support,
+                             certificate, vm["tolerance"].as<double>(),
+                             vm["threads"].as<int>(), &verification);
+    if (!verification.error.empty()) {
+      fprintf(stderr, "%s\n", verification.error.c_str());
+    }
+    if (verification.feasible) {
+      fprintf(stderr, "Support size %zd, objective %lf, dual objective %lf, "
+              "largest violation %g\n", verification.support_size,
+              verification.objective, verification.dual_objective,
+              verification.max_violation);
+    }
+    printf("%s\n", verification.optimal ? "optimal"
+                   : (verification.feasible ? "feasible" : "infeasible"));
+    return verification.optimal ? 0 : 1;
+  }
+
+  // The support is returned as the list of its entries, so no r x c
+  // result has to be allocated or scanned.
+  DegreeFlowSupport result;
+  DegreeFlowSolutionPath path;
+  DegreeFlowSolver solver;
+  DegreeFlowOptions options;
+  if (vm.count("time-limit")) {
+    options.time_limit = vm["time-limit"].as<double>();
+  }
+  if (vm.count("max-augmentations")) {
+    options.max_augmentations = vm["max-augmentations"].as<int>();
+  }
+  options.certificate = (vm.count("certificate") > 0);
+  options.compaction = (vm.count("compaction") > 0);
+  solver.Solve(x, k, row_degrees, col_degrees, options, true,
+               output_function, &result, print_path ? &path : NULL);
+  fprintf(stderr, "Support size %zd, objective %lf\n", result.entries.size(),
+          result.objective);
+  if (solver.stats().termination != DegreeFlowStats::kFinished) {
+    fprintf(stderr, "Stopped early, the optimal objective is at most %lf\n",
+            solver.objective_bound());
+  }
+
+  if (vm.count("stats-json")) {
+    string json;
+    solver.stats().ToJson(&json);
+    json.append("\n");
+    FILE* stats_file = fopen(vm["stats-json"].as<string>().c_str(), "w");
+    if (stats_file == NULL
+        || fwrite(json.data(), 1, json.size(), stats_file) != json.size()) {
+      cerr << "Could not write the statistics." << endl;
+      if (stats_file != NULL) {
+        fclose(stats_file);
+      }
+      return 1;
+    }
+    fclose(stats_file);
+  }
+
+  if (options.certificate) {
+    FILE* certificate_file = fopen(vm["certificate"].as<string>().c_str(),
+                                   "wb");
+    if (certificate_file == NULL
+        || !WriteDegreeFlowCertificate(certificate_file,
+                                       solver.certificate())) {
+      cerr << "Could not write the certificate." << endl;
+      if (certificate_file != NULL) {
+        fclose(certificate_file);
+      }
+      return 1;
+    }
+    fclose(certificate_file);
+  }
+
+  if (binary_output) {
+    vector<pair<uint32_t, uint32_t> > indices(result.entries.size());
+    for (size_t ii = 0; ii < result.entries.size(); ++ii) {
+      indices[ii] = make_pair(result.entries[ii].row, result.entries[ii].col);
+    }
+    if (!WriteDegreeFlowSupport(stdout, indices)) {
+      cerr << "Could not write the support." << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  // The entries are in row-major order.
+  size_t next_entry = 0;
   for (int ii = 0; ii < r; ++ii) {
     for (int jj = 0; jj < c; ++jj) {
-      if (result[ii][jj]) {
+      if (next_entry < result.entries.size()
+          && result.entries[next_entry].row == static_cast<uint32_t>(ii)
+          && result.entries[next_entry].col == static_cast<uint32_t>(jj)) {
         printf("1 ");
+        next_entry += 1;
       } else {
         printf("0 ");
       }
@@ -51,5 +250,19 @@ int main() {
     printf("\n");
   }
 
+  if (print_path) {
+    // One line per sparsity: the sparsity, the objective value and the
+    // entries that enter (+) or leave (-) the support.
+    for (int kk = 0; kk < path.max_k(); ++kk) {
+      printf("%d %lf", kk + 1, path.objective[kk]);
+      for (size_t ii = path.change_begin[kk]; ii < path.change_begin[kk + 1];
+           ++ii) {
+        const DegreeFlowSolutionPath::Change& change = path.changes[ii];
+        printf(" %c%u,%u", change.added ? '+' : '-', change.row, change.col);
+      }
+      printf("\n");
+    }
+  }
+
   return 0;
 }
@@ -4,9 +4,12 @@
 #include <mex.h>
 #include <matrix.h>
 #include <cmath>
+#include <stdint.h>
 #include <vector>
 #include <string>
 
+#include "degree_flow_view.h"
+
 bool get_double(const mxArray* raw_data, double* data) {
   int numdims = mxGetNumberOfDimensions(raw_data);
   const mwSize* dims = mxGetDimensions(raw_data);
@@ -124,6 +127,43 @@ bool get_double_matrix(const mxArray* raw_data,
   return true;
 }
 
+// Views a double matrix in place (column-major, as stored by MATLAB).
+bool get_double_matrix_view(const mxArray* raw_data,
+    DegreeFlowMatrixView<const double>* view) {
+  int numdims = mxGetNumberOfDimensions(raw_data);
+  const mwSize* dims = mxGetDimensions(raw_data);
+  if (numdims != 2) {
+    return false;
+  }
+  if (!mxIsClass(raw_data, "double") || mxIsComplex(raw_data)
+      || mxIsSparse(raw_data)) {
+    return false;
+  }
+  *view = DegreeFlowMatrixView<const double>::ColumnMajor(
+      static_cast<const double*>(mxGetData(raw_data)), dims[0], dims[1]);
+  return true;
+}
+
+// Reads the compressed columns of a sparse double matrix: the entries of
+// column ic are col_start[ic] to col_start[ic + 1] - 1.
+bool get_sparse_double_matrix(const mxArray* raw_data, size_t* r, size_t* c,
+    std::vector<size_t>* col_start, std::vector<uint32_t>* row_index,
+    std::vector<double>* values) {
+  if (!mxIsSparse(raw_data) || !mxIsClass(raw_data, "double")
+      || mxIsComplex(raw_data)) {
+    return false;
+  }
+  *r = mxGetM(raw_data);
+  *c = mxGetN(raw_data);
+  const mwIndex* jc = mxGetJc(raw_data);
+  const mwIndex* ir = mxGetIr(raw_data);
+  const double* data_linear = mxGetPr(raw_data);
+  col_start->assign(jc, jc + *c + 1);
+  row_index->assign(ir, ir + jc[*c]);
+  values->assign(data_linear, data_linear + jc[*c]);
+  return true;
+}
+
 bool get_fields(const mxArray* struc, std::vector<std::string>* fields) {
   if (!mxIsStruct(struc)) {
     return false;
@@ -197,6 +237,15 @@ void set_double(mxArray** raw_data, double data) {
   *(static_cast<double*>(mxGetData(*raw_data))) = data;
 }
 
+void set_double_row_vector(mxArray** raw_data,
+    const std::vector<double>& data) {
+  *raw_data = mxCreateDoubleMatrix(1, data.size(), mxREAL);
+  double* result_linear = static_cast<double*>(mxGetData(*raw_data));
+  for (size_t ii = 0; ii < data.size(); ++ii) {
+    result_linear[ii] = data[ii];
+  }
+}
+
 void set_double_matrix(mxArray** raw_data,
     const std::vector<std::vector<double> >& data) {
   int numdims = 2;
@@ -229,4 +278,40 @@ void set_double_matrix(mxArray** raw_data,
   set_double_matrix(raw_data, tmp_data);
 }
 
+// Creates an r x c logical matrix and returns a view of its entries.
+DegreeFlowMatrixView<uint8_t> set_logical_matrix(mxArray** raw_data,
+    size_t r, size_t c) {
+  *raw_data = mxCreateLogicalMatrix(r, c);
+  return DegreeFlowMatrixView<uint8_t>::ColumnMajor(
+      reinterpret_cast<uint8_t*>(mxGetLogicals(*raw_data)), r, c);
+}
+
+// Creates an r x c sparse logical matrix from the selected entries of
+// compressed columns (see get_sparse_double_matrix).
+void set_sparse_logical_matrix(mxArray** raw_data, size_t r, size_t c,
+    const std::vector<size_t>& col_start,
+    const std::vector<uint32_t>& row_index,
+    const std::vector<bool>& selected) {
+  size_t nnz = 0;
+  for (size_t ii = 0; ii < selected.size(); ++ii) {
+    nnz += selected[ii];
+  }
+  *raw_data = mxCreateSparseLogicalMatrix(r, c, nnz);
+  mwIndex* jc = mxGetJc(*raw_data);
+  mwIndex* ir = mxGetIr(*raw_data);
+  mxLogical* result_linear = mxGetLogicals(*raw_data);
+  size_t entry = 0;
+  for (size_t ic = 0; ic < c; ++ic) {
+    jc[ic] = entry;
+    for (size_t ii = col_start[ic]; ii < col_start[ic + 1]; ++ii) {
+      if (selected[ii]) {
+        ir[entry] = row_index[ii];
+        result_linear[entry] = true;
+        ++entry;
+      }
+    }
+  }
+  jc[c] = entry;
+}
+
 #endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <set>
@@ -16,6 +17,15 @@ void output_function(const char* s) {
   mexEvalString("drawnow;");
 }
 
+// Prints the statistics as one line of JSON, which can be captured with
+// evalc and parsed with jsondecode.
+void output_stats(const DegreeFlowStats& stats) {
+  string json;
+  stats.ToJson(&json);
+  json.append("\n");
+  mexPrintf("%s", json.c_str());
+}
+
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
   if (nrhs < 4) {
     mexErrMsgTxt("At least four input argument required (amplitudes, sparsity,"
@@ -25,15 +35,44 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     mexErrMsgTxt("Too many input arguments, at most five: amplitudes, sparsity,"
         " row degree, column degrees and the options struct.");
   }
-  if (nlhs > 1) {
+  if (nlhs > 3) {
     mexErrMsgTxt("Too many output arguments.");
   }
 
-  vector<vector<double> > a;
-  if (!get_double_matrix(prhs[0], &a)) {
-    mexErrMsgTxt("Amplitudes need to be a two-dimensional double array.");
+  // Neither the dense nor the sparse amplitudes are converted into another
+  // layout. A dense matrix is solved in place; MATLAB stores it column by
+  // column, so the solver works on its transpose (see
+  // DegreeFlowSolver::Solve). The compressed columns of a sparse matrix are
+  // the compressed rows of its transpose, so they become the CSR matrix of
+  // the transposed problem as they are.
+  bool is_sparse = mxIsSparse(prhs[0]);
+  DegreeFlowMatrixView<const double> a;
+  DegreeFlowSparseMatrix sparse_a_transposed;
+  size_t num_rows = 0;
+  size_t num_cols = 0;
+  if (is_sparse) {
+    if (!get_sparse_double_matrix(prhs[0], &num_rows, &num_cols,
+                                  &sparse_a_transposed.row_offset,
+                                  &sparse_a_transposed.col_index,
+                                  &sparse_a_transposed.value)) {
+      mexErrMsgTxt("Sparse amplitudes need to be a real sparse double "
+                   "matrix.");
+    }
+    sparse_a_transposed.num_rows = num_cols;
+    sparse_a_transposed.num_cols = num_rows;
+    if (nlhs > 1) {
+      mexErrMsgTxt("The solution path is only available for dense "
+                   "amplitudes.");
+    }
+  } else {
+    if (!get_double_matrix_view(prhs[0], &a)) {
+      mexErrMsgTxt("Amplitudes need to be a real two-dimensional double "
+                   "array.");
+    }
+    num_rows = a.num_rows;
+    num_cols = a.num_cols;
   }
-  if (a.size() == 0) {
+  if (num_rows == 0) {
     mexErrMsgTxt("The input signal must have at least one row.");
   }
 
@@ -46,7 +85,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
   if (!get_double_row_vector_as_ints(prhs[2], &row_degrees)) {
     mexErrMsgTxt("Row degrees has to be a double row vector.");
   }
-  if (row_degrees.size() != a.size()) {
+  if (row_degrees.size() != num_rows) {
     mexErrMsgTxt("The row degree vector must have as many entries as X has "
                  "rows.");
   }
@@ -55,15 +94,22 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
   if (!get_double_row_vector_as_ints(prhs[3], &col_degrees)) {
     mexErrMsgTxt("Col degrees has to be a double row vector.");
   }
-  if (col_degrees.size() != a[0].size()) {
+  if (col_degrees.size() != num_cols) {
     mexErrMsgTxt("The column degree vector must have as many entries as X has "
                  "columns.");
   }
   
   bool verbose = false;
+  bool print_stats = false;
+  DegreeFlowOptions solver_options;
   if (nrhs == 5) {
     set<string> known_options;
     known_options.insert("verbose");
+    known_options.insert("pruning_candidates");
+    known_options.insert("quantization_precision");
+    known_options.insert("time_limit");
+    known_options.insert("max_augmentations");
+    known_options.insert("stats");
     vector<string> options;
     if (!get_fields(prhs[4], &options)) {
       mexErrMsgTxt("Cannot get fields from options argument.");
@@ -81,12 +127,73 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         && !get_bool_field(prhs[4], "verbose", &verbose)) {
       mexErrMsgTxt("verbose flag has to be a boolean scalar.");
     }
+    if (has_field(prhs[4], "pruning_candidates")
+        && !get_double_field_as_int(prhs[4], "pruning_candidates",
+                                    &solver_options.pruning_candidates)) {
+      mexErrMsgTxt("pruning_candidates has to be a double scalar.");
+    }
+    if (has_field(prhs[4], "quantization_precision")
+        && !get_double_field(prhs[4], "quantization_precision",
+                             &solver_options.quantization_precision)) {
+      mexErrMsgTxt("quantization_precision has to be a double scalar.");
+    }
+    if (has_field(prhs[4], "time_limit")
+        && !get_double_field(prhs[4], "time_limit",
+                             &solver_options.time_limit)) {
+      mexErrMsgTxt("time_limit has to be a double scalar.");
+    }
+    if (has_field(prhs[4], "max_augmentations")
+        && !get_double_field_as_int(prhs[4], "max_augmentations",
+                                    &solver_options.max_augmentations)) {
+      mexErrMsgTxt("max_augmentations has to be a double scalar.");
+    }
+    if (has_field(prhs[4], "stats")
+        && !get_bool_field(prhs[4], "stats", &print_stats)) {
+      mexErrMsgTxt("stats flag has to be a boolean scalar.");
+    }
   }
   
-  vector<vector<bool> > support;
-  degree_flow(a, k, row_degrees, col_degrees, verbose, output_function,
-              &support);
-  if (nlhs >= 1) {
-    set_double_matrix(&(plhs[0]), support);
+  DegreeFlowSolver solver;
+  if (is_sparse) {
+    vector<bool> sparse_support;
+    solver.Solve(sparse_a_transposed, k, col_degrees, row_degrees,
+                 solver_options, verbose, output_function, &sparse_support);
+    if (sparse_support.size() != sparse_a_transposed.num_entries()) {
+      sparse_support.assign(sparse_a_transposed.num_entries(), false);
+    }
+    set_sparse_logical_matrix(&(plhs[0]), num_rows, num_cols,
+                              sparse_a_transposed.row_offset,
+                              sparse_a_transposed.col_index, sparse_support);
+    if (print_stats) {
+      output_stats(solver.stats());
+    }
+    return;
+  }
+
+  // The support is written directly into the logical output matrix.
+  DegreeFlowMatrixView<uint8_t> support =
+      set_logical_matrix(&(plhs[0]), num_rows, num_cols);
+  DegreeFlowSolutionPath path;
+  solver.Solve(a, k, row_degrees, col_degrees, solver_options, verbose,
+               output_function, support, nlhs >= 2 ? &path : NULL);
+  if (nlhs >= 2) {
+    // One row [k, row, col, +1 / -1] per change, with 1-based indices
+    vector<vector<double> > changes(path.changes.size(), vector<double>(4));
+    for (int kk = 0; kk < path.max_k(); ++kk) {
+      for (size_t ii = path.change_begin[kk]; ii < path.change_begin[kk + 1];
+           ++ii) {
+        changes[ii][0] = kk + 1;
+        changes[ii][1] = path.changes[ii].row + 1;
+        changes[ii][2] = path.changes[ii].col + 1;
+        changes[ii][3] = (path.changes[ii].added ? 1.0 : -1.0);
+      }
+    }
+    set_double_matrix(&(plhs[1]), changes);
+  }
+  if (nlhs >= 3) {
+    set_double_row_vector(&(plhs[2]), path.objective);
+  }
+  if (print_stats) {
+    output_stats(solver.stats());
   }
 }